@@ -12,7 +12,10 @@
  * Block size: 	4096B
  * Sector size:	512B
  */
+#include "kernel/include/disk/prefetch.h"
 #include "kernel/include/kernel/fs.h"
+#include "kernel/include/kernel/initrd.h"
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -25,6 +28,46 @@ struct file_pointer_type {
 	FILE *fp;
 };
 
+#define GEN_DIR_NAME		"gen" // the generated tree is mounted at /gen
+#define GEN_MAX_EXTENTS		4	  // direct extents per inode
+#define GEN_FRAG_GROUP		8	  // fragmented files interleaved together
+#define GEN_MAX_DIRS		4096
+
+typedef enum { GEN_SIZE_UNIFORM, GEN_SIZE_LOG } GEN_SIZE_DISTRIBUTION;
+
+// options of the synthetic tree generator (FS scaling benchmarks)
+struct generator_options {
+	uint32_t files;			// number of regular files
+	uint32_t min_size;		// smallest file, in bytes
+	uint32_t max_size;		// largest file, in bytes
+	uint8_t distribution;	// GEN_SIZE_DISTRIBUTION
+	uint32_t depth;			// directory levels, /gen included
+	uint32_t width;			// subdirectories per directory
+	uint32_t fragmented;	// percentage of files split into extents
+	uint32_t seed;
+};
+
+// file or directory of the generated tree
+struct generated_file {
+	char name[60];
+	uint8_t type;	  // FILETYPE_FILE or FILETYPE_DIR
+	uint32_t parent;  // index of the parent directory (the root for /gen)
+	uint32_t size;	  // size in bytes
+	uint32_t entries; // directories: number of entries, . and .. included
+	uint32_t next;	  // directories: next free entry while filling the data
+	struct extent_block extent[GEN_MAX_EXTENTS]; // relative to the tree
+};
+
+// the tree is stored after the other files: inode ids start with first_id and
+// the blocks in the extents are relative to the first block of the tree
+struct generated_tree {
+	struct generated_file *files; // files[0] is /gen, directories come first
+	uint32_t count;
+	uint32_t dirs;
+	uint32_t blocks;
+	uint32_t first_id;
+};
+
 /**
  * @brief Get number of bytes needed for padding until the given limit is
  * reached
@@ -158,16 +201,23 @@ int get_disk_size(struct file_pointer_type files[], int num_files) {
  * @param image_fp			File pointer to the disk image
  * @param num_files			Number of files in the files array
  * @param total_file_blocks	Total number of data blocks needed by the files
+ * @param tree				The generated tree, NULL if there is none
  *
  * @return 1 if error occured, 0 otherwise
  */
 int write_superblock(struct superblock *superblock,
 					 struct file_pointer_type files[], FILE *image_fp,
-					 int num_files, int total_file_blocks) {
+					 int num_files, int total_file_blocks,
+					 struct generated_tree *tree) {
 	// the number of files (without the bootloader), 0 reserved and 1 root
 	// (num_files - 1 + 2)
 	superblock->total_inodes = num_files + 1;
 
+	// the generated tree comes after the other files
+	if (tree != NULL) {
+		superblock->total_inodes += tree->count;
+	}
+
 	// inode bitmap block is 2 (0:boot, 1:superblock)
 	superblock->first_inode_bitmap_block = 2;
 
@@ -184,6 +234,11 @@ int write_superblock(struct superblock *superblock,
 	uint32_t disk_size = get_disk_size(files, num_files);
 	uint32_t data_blocks =
 		bytes_to_blocks(disk_size) + 1; // +1 for the root directory block
+
+	if (tree != NULL) {
+		data_blocks += tree->blocks;
+	}
+
 	superblock->data_bitmap_blocks =
 		data_blocks / (FS_BLOCK_SIZE * 8) +
 		((data_blocks % (FS_BLOCK_SIZE * 8) > 0) ? 1 : 0);
@@ -329,6 +384,309 @@ int write_data_bitmap(FILE *image_fp, struct superblock *superblock) {
 	return 0;
 }
 
+/**
+ * @brief Get the seed of the data of a generated file
+ *
+ * The seed is a hash of the file's name (names are unique in the generated
+ * tree), so it doesn't change when the image is re-laid out and the inodes
+ * are renumbered. fs_bench computes it the same way.
+ *
+ * @param name	Name of the file
+ *
+ * @return The seed
+ */
+uint32_t generate_seed(const char *name) {
+	uint32_t hash = 5381;
+
+	while (*name) {
+		hash = hash * 33 + (uint8_t) *name++;
+	}
+
+	return hash;
+}
+
+/**
+ * @brief Get the size of a generated file
+ *
+ * Sizes are either uniformly distributed between the minimum and the maximum
+ * size, or log-uniformly (most of the files are small, like in a real tree).
+ *
+ * @param options	Generator options
+ *
+ * @return Size in bytes
+ */
+uint32_t generate_size(struct generator_options *options) {
+	double r = rand() / (RAND_MAX + 1.0);
+
+	if (options->distribution == GEN_SIZE_LOG) {
+		double min = log(options->min_size + 1.0);
+		double max = log(options->max_size + 1.0);
+
+		return (uint32_t) exp(min + r * (max - min)) - 1;
+	}
+
+	return options->min_size +
+		   (uint32_t) (r * (options->max_size - options->min_size + 1.0));
+}
+
+/**
+ * @brief Generate a synthetic tree of files
+ *
+ * The tree has the given depth (/gen is the first level) and every directory
+ * has the given number of subdirectories. Files are spread evenly over the
+ * directories on the last level. Directories and contiguous files are laid out
+ * in this order, then the fragmented files, whose extents are interleaved with
+ * the extents of other fragmented files.
+ *
+ * @param options	Generator options
+ * @param first_id	Inode id of /gen
+ * @param tree		Filled with the generated tree
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int generate_tree(struct generator_options *options, uint32_t first_id,
+				  struct generated_tree *tree) {
+	uint32_t dirs = 0, level_dirs = 1, leaves = 1, first_leaf = 0;
+	uint32_t num_fragmented = 0, block = 0;
+	uint32_t *fragmented = NULL;
+
+	for (uint32_t level = 0; level < options->depth; level++) {
+		if (dirs + level_dirs > GEN_MAX_DIRS) {
+			printf("Error: too many generated directories (max %d)\n",
+				   GEN_MAX_DIRS);
+			return 1;
+		}
+
+		first_leaf = dirs;
+		leaves = level_dirs;
+		dirs += level_dirs;
+		level_dirs *= options->width;
+	}
+
+	tree->count = dirs + options->files;
+	tree->dirs = dirs;
+	tree->first_id = first_id;
+	tree->files = calloc(tree->count, sizeof(struct generated_file));
+	fragmented = malloc((options->files + 1) * sizeof(uint32_t));
+
+	if (tree->files == NULL || fragmented == NULL) {
+		printf("Error: out of memory\n");
+		goto err;
+	}
+
+	srand(options->seed);
+
+	// directories in breadth first order: the children of directory i are
+	// i * width + 1 ... i * width + width
+	strcpy(tree->files[0].name, GEN_DIR_NAME);
+	tree->files[0].type = FILETYPE_DIR;
+	tree->files[0].entries = 2;
+
+	for (uint32_t i = 1; i < dirs; i++) {
+		struct generated_file *dir = &tree->files[i];
+
+		dir->type = FILETYPE_DIR;
+		dir->parent = (i - 1) / options->width;
+		dir->entries = 2;
+		sprintf(dir->name, "d%d", (i - 1) % options->width);
+		tree->files[dir->parent].entries++;
+	}
+
+	for (uint32_t i = 0; i < options->files; i++) {
+		struct generated_file *file = &tree->files[dirs + i];
+
+		file->type = FILETYPE_FILE;
+		file->parent = first_leaf + i % leaves;
+		file->size = generate_size(options);
+		sprintf(file->name, "f%d", i);
+		tree->files[file->parent].entries++;
+	}
+
+	for (uint32_t i = 0; i < dirs; i++) {
+		struct generated_file *dir = &tree->files[i];
+
+		dir->size = dir->entries * sizeof(struct directory_entry);
+		dir->next = 2;
+		dir->extent[0] = (struct extent_block) {
+			.first_block = block, .length = bytes_to_blocks(dir->size)};
+		block += dir->extent[0].length;
+	}
+
+	for (uint32_t i = dirs; i < tree->count; i++) {
+		struct generated_file *file = &tree->files[i];
+		uint32_t length = bytes_to_blocks(file->size);
+
+		if (length > 1 && rand() % 100 < options->fragmented) {
+			fragmented[num_fragmented++] = i;
+			continue;
+		}
+
+		file->extent[0] =
+			(struct extent_block) {.first_block = block, .length = length};
+		block += length;
+	}
+
+	// the first extent of every file in the group, then the second one, ...
+	for (uint32_t group = 0; group < num_fragmented; group += GEN_FRAG_GROUP) {
+		for (uint32_t e = 0; e < GEN_MAX_EXTENTS; e++) {
+			for (uint32_t k = group;
+				 k < num_fragmented && k < group + GEN_FRAG_GROUP; k++) {
+				struct generated_file *file = &tree->files[fragmented[k]];
+				uint32_t length = bytes_to_blocks(file->size);
+				uint32_t pieces =
+					length < GEN_MAX_EXTENTS ? length : GEN_MAX_EXTENTS;
+
+				if (e >= pieces) {
+					continue;
+				}
+
+				file->extent[e] = (struct extent_block) {
+					.first_block = block,
+					.length = length / pieces + (e < length % pieces ? 1 : 0)};
+				block += file->extent[e].length;
+			}
+		}
+	}
+
+	tree->blocks = block;
+
+	printf("generated tree: %d directories, %d files (%d fragmented), %d "
+		   "blocks\n",
+		   dirs, options->files, num_fragmented, block);
+
+	free(fragmented);
+	return 0;
+
+err:
+	free(fragmented);
+	free(tree->files);
+	tree->files = NULL;
+	return 1;
+}
+
+/**
+ * @brief Write the inodes of the generated tree to the disk image
+ *
+ * @param image_fp		File pointer to the disk image
+ * @param tree			The generated tree
+ * @param first_block	First block of the tree
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int write_generated_inodes(FILE *image_fp, struct generated_tree *tree,
+						   uint32_t first_block) {
+	time_t t;
+	struct tm ts;
+	time(&t);
+	ts = *localtime(&t);
+
+	for (uint32_t i = 0; i < tree->count; i++) {
+		struct generated_file *file = &tree->files[i];
+		struct inode_block inode = {0};
+
+		inode.id = tree->first_id + i;
+		inode.file_type = file->type;
+		inode.size_bytes = file->size;
+		inode.size_sectors = bytes_to_sectors(file->size);
+
+		inode.datetime.day = ts.tm_mday;
+		inode.datetime.month = ts.tm_mon + 1;
+		inode.datetime.year = ts.tm_year + 1900;
+
+		for (int e = 0; e < GEN_MAX_EXTENTS; e++) {
+			if (file->extent[e].length == 0) {
+				break;
+			}
+
+			inode.extent[e] = (struct extent_block) {
+				.first_block = first_block + file->extent[e].first_block,
+				.length = file->extent[e].length};
+		}
+
+		if (fwrite(&inode, sizeof(struct inode_block), 1, image_fp) != 1) {
+			printf("Error writing a generated inode\n");
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Write the data blocks of the generated tree to the disk image
+ *
+ * Byte i of a generated file is (seed + i) & 0xFF, where the seed is a hash
+ * of the file's name (see generate_seed()), so the data read back by the
+ * benchmark program can be checked.
+ *
+ * @param image_fp	File pointer to the disk image
+ * @param tree		The generated tree
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int write_generated_data(FILE *image_fp, struct generated_tree *tree) {
+	uint8_t *data = calloc(tree->blocks, FS_BLOCK_SIZE);
+
+	if (data == NULL && tree->blocks > 0) {
+		printf("Error: out of memory\n");
+		return 1;
+	}
+
+	// . and .. first, then the children in the order of their ids
+	for (uint32_t i = 0; i < tree->count; i++) {
+		struct generated_file *file = &tree->files[i];
+
+		if (file->type == FILETYPE_DIR) {
+			struct directory_entry *entries =
+				(struct directory_entry *) (data + file->extent[0].first_block *
+													   FS_BLOCK_SIZE);
+
+			entries[0].id = tree->first_id + i;
+			strcpy((char *) entries[0].name, ".");
+			entries[1].id = i == 0 ? 1 : tree->first_id + file->parent;
+			strcpy((char *) entries[1].name, "..");
+		}
+
+		if (i == 0) {
+			continue;
+		}
+
+		struct generated_file *parent = &tree->files[file->parent];
+		struct directory_entry *entry =
+			(struct directory_entry *) (data + parent->extent[0].first_block *
+												   FS_BLOCK_SIZE) +
+			parent->next++;
+
+		entry->id = tree->first_id + i;
+		strcpy((char *) entry->name, file->name);
+	}
+
+	for (uint32_t i = tree->dirs; i < tree->count; i++) {
+		struct generated_file *file = &tree->files[i];
+		uint32_t seed = generate_seed(file->name);
+		uint32_t offset = 0;
+
+		for (int e = 0; e < GEN_MAX_EXTENTS && offset < file->size; e++) {
+			uint8_t *p = data + file->extent[e].first_block * FS_BLOCK_SIZE;
+
+			for (uint32_t j = 0; j < file->extent[e].length * FS_BLOCK_SIZE &&
+								 offset < file->size;
+				 j++, offset++) {
+				p[j] = (uint8_t) (seed + offset);
+			}
+		}
+	}
+
+	if (fwrite(data, FS_BLOCK_SIZE, tree->blocks, image_fp) != tree->blocks) {
+		printf("Error writing the generated data\n");
+		free(data);
+		return 1;
+	}
+
+	free(data);
+	return 0;
+}
+
 /**
  * @brief Write inodes to the disk image
  *
@@ -340,11 +698,13 @@ int write_data_bitmap(FILE *image_fp, struct superblock *superblock) {
  * @param num_files		Number of file sin the files array
  * @param superblock	Pointer to the superblock
  * @param files			Array of files
+ * @param tree			The generated tree, NULL if there is none
  *
  * @return 1 if error occured, 0 otherwise
  */
 int write_inodes(FILE *image_fp, int num_files, struct superblock *superblock,
-				 struct file_pointer_type files[]) {
+				 struct file_pointer_type files[],
+				 struct generated_tree *tree) {
 	uint32_t written_bytes = 0;
 	struct inode_block inode = {0};
 	time_t t;
@@ -365,8 +725,14 @@ int write_inodes(FILE *image_fp, int num_files, struct superblock *superblock,
 	// inode 1: root directory
 	inode.id = 1;
 	inode.file_type = FILETYPE_DIR;
-	inode.size_bytes = sizeof(struct directory_entry) *
-					   (num_files - 1); // -1 for the bootloader
+	inode.size_bytes =
+		sizeof(struct directory_entry) *
+		(num_files + 1); // -1 for the bootloader, +2 for . and ..
+
+	if (tree != NULL) {
+		inode.size_bytes += sizeof(struct directory_entry); // /gen
+	}
+
 	inode.size_sectors = bytes_to_sectors(inode.size_bytes);
 
 	inode.extent[0] =
@@ -417,6 +783,17 @@ int write_inodes(FILE *image_fp, int num_files, struct superblock *superblock,
 		current_file_first_block += inode.extent[0].length;
 	}
 
+	// the generated tree is stored after the other files
+	if (tree != NULL) {
+		ret = write_generated_inodes(image_fp, tree, current_file_first_block);
+
+		if (ret) {
+			return 1;
+		}
+
+		written_bytes += tree->count * sizeof(struct inode_block);
+	}
+
 	// padding TODO: take into consideration the number of blocks for inodes
 	uint32_t written_inodes =
 		num_files + 1; // -1 + 2 (minus bootloader, add root and reserved)
@@ -445,11 +822,12 @@ int write_inodes(FILE *image_fp, int num_files, struct superblock *superblock,
  * @param num_files		Number of files in the files array
  * @param superblock	Pointer to the superblock
  * @param files			Array of files
+ * @param tree			The generated tree, NULL if there is none
  *
  * @return 1 if error occured, 0 otherwise
  */
 int write_data(FILE *image_pt, int num_files, struct superblock *superblock,
-			   struct file_pointer_type files[]) {
+			   struct file_pointer_type files[], struct generated_tree *tree) {
 	uint32_t written_bytes = 0;
 
 	// write first data block which is the root directory that will contain a
@@ -493,6 +871,19 @@ int write_data(FILE *image_pt, int num_files, struct superblock *superblock,
 		written_bytes += sizeof(struct directory_entry);
 	}
 
+	if (tree != NULL) {
+		root_dir.id = tree->first_id;
+		strcpy(root_dir.name, GEN_DIR_NAME);
+
+		ret = fwrite(&root_dir, sizeof(root_dir), 1, image_pt);
+
+		if (ret == 0) {
+			printf("Error writing directory entry in root block\n");
+			return 1;
+		}
+		written_bytes += sizeof(struct directory_entry);
+	}
+
 	// END OF ROOT DIRECTORY BLOCK
 	// padding
 	uint32_t padding = padding_bytes(written_bytes, FS_BLOCK_SIZE);
@@ -540,23 +931,467 @@ int write_data(FILE *image_pt, int num_files, struct superblock *superblock,
 		}
 	}
 
+	if (tree != NULL) {
+		return write_generated_data(image_pt, tree);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Create the initrd archive
+ *
+ * This function packs the given files from the bin directory into one archive
+ * (see kernel/include/kernel/initrd.h for the layout). The archive is written
+ * to a temporary file that is added to the image as a regular file, so it is
+ * stored contiguously and the kernel can load it in one transfer.
+ *
+ * @param names		Names of the files in the bin directory
+ * @param count		Number of files
+ * @param initrd	Filled with the archive's file pointer and size
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int create_initrd(char *names[], int count, struct file_pointer_type *initrd) {
+	struct initrd_header header = {.magic = INITRD_MAGIC, .num_files = count};
+	struct initrd_entry entries[INITRD_MAX_FILES] = {0};
+	uint8_t zero[INITRD_ALIGNMENT] = {0};
+	uint8_t buffer[FS_BLOCK_SIZE];
+
+	if (count > INITRD_MAX_FILES) {
+		printf("Error: too many files for the initrd (max %d)\n",
+			   INITRD_MAX_FILES);
+		return 1;
+	}
+
+	FILE *fp = tmpfile();
+
+	if (fp == NULL) {
+		printf("Error creating the initrd\n");
+		return 1;
+	}
+
+	uint32_t offset = sizeof(header) + count * sizeof(struct initrd_entry);
+
+	// data is written after the header and the entries
+	for (int i = 0; i < count; i++) {
+		char file_path[100] = "bin/";
+		FILE *file_fp;
+
+		if (strlen(names[i]) >= INITRD_NAME_LENGTH ||
+			strlen(names[i]) + strlen(file_path) >= sizeof(file_path)) {
+			printf("Error: initrd file name too long: %s\n", names[i]);
+			goto err;
+		}
+
+		strcat(file_path, names[i]);
+		file_fp = fopen(file_path, "rb");
+
+		if (file_fp == NULL) {
+			printf("Error: %s not found\n", file_path);
+			goto err;
+		}
+
+		offset += padding_bytes(offset, INITRD_ALIGNMENT);
+
+		strcpy(entries[i].name, names[i]);
+		entries[i].offset = offset;
+
+		fseek(fp, offset, SEEK_SET);
+
+		size_t read_bytes;
+
+		while ((read_bytes = fread(buffer, 1, sizeof(buffer), file_fp)) > 0) {
+			if (fwrite(buffer, 1, read_bytes, fp) != read_bytes) {
+				printf("Error writing the initrd\n");
+				fclose(file_fp);
+				goto err;
+			}
+
+			entries[i].size += read_bytes;
+		}
+
+		fclose(file_fp);
+		offset += entries[i].size;
+	}
+
+	// pad the end of the archive (fseek past the end doesn't write anything)
+	fseek(fp, offset, SEEK_SET);
+	fwrite(zero, 1, padding_bytes(offset, INITRD_ALIGNMENT), fp);
+	offset += padding_bytes(offset, INITRD_ALIGNMENT);
+
+	rewind(fp);
+
+	if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+		(count > 0 &&
+		 fwrite(entries, sizeof(struct initrd_entry), count, fp) != count)) {
+		printf("Error writing the initrd\n");
+		goto err;
+	}
+
+	rewind(fp);
+
+	strcpy(initrd->name, "bin/" INITRD_FILE_NAME);
+	initrd->size = offset;
+	initrd->fp = fp;
+
+	printf("initrd: %d files, %d bytes\n", count, offset);
+
+	return 0;
+
+err:
+	fclose(fp);
+	return 1;
+}
+
+/**
+ * @brief Read the files recorded in the boot prefetch list of an image
+ *
+ * This function reads the prefetch list written by the kernel in the given
+ * disk image and returns the names of the recorded files, in the order in which
+ * they were first loaded.
+ *
+ * @param image_name	Name of the disk image
+ * @param names			Filled with the names of the recorded files
+ * @param count			Filled with the number of recorded files
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int read_prefetch_profile(char *image_name, char names[][60], int *count) {
+	struct superblock superblock;
+	struct inode_block root_inode, list_inode;
+	struct prefetch_list list;
+	struct directory_entry *root_dir = NULL;
+	uint32_t entries;
+
+	*count = 0;
+
+	FILE *fp = fopen(image_name, "rb");
+
+	if (fp == NULL) {
+		printf("Error: %s not found\n", image_name);
+		return 1;
+	}
+
+	// superblock is the second block
+	fseek(fp, FS_BLOCK_SIZE, SEEK_SET);
+
+	if (fread(&superblock, sizeof(superblock), 1, fp) != 1) {
+		goto err;
+	}
+
+	// root directory has always id 1
+	fseek(fp,
+		  superblock.first_inode_block * FS_BLOCK_SIZE +
+			  sizeof(struct inode_block),
+		  SEEK_SET);
+
+	if (fread(&root_inode, sizeof(root_inode), 1, fp) != 1 ||
+		root_inode.file_type != FILETYPE_DIR) {
+		goto err;
+	}
+
+	entries = root_inode.size_bytes / sizeof(struct directory_entry);
+	root_dir = malloc(entries * sizeof(struct directory_entry));
+
+	if (root_dir == NULL) {
+		goto err;
+	}
+
+	fseek(fp, root_inode.extent[0].first_block * FS_BLOCK_SIZE, SEEK_SET);
+
+	if (fread(root_dir, sizeof(struct directory_entry), entries, fp) !=
+		entries) {
+		goto err;
+	}
+
+	// find the prefetch list
+	list_inode.id = 0;
+
+	for (uint32_t i = 0; i < entries; i++) {
+		if (strcmp(root_dir[i].name, PREFETCH_FILE_NAME) != 0) {
+			continue;
+		}
+
+		fseek(fp,
+			  superblock.first_inode_block * FS_BLOCK_SIZE +
+				  root_dir[i].id * sizeof(struct inode_block),
+			  SEEK_SET);
+
+		if (fread(&list_inode, sizeof(list_inode), 1, fp) != 1) {
+			goto err;
+		}
+	}
+
+	if (list_inode.id == 0) {
+		printf("Error: no %s in %s\n", PREFETCH_FILE_NAME, image_name);
+		goto err;
+	}
+
+	fseek(fp, list_inode.extent[0].first_block * FS_BLOCK_SIZE, SEEK_SET);
+
+	if (fread(&list, sizeof(list), 1, fp) != 1) {
+		goto err;
+	}
+
+	if (list.header.magic != PREFETCH_MAGIC ||
+		list.header.count > PREFETCH_MAX_ENTRIES) {
+		printf("Error: %s in %s is empty\n", PREFETCH_FILE_NAME, image_name);
+		goto err;
+	}
+
+	// keep the first access of every file
+	for (uint32_t i = 0; i < list.header.count; i++) {
+		for (uint32_t j = 0; j < entries; j++) {
+			if (root_dir[j].id != list.entries[i].inode ||
+				strcmp(root_dir[j].name, ".") == 0 ||
+				strcmp(root_dir[j].name, "..") == 0) {
+				continue;
+			}
+
+			int found = 0;
+
+			for (int k = 0; k < *count; k++) {
+				if (strcmp(names[k], root_dir[j].name) == 0) {
+					found = 1;
+				}
+			}
+
+			if (!found) {
+				strcpy(names[(*count)++], root_dir[j].name);
+			}
+
+			break;
+		}
+	}
+
+	free(root_dir);
+	fclose(fp);
+
+	printf("prefetch profile: %d files recorded in %s\n", *count, image_name);
+
+	return 0;
+
+err:
+	printf("Error reading the prefetch list from %s\n", image_name);
+	free(root_dir);
+	fclose(fp);
+	return 1;
+}
+
+/**
+ * @brief Create the boot prefetch list
+ *
+ * This function creates the (empty) prefetch list file, see
+ * kernel/include/disk/prefetch.h. It is filled by the kernel during the first
+ * seconds after boot.
+ *
+ * @param list	Filled with the list's file pointer and size
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int create_prefetch_list(struct file_pointer_type *list) {
+	uint8_t zero[PREFETCH_FILE_SIZE] = {0};
+	FILE *fp = tmpfile();
+
+	if (fp == NULL || fwrite(zero, 1, sizeof(zero), fp) != sizeof(zero)) {
+		printf("Error creating the prefetch list\n");
+		return 1;
+	}
+
+	rewind(fp);
+
+	strcpy(list->name, "bin/" PREFETCH_FILE_NAME);
+	list->size = sizeof(zero);
+	list->fp = fp;
+
+	return 0;
+}
+
+/**
+ * @brief Add the files from the prefetch profile to the prefetch list
+ *
+ * The files from the profile are laid out right after the kernel, so the
+ * kernel prefetches them at the first boot (before a new list is recorded).
+ * Block numbers are computed as in write_inodes().
+ *
+ * @param files			Array of files (the prefetch list is the last one)
+ * @param num_files		Number of files in the files array
+ * @param num_profile	Number of profile files (starting with files[2])
+ * @param superblock	Pointer to the superblock
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int write_prefetch_list(struct file_pointer_type files[], int num_files,
+						int num_profile, struct superblock *superblock) {
+	struct prefetch_list list = {0};
+	uint32_t block =
+		superblock->first_data_block +
+		bytes_to_blocks(sizeof(struct directory_entry) * (num_files + 1));
+
+	list.header.magic = PREFETCH_MAGIC;
+
+	for (int i = 1; i < num_profile + 2 && i < num_files; i++) {
+		uint32_t length = bytes_to_blocks(files[i].size);
+
+		// skip the kernel
+		if (i >= 2 && list.header.count < PREFETCH_MAX_ENTRIES) {
+			list.entries[list.header.count].inode = i + 1;
+			list.entries[list.header.count].block = block;
+			list.entries[list.header.count].length = length;
+			list.header.count++;
+		}
+
+		block += length;
+	}
+
+	FILE *fp = files[num_files - 1].fp;
+
+	if (fwrite(&list, sizeof(list), 1, fp) != 1) {
+		printf("Error writing the prefetch list\n");
+		return 1;
+	}
+
+	rewind(fp);
+
+	return 0;
+}
+
+/**
+ * @brief Parse the size option of the generator (<distribution>:<min>:<max>)
+ *
+ * @param arg		The option's argument
+ * @param options	Generator options
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int parse_size_option(char *arg, struct generator_options *options) {
+	char distribution[10];
+
+	if (sscanf(arg, "%9[a-z]:%u:%u", distribution, &options->min_size,
+			   &options->max_size) != 3 ||
+		options->min_size > options->max_size) {
+		return 1;
+	}
+
+	if (strcmp(distribution, "uniform") == 0) {
+		options->distribution = GEN_SIZE_UNIFORM;
+	} else if (strcmp(distribution, "log") == 0) {
+		options->distribution = GEN_SIZE_LOG;
+	} else {
+		return 1;
+	}
+
 	return 0;
 }
 
 void usage(void) {
 	printf("Usage:\n");
-	printf("\t./create_disk_image <image_name>\n");
+	printf("\t./create_disk_image <image_name> [-i <file>]... [-p <image>]\n"
+		   "\t\t[-g <files> [-s <distribution>:<min>:<max>] [-d <depth>]\n"
+		   "\t\t[-w <width>] [-f <percent>] [-r <seed>]]\n");
+	printf("\t-i <file>\tpack the file from bin/ into the initrd\n");
+	printf("\t-p <image>\tlay out the files from the boot prefetch list of "
+		   "the image\n\t\t\tcontiguously, right after the kernel\n");
+	printf("\t-g <files>\tgenerate a tree with the given number of files in "
+		   "/%s\n",
+		   GEN_DIR_NAME);
+	printf("\t-s <d>:<min>:<max>\tsizes of the generated files in bytes, "
+		   "uniform or log\n\t\t\tdistribution (default: log:0:16384)\n");
+	printf("\t-d <depth>\tdirectory levels, /%s included (default: 1)\n",
+		   GEN_DIR_NAME);
+	printf("\t-w <width>\tsubdirectories per directory (default: 4)\n");
+	printf("\t-f <percent>\tfiles split into interleaved extents (default: "
+		   "0)\n");
+	printf("\t-r <seed>\tseed of the generator (default: 1)\n");
 }
 
 int main(int argc, char *argv[]) {
-	int found = 0, ret, total_file_blocks, num_files = 0;
+	int found = 0, ret, total_file_blocks = 0, num_files = 0;
 	char image_name[20];
+	char *initrd_files[INITRD_MAX_FILES];
+	int num_initrd_files = 0;
+	char *profile_image = NULL;
+	char profile_files[PREFETCH_MAX_ENTRIES][60];
+	int num_profile_files = 0;
+	struct generator_options gen_options = {.min_size = 0,
+											 .max_size = 16384,
+											 .distribution = GEN_SIZE_LOG,
+											 .depth = 1,
+											 .width = 4,
+											 .fragmented = 0,
+											 .seed = 1};
+	struct generated_tree gen_tree = {0}, *tree = NULL;
+	int generate = 0;
+
+	if (argc < 2 || strlen(argv[1]) >= sizeof(image_name)) {
+		usage();
+		return 1;
+	}
+
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			profile_image = argv[++i];
+			continue;
+		}
+
+		// synthetic tree generator
+		if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+			gen_options.files = atoi(argv[++i]);
+			generate = 1;
+			continue;
+		}
+
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			if (parse_size_option(argv[++i], &gen_options)) {
+				usage();
+				return 1;
+			}
+			continue;
+		}
 
-	if (argc != 2) {
+		if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			gen_options.depth = atoi(argv[++i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+			gen_options.width = atoi(argv[++i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			gen_options.fragmented = atoi(argv[++i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			gen_options.seed = atoi(argv[++i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "-i") != 0 || i + 1 == argc ||
+			num_initrd_files == INITRD_MAX_FILES) {
+			usage();
+			return 1;
+		}
+
+		initrd_files[num_initrd_files++] = argv[++i];
+	}
+
+	if (gen_options.depth == 0 || gen_options.width == 0 ||
+		gen_options.width > GEN_MAX_DIRS || gen_options.fragmented > 100) {
 		usage();
 		return 1;
 	}
 
+	// read the profile before the image is overwritten (it can be the same)
+	if (profile_image != NULL &&
+		read_prefetch_profile(profile_image, profile_files,
+							  &num_profile_files)) {
+		return 1;
+	}
+
 	strcpy(image_name, argv[1]);
 	FILE *image_fp = fopen(image_name, "wb"), *files_fp;
 
@@ -568,8 +1403,9 @@ int main(int argc, char *argv[]) {
 	fscanf(files_fp, "%d", &num_files);
 	pclose(files_fp);
 
-	// allocate memory for the files array
-	struct file_pointer_type files[num_files];
+	// allocate memory for the files array (and the initrd and the prefetch
+	// list, added last)
+	struct file_pointer_type files[num_files + 2];
 
 	// get the file names
 	files_fp = popen("ls bin", "r");
@@ -626,6 +1462,23 @@ int main(int argc, char *argv[]) {
 		strcpy(files[i].name, file_path);
 	}
 
+	// files from the prefetch profile come right after the kernel, in the
+	// order in which they were loaded
+	int next_profile_file = 2;
+
+	for (int i = 0; i < num_profile_files; i++) {
+		for (int j = next_profile_file; j < num_files; j++) {
+			if (strcmp(files[j].name + 4, profile_files[i]) == 0) {
+				struct file_pointer_type temp = files[next_profile_file];
+				files[next_profile_file++] = files[j];
+				files[j] = temp;
+				break;
+			}
+		}
+	}
+
+	num_profile_files = next_profile_file - 2;
+
 	// open the files and get their sizes
 	for (uint32_t i = 0; i < num_files; i++) {
 		files[i].fp = fopen(files[i].name, "rb");
@@ -636,6 +1489,76 @@ int main(int argc, char *argv[]) {
 		total_file_blocks += bytes_to_blocks(files[i].size);
 	}
 
+	// the initrd is a regular file in the root directory
+	if (num_initrd_files > 0) {
+		for (uint32_t i = 0; i < num_files; i++) {
+			if (strcmp(files[i].name, "bin/" INITRD_FILE_NAME) == 0) {
+				printf("Error: bin/%s is reserved for the initrd\n",
+					   INITRD_FILE_NAME);
+				return 1;
+			}
+		}
+
+		ret = create_initrd(initrd_files, num_initrd_files, &files[num_files]);
+
+		if (ret) {
+			printf("Error creating the initrd\n");
+			return 1;
+		}
+
+		total_file_blocks += bytes_to_blocks(files[num_files].size);
+		num_files++;
+	}
+
+	// the prefetch list is always the last file
+	for (uint32_t i = 0; i < num_files; i++) {
+		if (strcmp(files[i].name, "bin/" PREFETCH_FILE_NAME) == 0) {
+			printf("Error: bin/%s is reserved for the prefetch list\n",
+				   PREFETCH_FILE_NAME);
+			return 1;
+		}
+	}
+
+	ret = create_prefetch_list(&files[num_files]);
+
+	if (ret) {
+		return 1;
+	}
+
+	total_file_blocks += bytes_to_blocks(files[num_files].size);
+	num_files++;
+
+	// the generated tree is added to the root directory as /gen, and its ids
+	// follow the ids of the other files
+	if (generate) {
+		for (uint32_t i = 0; i < num_files; i++) {
+			if (strcmp(files[i].name, "bin/" GEN_DIR_NAME) == 0) {
+				printf("Error: bin/%s is reserved for the generated tree\n",
+					   GEN_DIR_NAME);
+				return 1;
+			}
+		}
+
+		ret = generate_tree(&gen_options, num_files + 1, &gen_tree);
+
+		if (ret) {
+			return 1;
+		}
+
+		tree = &gen_tree;
+		total_file_blocks += tree->blocks;
+	}
+
+	// the bootloader loads the kernel right after the root directory block,
+	// and the bitmaps are one block each
+	if ((num_files + 1 + generate) * sizeof(struct directory_entry) >
+			FS_BLOCK_SIZE ||
+		num_files + 1 + gen_tree.count > FS_BLOCK_SIZE * 8 ||
+		total_file_blocks + 1 > FS_BLOCK_SIZE * 8) {
+		printf("Error: too many files or blocks for the image\n");
+		return 1;
+	}
+
 	for (uint32_t i = 0; i < num_files; i++) {
 		printf("\t%s - size: %d bytes\n", files[i].name, files[i].size);
 	}
@@ -654,13 +1577,19 @@ int main(int argc, char *argv[]) {
 	// create superblock
 	struct superblock superblock = {0};
 	ret = write_superblock(&superblock, files, image_fp, num_files,
-						   total_file_blocks);
+						   total_file_blocks, tree);
 
 	if (ret) {
 		printf("Error creating the superblock\n");
 		return 1;
 	}
 
+	ret = write_prefetch_list(files, num_files, num_profile_files, &superblock);
+
+	if (ret) {
+		return 1;
+	}
+
 	// write inode bitmap
 	ret = write_inode_bitmap(image_fp, &superblock);
 
@@ -678,7 +1607,7 @@ int main(int argc, char *argv[]) {
 	}
 
 	// write inodes
-	ret = write_inodes(image_fp, num_files, &superblock, files);
+	ret = write_inodes(image_fp, num_files, &superblock, files, tree);
 
 	if (ret) {
 		printf("Error creating the inodes\n");
@@ -686,7 +1615,7 @@ int main(int argc, char *argv[]) {
 	}
 
 	// write data
-	ret = write_data(image_fp, num_files, &superblock, files);
+	ret = write_data(image_fp, num_files, &superblock, files, tree);
 
 	if (ret) {
 		printf("Error writing the data blocks\n");
@@ -697,6 +1626,7 @@ int main(int argc, char *argv[]) {
 		fclose(files[i].fp);
 	}
 
+	free(gen_tree.files);
 	fclose(image_fp);
 	return 0;
 }
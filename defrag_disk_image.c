@@ -0,0 +1,736 @@
+/**
+ * Defragment an existing OS disk image (created by create_disk_image and
+ * possibly modified by the kernel). The image is rewritten in place:
+ *
+ * - every file is stored in a single extent, with no gaps between files
+ * - the files from the access profile are placed first (right after the
+ *   kernel), in the order in which they were accessed
+ * - the data of each directory is placed right before the data of its files,
+ *   and the children of a directory get consecutive inode ids
+ *
+ * The root directory (one block) and the kernel (inode 2) stay at the
+ * beginning of the data blocks, where the bootloader expects them. The access
+ * profile is the boot prefetch list recorded in the image, or a file with one
+ * path per line (-p). The prefetch list is rewritten for the new layout.
+ */
+#include "kernel/include/disk/prefetch.h"
+#include "kernel/include/kernel/fs.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROOT_ID	  1
+#define KERNEL_ID 2 // the bootloader loads the kernel from the second inode
+
+struct image {
+	uint8_t *data;
+	uint32_t size;
+	struct superblock *superblock;
+	struct inode_block *inodes;
+	uint32_t total_inodes;
+};
+
+struct layout {
+	uint32_t *new_id;	   // new inode id of every old inode, 0 if not set
+	uint32_t *new_block;   // new first data block of every old inode
+	uint8_t *placed;	   // set when the inode's data was placed
+	uint8_t *visited;	   // set when the directory was visited
+	uint32_t next_id;	   // next free inode id
+	uint32_t next_block;   // next free data block
+	uint32_t *profile;	   // old inode ids, in the order they were accessed
+	uint32_t profile_size; // number of inodes in the profile
+};
+
+/**
+ * @brief Get the pointer to the given block of the image
+ *
+ * @param image The image
+ * @param block The block number
+ *
+ * @return Pointer to the block, NULL if the block is outside the image
+ */
+uint8_t *get_block(struct image *image, uint32_t block) {
+	if ((uint64_t) (block + 1) * FS_BLOCK_SIZE > image->size) {
+		return NULL;
+	}
+
+	return image->data + block * FS_BLOCK_SIZE;
+}
+
+/**
+ * @brief Get the inode with the given id
+ *
+ * @return The inode, NULL if the id is invalid or the inode is not used
+ */
+struct inode_block *get_inode(struct image *image, uint32_t id) {
+	if (id == 0 || id >= image->total_inodes || image->inodes[id].id != id) {
+		return NULL;
+	}
+
+	return image->inodes + id;
+}
+
+/**
+ * @brief Count the extents of a file
+ *
+ * @param inode The file's inode
+ *
+ * @return Number of extents needed to store the file's data
+ */
+uint32_t count_extents(struct inode_block *inode) {
+	uint32_t blocks = bytes_to_blocks(inode->size_bytes);
+	uint32_t extents = 0;
+
+	for (int i = 0; i < 4 && blocks > 0; i++) {
+		if (inode->extent[i].length == 0) {
+			continue;
+		}
+
+		// extents that continue the previous one are not a new extent
+		if (i == 0 ||
+			inode->extent[i].first_block != inode->extent[i - 1].first_block +
+												inode->extent[i - 1].length) {
+			extents++;
+		}
+
+		blocks -= inode->extent[i].length < blocks ? inode->extent[i].length
+												   : blocks;
+	}
+
+	return extents;
+}
+
+/**
+ * @brief Print the number of extents of all the files in the image
+ *
+ * @param image The image
+ * @param when	Printed before the counts
+ */
+void print_extents(struct image *image, const char *when) {
+	uint32_t files = 0, extents = 0, fragmented = 0;
+
+	for (uint32_t id = 1; id < image->total_inodes; id++) {
+		struct inode_block *inode = get_inode(image, id);
+
+		if (inode == NULL) {
+			continue;
+		}
+
+		uint32_t count = count_extents(inode);
+
+		files++;
+		extents += count;
+
+		if (count > 1) {
+			fragmented++;
+		}
+	}
+
+	printf("%s: %d files, %d extents, %d files with more than one extent\n",
+		   when, files, extents, fragmented);
+}
+
+/**
+ * @brief Copy the data of a file into a contiguous buffer
+ *
+ * @param image		The image
+ * @param inode		The file's inode
+ * @param buffer	Buffer of bytes_to_blocks(size) blocks
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int read_file(struct image *image, struct inode_block *inode,
+			  uint8_t *buffer) {
+	uint32_t blocks = bytes_to_blocks(inode->size_bytes);
+	uint32_t read_blocks = 0;
+
+	for (int i = 0; i < 4 && read_blocks < blocks; i++) {
+		for (uint32_t j = 0;
+			 j < inode->extent[i].length && read_blocks < blocks; j++) {
+			uint8_t *block = get_block(image, inode->extent[i].first_block + j);
+
+			if (block == NULL) {
+				printf("Error: block of inode %d outside the image\n",
+					   inode->id);
+				return 1;
+			}
+
+			memcpy(buffer + read_blocks * FS_BLOCK_SIZE, block, FS_BLOCK_SIZE);
+			read_blocks++;
+		}
+	}
+
+	if (read_blocks < blocks) {
+		printf("Error: inode %d has more data than its direct extents\n",
+			   inode->id);
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Get the directory entries of a directory
+ *
+ * @param image The image
+ * @param dir	The directory's inode (has to be stored in one extent, as
+ *				create_disk_image does, if not, the defragmentation is refused)
+ * @param count Filled with the number of entries
+ *
+ * @return The entries, NULL if error occured
+ */
+struct directory_entry *get_entries(struct image *image,
+									struct inode_block *dir, uint32_t *count) {
+	uint8_t *block = get_block(image, dir->extent[0].first_block);
+
+	if (block == NULL ||
+		dir->extent[0].length < bytes_to_blocks(dir->size_bytes) ||
+		get_block(image, dir->extent[0].first_block + dir->extent[0].length -
+							 1) == NULL) {
+		printf("Error: directory %d is not stored contiguously\n", dir->id);
+		return NULL;
+	}
+
+	*count = dir->size_bytes / sizeof(struct directory_entry);
+
+	return (struct directory_entry *) block;
+}
+
+/**
+ * @brief Check if the directory entry is . or ..
+ */
+int is_dot_entry(struct directory_entry *entry) {
+	return strcmp((char *) entry->name, ".") == 0 ||
+		   strcmp((char *) entry->name, "..") == 0;
+}
+
+/**
+ * @brief Find a file by its path (absolute, separated by '/')
+ *
+ * @return The id of the file, 0 if not found
+ */
+uint32_t find_path(struct image *image, char *path) {
+	uint32_t id = ROOT_ID;
+	char *name = strtok(path, "/");
+
+	while (name != NULL) {
+		struct inode_block *dir = get_inode(image, id);
+		struct directory_entry *entries;
+		uint32_t count;
+
+		if (dir == NULL || dir->file_type != FILETYPE_DIR ||
+			(entries = get_entries(image, dir, &count)) == NULL) {
+			return 0;
+		}
+
+		id = 0;
+
+		for (uint32_t i = 0; i < count; i++) {
+			if (entries[i].id != 0 && strcmp((char *) entries[i].name, name) == 0) {
+				id = entries[i].id;
+				break;
+			}
+		}
+
+		if (id == 0) {
+			return 0;
+		}
+
+		name = strtok(NULL, "/");
+	}
+
+	return id;
+}
+
+/**
+ * @brief Add a file to the access profile (only its first access is kept)
+ */
+void add_to_profile(struct image *image, struct layout *layout, uint32_t id) {
+	if (get_inode(image, id) == NULL || id == ROOT_ID || id == KERNEL_ID) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < layout->profile_size; i++) {
+		if (layout->profile[i] == id) {
+			return;
+		}
+	}
+
+	layout->profile[layout->profile_size++] = id;
+}
+
+/**
+ * @brief Read the access profile from a file with one path per line
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int read_profile_file(struct image *image, struct layout *layout,
+					  char *profile_name) {
+	char line[MAX_PATH_LENGTH];
+	FILE *fp = fopen(profile_name, "r");
+
+	if (fp == NULL) {
+		printf("Error: %s not found\n", profile_name);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		line[strcspn(line, "\r\n")] = '\0';
+
+		if (line[0] == '\0') {
+			continue;
+		}
+
+		uint32_t id = find_path(image, line);
+
+		if (id == 0) {
+			printf("warning: profile file not in the image: %s\n", line);
+			continue;
+		}
+
+		add_to_profile(image, layout, id);
+	}
+
+	fclose(fp);
+
+	return 0;
+}
+
+/**
+ * @brief Read the access profile from the boot prefetch list of the image
+ *
+ * @param list_id Id of the prefetch list, 0 if the image doesn't have one
+ */
+void read_profile_list(struct image *image, struct layout *layout,
+					   uint32_t list_id) {
+	struct inode_block *inode = get_inode(image, list_id);
+
+	if (inode == NULL || inode->size_bytes < sizeof(struct prefetch_list)) {
+		return;
+	}
+
+	struct prefetch_list *list =
+		(struct prefetch_list *) get_block(image, inode->extent[0].first_block);
+
+	if (list == NULL || list->header.magic != PREFETCH_MAGIC ||
+		list->header.count > PREFETCH_MAX_ENTRIES) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < list->header.count; i++) {
+		if (list->entries[i].inode != list_id) {
+			add_to_profile(image, layout, list->entries[i].inode);
+		}
+	}
+}
+
+/**
+ * @brief Give consecutive inode ids to the children of a directory
+ *
+ * Files get their ids before the directories, so the last directory is next
+ * to its own children, which are numbered right after.
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int number_children(struct image *image, struct layout *layout, uint32_t id) {
+	struct directory_entry *entries;
+	uint32_t count;
+
+	if ((entries = get_entries(image, get_inode(image, id), &count)) == NULL) {
+		return 1;
+	}
+
+	for (int dirs = 0; dirs < 2; dirs++) {
+		for (uint32_t i = 0; i < count; i++) {
+			struct inode_block *child = get_inode(image, entries[i].id);
+
+			if (child == NULL || is_dot_entry(entries + i) ||
+				layout->new_id[child->id] != 0 ||
+				(child->file_type == FILETYPE_DIR) != dirs) {
+				continue;
+			}
+
+			layout->new_id[child->id] = layout->next_id++;
+		}
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		struct inode_block *child = get_inode(image, entries[i].id);
+
+		// visit every directory only once (from its first entry)
+		if (child == NULL || is_dot_entry(entries + i) ||
+			child->file_type != FILETYPE_DIR || layout->visited[child->id]) {
+			continue;
+		}
+
+		layout->visited[child->id] = 1;
+
+		if (number_children(image, layout, child->id)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Give the next data blocks to the inode
+ */
+void place_inode(struct image *image, struct layout *layout, uint32_t id) {
+	struct inode_block *inode = get_inode(image, id);
+
+	if (inode == NULL || layout->placed[id]) {
+		return;
+	}
+
+	layout->placed[id] = 1;
+	layout->new_block[id] = layout->next_block;
+	layout->next_block += bytes_to_blocks(inode->size_bytes);
+}
+
+/**
+ * @brief Place the data of a directory and, right after it, of its children
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int place_children(struct image *image, struct layout *layout, uint32_t id) {
+	struct directory_entry *entries;
+	uint32_t count;
+
+	place_inode(image, layout, id);
+
+	if ((entries = get_entries(image, get_inode(image, id), &count)) == NULL) {
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		struct inode_block *child = get_inode(image, entries[i].id);
+
+		if (child != NULL && !is_dot_entry(entries + i) &&
+			child->file_type != FILETYPE_DIR) {
+			place_inode(image, layout, child->id);
+		}
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		struct inode_block *child = get_inode(image, entries[i].id);
+
+		if (child == NULL || is_dot_entry(entries + i) ||
+			child->file_type != FILETYPE_DIR || layout->visited[child->id]) {
+			continue;
+		}
+
+		layout->visited[child->id] = 1;
+
+		if (place_children(image, layout, child->id)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Compute the new inode ids and data blocks
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int compute_layout(struct image *image, struct layout *layout) {
+	uint32_t total_inodes = image->total_inodes;
+
+	// inode ids: root, kernel, then the children of each directory
+	layout->new_id[ROOT_ID] = ROOT_ID;
+	layout->new_id[KERNEL_ID] = KERNEL_ID;
+	layout->next_id = KERNEL_ID + 1;
+	layout->visited[ROOT_ID] = 1;
+
+	if (number_children(image, layout, ROOT_ID)) {
+		return 1;
+	}
+
+	// inodes that are not in any directory keep their data
+	for (uint32_t id = 1; id < total_inodes; id++) {
+		if (get_inode(image, id) != NULL && layout->new_id[id] == 0) {
+			layout->new_id[id] = layout->next_id++;
+		}
+	}
+
+	// data blocks: root directory, kernel, profile, then the directories
+	memset(layout->visited, 0, total_inodes);
+	layout->visited[ROOT_ID] = 1;
+	layout->next_block = image->superblock->first_data_block;
+
+	place_inode(image, layout, ROOT_ID);
+
+	if (layout->next_block != image->superblock->first_data_block + 1) {
+		printf("Error: the root directory has to fit in one block\n");
+		return 1;
+	}
+
+	place_inode(image, layout, KERNEL_ID);
+
+	for (uint32_t i = 0; i < layout->profile_size; i++) {
+		place_inode(image, layout, layout->profile[i]);
+	}
+
+	if (place_children(image, layout, ROOT_ID)) {
+		return 1;
+	}
+
+	for (uint32_t id = 1; id < total_inodes; id++) {
+		place_inode(image, layout, id);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Write the files in their new place and update the metadata
+ *
+ * @param image		The image (modified in place)
+ * @param layout	The computed layout
+ * @param list_id	Old id of the prefetch list, 0 if the image doesn't have one
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+int write_layout(struct image *image, struct layout *layout,
+				 uint32_t list_id) {
+	struct superblock *superblock = image->superblock;
+	uint32_t total_inodes = image->total_inodes;
+	uint32_t first_data_block = superblock->first_data_block;
+	uint32_t data_size = (layout->next_block - first_data_block) * FS_BLOCK_SIZE;
+	uint32_t inodes_size = superblock->inode_blocks * FS_BLOCK_SIZE;
+
+	if (get_block(image, layout->next_block - 1) == NULL) {
+		printf("Error: the files don't fit in the image\n");
+		return 1;
+	}
+
+	uint8_t *data = calloc(1, data_size);
+	struct inode_block *inodes = calloc(1, inodes_size);
+
+	if (data == NULL || inodes == NULL) {
+		printf("Error: out of memory\n");
+		goto err;
+	}
+
+	for (uint32_t id = 1; id < total_inodes; id++) {
+		struct inode_block *inode = get_inode(image, id);
+
+		if (inode == NULL) {
+			continue;
+		}
+
+		uint32_t new_id = layout->new_id[id];
+		uint32_t blocks = bytes_to_blocks(inode->size_bytes);
+		uint8_t *file = data + (layout->new_block[id] - first_data_block) *
+								   FS_BLOCK_SIZE;
+
+		if (read_file(image, inode, file)) {
+			goto err;
+		}
+
+		inodes[new_id] = *inode;
+		inodes[new_id].id = new_id;
+		inodes[new_id].size_sectors = bytes_to_sectors(inode->size_bytes);
+		memset(inodes[new_id].extent, 0, sizeof(inodes[new_id].extent));
+
+		if (blocks > 0) {
+			inodes[new_id].extent[0].first_block = layout->new_block[id];
+			inodes[new_id].extent[0].length = blocks;
+		}
+
+		if (inode->file_type != FILETYPE_DIR) {
+			continue;
+		}
+
+		// directory entries refer to the new ids
+		struct directory_entry *entries = (struct directory_entry *) file;
+
+		for (uint32_t i = 0; i < inode->size_bytes / sizeof(*entries); i++) {
+			if (entries[i].id != 0 && entries[i].id < total_inodes) {
+				entries[i].id = layout->new_id[entries[i].id];
+			}
+		}
+	}
+
+	// the prefetch list now describes the new place of the profile files
+	if (list_id != 0 && get_inode(image, list_id)->size_bytes >=
+							sizeof(struct prefetch_list)) {
+		struct prefetch_list *list =
+			(struct prefetch_list *) (data + (layout->new_block[list_id] -
+											  first_data_block) *
+												 FS_BLOCK_SIZE);
+
+		memset(list, 0, sizeof(*list));
+		list->header.magic = PREFETCH_MAGIC;
+
+		for (uint32_t i = 0;
+			 i < layout->profile_size && i < PREFETCH_MAX_ENTRIES; i++) {
+			uint32_t id = layout->profile[i];
+			struct inode_block *inode = get_inode(image, id);
+
+			list->entries[i].inode = layout->new_id[id];
+			list->entries[i].block = layout->new_block[id];
+			list->entries[i].length = bytes_to_blocks(inode->size_bytes);
+			list->header.count++;
+		}
+	}
+
+	// replace the inodes, the data and clear the blocks that are now free
+	memcpy(image->inodes, inodes, inodes_size);
+	memcpy(get_block(image, first_data_block), data, data_size);
+	memset(get_block(image, layout->next_block), 0,
+		   image->size - layout->next_block * FS_BLOCK_SIZE);
+
+	// update the superblock and the bitmaps (the root directory block is not
+	// counted in data_blocks, as in create_disk_image)
+	superblock->total_inodes = layout->next_id;
+	superblock->data_blocks = layout->next_block - first_data_block - 1;
+	superblock->first_free_inode_bit = layout->next_id;
+	superblock->first_free_data_bit = layout->next_block - first_data_block;
+
+	uint8_t *bitmap = get_block(image, superblock->first_inode_bitmap_block);
+
+	memset(bitmap, 0, superblock->inode_bitmap_blocks * FS_BLOCK_SIZE);
+
+	for (uint32_t i = 0; i < superblock->total_inodes; i++) {
+		bitmap[i / 8] |= 1 << (i % 8);
+	}
+
+	bitmap = get_block(image, superblock->first_data_bitmap_block);
+	memset(bitmap, 0, superblock->data_bitmap_blocks * FS_BLOCK_SIZE);
+
+	for (uint32_t i = 0; i < superblock->first_free_data_bit; i++) {
+		bitmap[i / 8] |= 1 << (i % 8);
+	}
+
+	free(data);
+	free(inodes);
+	return 0;
+
+err:
+	free(data);
+	free(inodes);
+	return 1;
+}
+
+void usage(void) {
+	printf("Usage:\n");
+	printf("\t./defrag_disk_image <image_name> [-p <profile>]\n");
+	printf("\t-p <profile>\tfile with the paths of the files to place first, "
+		   "one per line\n\t\t\t(default: the boot prefetch list of the "
+		   "image)\n");
+}
+
+int main(int argc, char *argv[]) {
+	struct image image = {0};
+	struct layout layout = {0};
+	char *profile_name = NULL;
+	int ret = 1;
+
+	if (argc != 2 && (argc != 4 || strcmp(argv[2], "-p") != 0)) {
+		usage();
+		return 1;
+	}
+
+	if (argc == 4) {
+		profile_name = argv[3];
+	}
+
+	FILE *image_fp = fopen(argv[1], "r+b");
+
+	if (image_fp == NULL) {
+		printf("Error: %s not found\n", argv[1]);
+		return 1;
+	}
+
+	fseek(image_fp, 0, SEEK_END);
+	image.size = ftell(image_fp);
+	rewind(image_fp);
+
+	image.data = malloc(image.size);
+
+	if (image.data == NULL ||
+		fread(image.data, 1, image.size, image_fp) != image.size) {
+		printf("Error reading %s\n", argv[1]);
+		goto out;
+	}
+
+	// superblock is the second block
+	image.superblock = (struct superblock *) get_block(&image, 1);
+
+	if (image.superblock == NULL ||
+		get_block(&image, image.superblock->first_inode_block +
+							  image.superblock->inode_blocks - 1) == NULL ||
+		image.superblock->total_inodes >
+			image.superblock->inode_blocks *
+				(FS_BLOCK_SIZE / sizeof(struct inode_block))) {
+		printf("Error: invalid superblock\n");
+		goto out;
+	}
+
+	image.inodes = (struct inode_block *) get_block(
+		&image, image.superblock->first_inode_block);
+	image.total_inodes = image.superblock->total_inodes;
+
+	if (get_inode(&image, ROOT_ID) == NULL ||
+		get_inode(&image, KERNEL_ID) == NULL) {
+		printf("Error: root directory or kernel not found\n");
+		goto out;
+	}
+
+	layout.new_id = calloc(image.total_inodes, sizeof(uint32_t));
+	layout.new_block = calloc(image.total_inodes, sizeof(uint32_t));
+	layout.placed = calloc(image.total_inodes, sizeof(uint8_t));
+	layout.visited = calloc(image.total_inodes, sizeof(uint8_t));
+	layout.profile = calloc(image.total_inodes, sizeof(uint32_t));
+
+	if (layout.new_id == NULL || layout.new_block == NULL ||
+		layout.placed == NULL || layout.visited == NULL ||
+		layout.profile == NULL) {
+		printf("Error: out of memory\n");
+		goto out;
+	}
+
+	char list_path[] = PREFETCH_FILE_PATH;
+	uint32_t list_id = find_path(&image, list_path);
+
+	if (profile_name != NULL) {
+		if (read_profile_file(&image, &layout, profile_name)) {
+			goto out;
+		}
+	} else {
+		read_profile_list(&image, &layout, list_id);
+	}
+
+	printf("access profile: %d files\n", layout.profile_size);
+	print_extents(&image, "before");
+
+	if (compute_layout(&image, &layout) ||
+		write_layout(&image, &layout, list_id)) {
+		goto out;
+	}
+
+	print_extents(&image, "after");
+
+	rewind(image_fp);
+
+	if (fwrite(image.data, 1, image.size, image_fp) != image.size) {
+		printf("Error writing %s\n", argv[1]);
+		goto out;
+	}
+
+	ret = 0;
+
+out:
+	free(layout.new_id);
+	free(layout.new_block);
+	free(layout.placed);
+	free(layout.visited);
+	free(layout.profile);
+	free(image.data);
+	fclose(image_fp);
+	return ret;
+}
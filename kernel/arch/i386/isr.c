@@ -2,11 +2,14 @@
 #include <arch/i386/isr.h>
 #include <arch/i386/syscall.h>
 #include <kernel/elf.h>
+#include <kernel/global_addresses.h>
 #include <kernel/tty.h>
 #include <mm/vmm.h>
 #include <process/process.h>
 #include <process/scheduler.h>
 
+extern struct task_struct *current_running_task;
+
 /**
  * @brief Add the Interrupt Service Routines (ISRs) to the IDT.
  *
@@ -117,15 +120,104 @@ char *exception_messages[] = {"Division By Zero",
 							  "Reserved",
 							  "Reserved"};
 
+/**
+ * @brief Map the heap page of the running task that caused the page fault
+ *
+ * The heap grows with sbrk() without mapping memory, so the pages are mapped
+ * (zeroed) when they are first touched, by the task or by a syscall writing to
+ * its buffers. The next pages of the heap are mapped as well, up to
+ * USER_HEAP_FAULT_AROUND pages, so a dense use of the heap does not fault on
+ * every page.
+ *
+ * @param address The address that caused the page fault
+ *
+ * @return 0 if the page was mapped, 1 if the address is not in the heap (or
+ * there is no memory left)
+ */
+uint8_t page_fault_heap(uint32_t address) {
+	struct task_struct *task = current_running_task;
+
+	if (task == NULL || task->heap_start == NULL) {
+		return 1;
+	}
+
+	uint32_t start = (uint32_t) task->heap_start;
+	uint32_t end = start + task->heap_size_blocks * PAGE_SIZE;
+
+	if (address < start || address >= end) {
+		return 1;
+	}
+
+	address &= ~(PAGE_SIZE - 1);
+
+	if (map_user_zero_page(address)) {
+		return 1;
+	}
+
+	for (uint32_t i = 1, virt = address + PAGE_SIZE;
+		 i < USER_HEAP_FAULT_AROUND && virt < end; i++, virt += PAGE_SIZE) {
+		if (user_page_present(virt) || map_user_zero_page(virt)) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Map the stack page of the running task that caused the page fault
+ *
+ * Only the top page of the stack is mapped when the task starts; the stack
+ * grows down on page faults up to the task's stack limit. The guard gap under
+ * the limit is never mapped, so a stack overflow ends the task instead of
+ * running into the heap.
+ *
+ * @param address The address that caused the page fault
+ *
+ * @return 0 if the page was mapped, 1 if the address is not in the stack
+ * region (or there is no memory left)
+ */
+uint8_t page_fault_stack(uint32_t address) {
+	struct task_struct *task = current_running_task;
+
+	if (task == NULL || task->stack_limit == NULL ||
+		address < (uint32_t) task->stack_limit ||
+		address >= KERNEL_VIRT_ADDR) {
+		return 1;
+	}
+
+	return map_user_zero_page(address & ~(PAGE_SIZE - 1));
+}
+
 /**
  * @brief Page fault handler function
  *
- * This is a basic page fault handler function that only prints information
- * about the page fault and halts the system.
+ * Faults on pages that are not present yet in the heap, the stack or the
+ * segments of the running task are resolved by mapping them, and writes to
+ * pages shared by a fork are resolved by copying them. For the others, this
+ * function prints information about the page fault and ends the task (also
+ * when a syscall faults on a user address, e.g. read() into the read-only text
+ * of the program), or halts the system if the fault happened in the kernel.
  *
  * @param r Pointer to the interrupt registers struct
  */
 void page_fault_handler(struct interrupt_regs *r) {
+	// CR2 has the address that caused the page fault
+	uint32_t address = 0;
+	__asm__ __volatile__("movl %%cr2, %0" : "=r"(address));
+
+	// pages of the heap, stack and segments are mapped on first touch
+	if (!(r->err_code & 0x1) &&
+		(page_fault_heap(address) == 0 || page_fault_stack(address) == 0 ||
+		 elf_page_fault(address) == 0)) {
+		return;
+	}
+
+	// pages shared by a fork are copied on the first write
+	if ((r->err_code & 0x3) == 0x3 && copy_on_write_page(address) == 0) {
+		return;
+	}
+
 	printkc(4, "%s\n", exception_messages[r->int_no]);
 	printk("Error Code: %d\n", r->err_code);
 
@@ -153,10 +245,6 @@ void page_fault_handler(struct interrupt_regs *r) {
 		printk("#PF occured during an instruction fetch\n");
 	}
 
-	// CR2 has the address that caused the page fault
-	uint32_t address = 0;
-	__asm__ __volatile__("movl %%cr2, %0" : "=r"(address));
-
 	printk("Bad Address: %x\n", address);
 
 	printk("cr2: %x ds: %x edi: %x esi: %x\n", r->cr2, r->ds, r->edi, r->esi);
@@ -166,9 +254,13 @@ void page_fault_handler(struct interrupt_regs *r) {
 	printk("eip: %x cs: %x eflags: %x useresp: %x ss: %x\n", r->eip, r->cs,
 		   r->eflags, r->useresp, r->ss);
 
-	// if processor was in ring 3, then terminate task and return to scheduler
-	if (r->err_code & 0x4) {
+	// if processor was in ring 3, or a syscall of a user task touched a bad
+	// user address, then terminate task and return to scheduler
+	if ((r->err_code & 0x4) ||
+		(current_running_task != NULL && current_running_task->ring == 3 &&
+		 address < KERNEL_VIRT_ADDR)) {
 		printk("Segmentation fault\n");
+		current_running_task->exit_code = 1;
 
 		// cleanup elf data
 		elf_after_program_execution(1);
@@ -176,7 +268,8 @@ void page_fault_handler(struct interrupt_regs *r) {
 		// restore kernel virtual address space
 		restore_kernel_address_space();
 
-		extern struct task_struct *current_running_task;
+		// close the files left open
+		fd_table_destroy(current_running_task);
 
 		current_running_task->state = TASK_TERMINATED;
 		while (1) {
@@ -5,7 +5,6 @@
 #include <kernel/io.h>
 #include <kernel/list.h>
 #include <kernel/tty.h>
-#include <mm/kmalloc.h>
 #include <process/process.h>
 #include <process/scheduler.h>
 
@@ -45,7 +44,7 @@ void PIT_IRQ0_handler(struct interrupt_regs *r) {
 	}
 
 	if (kstack_to_free != NULL) {
-		kfree(kstack_to_free - KSTACK_SIZE);
+		free_kstack(kstack_to_free);
 		kstack_to_free = NULL;
 	}
 
@@ -0,0 +1,78 @@
+#include <arch/i386/serial.h>
+#include <kernel/io.h>
+
+uint8_t serial_present;
+uint8_t serial_mirror; // terminal output is also written to the serial line
+
+/**
+ * @brief Initialize the first serial port (COM1)
+ *
+ * The line is set to SERIAL_BAUD_RATE, 8 data bits, no parity and one stop
+ * bit, without interrupts (the output is polled). The UART is tested in
+ * loopback mode first, so nothing is written if there is no serial port.
+ *
+ * @return 1 if there is no working serial port, 0 otherwise
+ */
+uint8_t serial_init(void) {
+	uint16_t divisor = SERIAL_MAX_BAUD / SERIAL_BAUD_RATE;
+
+	port_byte_out(COM1_PORT + SERIAL_REG_INT_ENABLE, 0x00);
+
+	// set the baud rate divisor
+	port_byte_out(COM1_PORT + SERIAL_REG_LINE_CONTROL, SERIAL_LCR_DLAB);
+	port_byte_out(COM1_PORT + SERIAL_REG_DIVISOR_LOW, divisor & 0xFF);
+	port_byte_out(COM1_PORT + SERIAL_REG_DIVISOR_HIGH, (divisor >> 8) & 0xFF);
+
+	port_byte_out(COM1_PORT + SERIAL_REG_LINE_CONTROL, SERIAL_LCR_8N1);
+	port_byte_out(COM1_PORT + SERIAL_REG_FIFO_CONTROL, SERIAL_FIFO_ENABLE);
+
+	// send a byte in loopback mode and check that it is received
+	port_byte_out(COM1_PORT + SERIAL_REG_MODEM_CONTROL,
+				  SERIAL_MCR_RTS | SERIAL_MCR_OUT2 | SERIAL_MCR_LOOPBACK);
+	port_byte_out(COM1_PORT + SERIAL_REG_DATA, 0xAE);
+
+	if (port_byte_in(COM1_PORT + SERIAL_REG_DATA) != 0xAE) {
+		return 1;
+	}
+
+	port_byte_out(COM1_PORT + SERIAL_REG_MODEM_CONTROL,
+				  SERIAL_MCR_DTR | SERIAL_MCR_RTS | SERIAL_MCR_OUT2);
+	serial_present = 1;
+
+	return 0;
+}
+
+/**
+ * @brief Write a character to the serial line
+ *
+ * Waits until the transmit register is empty. New lines are sent as CR LF.
+ *
+ * @param c The character
+ */
+void serial_putchar(char c) {
+	if (!serial_present) {
+		return;
+	}
+
+	if (c == '\n') {
+		serial_putchar('\r');
+	}
+
+	while (!(port_byte_in(COM1_PORT + SERIAL_REG_LINE_STATUS) &
+			 SERIAL_LSR_THR_EMPTY))
+		;
+
+	port_byte_out(COM1_PORT + SERIAL_REG_DATA, c);
+}
+
+/**
+ * @brief Write a string with the given size to the serial line
+ *
+ * @param data The string
+ * @param size The size of the string
+ */
+void serial_write(const char *data, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		serial_putchar(data[i]);
+	}
+}
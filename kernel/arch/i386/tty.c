@@ -1,3 +1,4 @@
+#include <arch/i386/serial.h>
 #include <kernel/global_addresses.h>
 #include <kernel/string.h>
 #include <kernel/tty.h>
@@ -255,6 +256,10 @@ void terminal_write(const char *data, size_t size) {
 	for (size_t i = 0; i < size; i++) {
 		terminal_putchar(data[i]);
 	}
+
+	if (serial_mirror) {
+		serial_write(data, size);
+	}
 }
 
 void terminal_writestring(const char *data) {
@@ -328,11 +333,25 @@ uint8_t map_framebuffer(void) {
 	int ret;
 
 	for (uint32_t i = 0, fb_start = vbe_mode->framebuffer;
-		 i < framebuffer_size_pages; i++, fb_start += PAGE_SIZE) {
+		 i < framebuffer_size_pages;) {
+		// whole 4MB chunks of the framebuffer are mapped with 4MB pages (far
+		// fewer TLB misses while drawing and scrolling)
+		if (framebuffer_size_pages - i >= PAGES_PER_TABLE &&
+			map_large_page((void *) fb_start, (void *) fb_start) == 0) {
+			i += PAGES_PER_TABLE;
+			fb_start += LARGE_PAGE_SIZE;
+			continue;
+		}
+
 		ret = map_page((void *) fb_start, (void *) fb_start);
 		if (ret) {
 			return ret;
 		}
+
+		SET_ATTRIBUTE(get_page(fb_start), PAGE_PTE_WRITABLE);
+
+		i++;
+		fb_start += PAGE_SIZE;
 	}
 
 	return 0;
@@ -524,7 +543,8 @@ void terminal_putchar(char c) {
 /**
  * @brief Write a stringwith the given size to the terminal
  *
- * This function writes a string with the given size to the terminal.
+ * This function writes a string with the given size to the terminal (and to
+ * the serial line if serial_mirror is set).
  *
  * @param data  The string to be displayed.
  * @param size  The size of the string to be displayed.
@@ -535,6 +555,10 @@ void terminal_write(const char *data, size_t size) {
 	for (i = 0; i < size; i++) {
 		terminal_putchar(data[i]);
 	}
+
+	if (serial_mirror) {
+		serial_write(data, size);
+	}
 }
 
 /**
@@ -0,0 +1,281 @@
+#include <disk/bcache.h>
+#include <disk/disk.h>
+#include <kernel/fs.h>
+#include <kernel/list.h>
+#include <kernel/string.h>
+#include <kernel/tty.h>
+#include <mm/kmalloc.h>
+
+#include <stddef.h>
+
+struct bcache_entry *bcache_entries;
+struct embedded_link bcache_lru; // most recently used entry first
+struct bcache_stats bcache_stats;
+
+/**
+ * @brief Initialize the block cache
+ *
+ * The entries are created empty, memory for the cached blocks is allocated
+ * the first time an entry is used.
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t bcache_init(void) {
+	bcache_entries = kmalloc(sizeof(struct bcache_entry) * BCACHE_ENTRIES);
+
+	if (bcache_entries == NULL) {
+		printk("out of memory\n");
+		return 1;
+	}
+
+	list_init(&bcache_lru);
+
+	for (int i = 0; i < BCACHE_ENTRIES; i++) {
+		bcache_entries[i].block = BCACHE_NO_BLOCK;
+		bcache_entries[i].data = NULL;
+		list_add_end(&bcache_lru, &bcache_entries[i].list);
+	}
+
+	bcache_stats = (struct bcache_stats) {0};
+
+	return 0;
+}
+
+/**
+ * @brief Search the cache for the given block
+ *
+ * @param block The block number
+ *
+ * @return The entry holding the block, NULL if the block is not cached
+ */
+struct bcache_entry *bcache_find(uint32_t block) {
+	struct embedded_link *cursor;
+
+	if (bcache_entries == NULL) {
+		return NULL;
+	}
+
+	list_iterate(cursor, &bcache_lru) {
+		struct bcache_entry *entry =
+			list_get_entry(cursor, struct bcache_entry, list);
+
+		if (entry->block == block) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Add a copy of the block to the cache
+ *
+ * The least recently used entry is replaced. Nothing is cached if memory for
+ * the entry cannot be allocated.
+ *
+ * @param block The block number
+ * @param data	The block's data (FS_BLOCK_SIZE bytes)
+ */
+void bcache_insert(uint32_t block, const void *data) {
+	if (bcache_entries == NULL) {
+		return;
+	}
+
+	struct bcache_entry *entry = bcache_find(block);
+
+	if (entry == NULL) {
+		entry = list_get_entry(bcache_lru.prev, struct bcache_entry, list);
+
+		if (entry->data == NULL) {
+			entry->data = kmalloc(FS_BLOCK_SIZE);
+
+			if (entry->data == NULL) {
+				return;
+			}
+		}
+	}
+
+	memcpy(entry->data, data, FS_BLOCK_SIZE);
+	entry->block = block;
+
+	list_delete(&bcache_lru, &entry->list);
+	list_add_front(&bcache_lru, &entry->list);
+}
+
+/**
+ * @brief Read blocks from the disk, without using the cache
+ *
+ * @param block The first block
+ * @param count Number of blocks
+ * @param addr	Location where the blocks will be stored
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t bcache_disk_read(uint32_t block, uint32_t count, void *addr) {
+	uint32_t sectors_per_block = FS_BLOCK_SIZE / FS_SECTOR_SIZE;
+
+	if (read_sectors(block * sectors_per_block + 1, count * sectors_per_block,
+					 (uint32_t) addr)) {
+		printk("error loading block from disk\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Read contiguous blocks through the cache
+ *
+ * Cached blocks are copied from memory, every run of missing blocks is read
+ * from the disk with one command and then added to the cache.
+ *
+ * @param block The first block
+ * @param count Number of blocks
+ * @param addr	Location where the blocks will be stored
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t bcache_read(uint32_t block, uint32_t count, void *addr) {
+	if (bcache_entries == NULL || count > BCACHE_STREAM_BLOCKS) {
+		bcache_stats.bypassed += count;
+		return bcache_disk_read(block, count, addr);
+	}
+
+	uint32_t i = 0;
+
+	while (i < count) {
+		struct bcache_entry *entry = bcache_find(block + i);
+
+		if (entry != NULL) {
+			memcpy(addr + i * FS_BLOCK_SIZE, entry->data, FS_BLOCK_SIZE);
+
+			list_delete(&bcache_lru, &entry->list);
+			list_add_front(&bcache_lru, &entry->list);
+
+			bcache_stats.hits++;
+			i++;
+			continue;
+		}
+
+		uint32_t run = 1;
+
+		while (i + run < count && bcache_find(block + i + run) == NULL) {
+			run++;
+		}
+
+		if (bcache_disk_read(block + i, run, addr + i * FS_BLOCK_SIZE)) {
+			return 1;
+		}
+
+		for (uint32_t j = i; j < i + run; j++) {
+			bcache_insert(block + j, addr + j * FS_BLOCK_SIZE);
+		}
+
+		bcache_stats.misses += run;
+		i += run;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Read blocks into the cache before they are needed
+ *
+ * Blocks that are already cached are skipped, the others are read in runs of
+ * at most BCACHE_MAX_RUN blocks (one disk command per run).
+ *
+ * @param block The first block
+ * @param count Number of blocks
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t bcache_prefetch(uint32_t block, uint32_t count) {
+	if (bcache_entries == NULL) {
+		return 1;
+	}
+
+	void *buffer = kmalloc(BCACHE_MAX_RUN * FS_BLOCK_SIZE);
+
+	if (buffer == NULL) {
+		printk("out of memory\n");
+		return 1;
+	}
+
+	uint32_t i = 0;
+
+	while (i < count) {
+		if (bcache_find(block + i) != NULL) {
+			i++;
+			continue;
+		}
+
+		uint32_t run = 1;
+
+		while (i + run < count && run < BCACHE_MAX_RUN &&
+			   bcache_find(block + i + run) == NULL) {
+			run++;
+		}
+
+		if (bcache_disk_read(block + i, run, buffer)) {
+			kfree(buffer);
+			return 1;
+		}
+
+		for (uint32_t j = 0; j < run; j++) {
+			bcache_insert(block + i + j, buffer + j * FS_BLOCK_SIZE);
+		}
+
+		bcache_stats.prefetched += run;
+		i += run;
+	}
+
+	kfree(buffer);
+
+	return 0;
+}
+
+/**
+ * @brief Drop the given blocks from the cache (called when they are written)
+ *
+ * @param block The first block
+ * @param count Number of blocks
+ */
+void bcache_invalidate(uint32_t block, uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		struct bcache_entry *entry = bcache_find(block + i);
+
+		if (entry == NULL) {
+			continue;
+		}
+
+		entry->block = BCACHE_NO_BLOCK;
+
+		list_delete(&bcache_lru, &entry->list);
+		list_add_end(&bcache_lru, &entry->list);
+	}
+}
+
+void bcache_print_stats(void) {
+	struct embedded_link *cursor;
+	uint32_t used = 0;
+
+	if (bcache_entries == NULL) {
+		printk("block cache not initialized\n");
+		return;
+	}
+
+	list_iterate(cursor, &bcache_lru) {
+		struct bcache_entry *entry =
+			list_get_entry(cursor, struct bcache_entry, list);
+
+		if (entry->block != BCACHE_NO_BLOCK) {
+			used++;
+		}
+	}
+
+	printk("block cache: %d/%d blocks used\n", used, BCACHE_ENTRIES);
+	printk("\thits: %d\n", bcache_stats.hits);
+	printk("\tmisses: %d\n", bcache_stats.misses);
+	printk("\tbypassed: %d\n", bcache_stats.bypassed);
+	printk("\tprefetched: %d\n", bcache_stats.prefetched);
+}
@@ -3,12 +3,33 @@
 
 #include <stddef.h>
 
+/**
+ * @brief Select the sectors for the next command
+ *
+ * Sectors are numbered from 1 (as in CHS addressing) and converted to the
+ * LBA28 address, so sectors past the first 256 are reached correctly.
+ *
+ * @param starting_sector	The first sector (numbered from 1)
+ * @param size				The number of sectors (at most ATA_PIO_MAX_SECTORS)
+ */
+void ata_pio_select_sectors(uint32_t starting_sector, uint32_t size) {
+	uint32_t lba = starting_sector - 1;
+
+	// a sector count of 0 means 256 sectors
+	port_byte_out(ATA_PIO_PR_SCR, size & 0xFF);
+	port_byte_out(ATA_PIO_PR_SNR, lba & 0xFF);
+	port_byte_out(ATA_PIO_PR_CLR, ((lba >> 8) & 0xFF));
+	port_byte_out(ATA_PIO_PR_CHR, ((lba >> 16) & 0xFF));
+	port_byte_out(ATA_PIO_PR_DHR, ATA_PIO_DHR_LBA | ((lba >> 24) & 0x0F));
+}
+
 /**
  * @brief Read sector from disk into main memory
  *
  * This function reads the indicated number of sectors starting with the
  * given sector and writes the data into the main mamory at the given
- * address.
+ * address. Large reads are split into commands of at most
+ * ATA_PIO_MAX_SECTORS sectors.
  *
  * @param starting_sector 	The starting sector from which to read
  * @param size				The number of sectors to read
@@ -17,11 +38,20 @@
  * @return Error code or 0 if successful
  */
 uint8_t read_sectors(uint32_t starting_sector, uint32_t size, uint32_t addr) {
-	port_byte_out(ATA_PIO_PR_SCR, size);
-	port_byte_out(ATA_PIO_PR_SNR, starting_sector & 0xFF);
-	port_byte_out(ATA_PIO_PR_CLR, ((starting_sector >> 8) & 0xFF));
-	port_byte_out(ATA_PIO_PR_CHR, ((starting_sector >> 16) & 0xFF));
-	port_byte_out(ATA_PIO_PR_DHR, ((starting_sector >> 24) & 0x0F));
+	while (size > ATA_PIO_MAX_SECTORS) {
+		uint8_t errors =
+			read_sectors(starting_sector, ATA_PIO_MAX_SECTORS, addr);
+
+		if (errors) {
+			return errors;
+		}
+
+		starting_sector += ATA_PIO_MAX_SECTORS;
+		size -= ATA_PIO_MAX_SECTORS;
+		addr += ATA_PIO_MAX_SECTORS * 512;
+	}
+
+	ata_pio_select_sectors(starting_sector, size);
 	port_byte_out(ATA_PIO_PR_SR, READ_WITH_RETRY);
 
 	// address pointer to write to
@@ -70,11 +100,20 @@ uint8_t read_sectors(uint32_t starting_sector, uint32_t size, uint32_t addr) {
  * @return Error code or 0 if successful
  */
 uint8_t write_sectors(uint32_t starting_sector, uint32_t size, uint32_t addr) {
-	port_byte_out(ATA_PIO_PR_SCR, size);
-	port_byte_out(ATA_PIO_PR_SNR, starting_sector & 0xFF);
-	port_byte_out(ATA_PIO_PR_CLR, ((starting_sector >> 8) & 0xFF));
-	port_byte_out(ATA_PIO_PR_CHR, ((starting_sector >> 16) & 0xFF));
-	port_byte_out(ATA_PIO_PR_DHR, ((starting_sector >> 24) & 0x0F));
+	while (size > ATA_PIO_MAX_SECTORS) {
+		uint8_t errors =
+			write_sectors(starting_sector, ATA_PIO_MAX_SECTORS, addr);
+
+		if (errors) {
+			return errors;
+		}
+
+		starting_sector += ATA_PIO_MAX_SECTORS;
+		size -= ATA_PIO_MAX_SECTORS;
+		addr += ATA_PIO_MAX_SECTORS * 512;
+	}
+
+	ata_pio_select_sectors(starting_sector, size);
 	port_byte_out(ATA_PIO_PR_SR, WRITE_WITH_RETRY);
 
 	// address pointer to write to
@@ -86,7 +125,7 @@ uint8_t write_sectors(uint32_t starting_sector, uint32_t size, uint32_t addr) {
 			;
 
 		for (uint32_t j = 0; j < 256; j++) {
-			port_byte_out(ATA_PIO_PR_DR, *addr_ptr);
+			port_word_out(ATA_PIO_PR_DR, *addr_ptr);
 			addr_ptr++;
 		}
 
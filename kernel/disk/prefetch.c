@@ -0,0 +1,270 @@
+#ifdef CONFIG_BOOT_PREFETCH
+
+#include <arch/i386/pit.h>
+#include <disk/bcache.h>
+#include <disk/disk.h>
+#include <disk/prefetch.h>
+#include <kernel/fs.h>
+#include <kernel/string.h>
+#include <kernel/tty.h>
+#include <kernel/vfs.h>
+#include <mm/kmalloc.h>
+#include <process/process.h>
+#include <process/scheduler.h>
+
+#include <stddef.h>
+
+extern struct superblock *superblock;
+
+struct prefetch_list *prefetch_boot_list; // recorded during the previous boot
+struct prefetch_list *prefetch_recording; // recorded during this boot
+uint8_t prefetch_recording_active;
+uint32_t prefetch_list_inode; // the list itself is not recorded
+uint32_t prefetch_list_block;
+
+/**
+ * @brief Load the list recorded during the previous boot and start recording
+ *
+ * This function reads the prefetch list file and creates the prefetch task,
+ * which replays the list and saves the new one when the recording ends. Has
+ * to be called after the scheduler is initialized.
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t prefetch_init(void) {
+	struct vfs_inode *inode = vfs_lookup(PREFETCH_FILE_PATH, FILETYPE_FILE);
+
+	if (inode == NULL) {
+		printk("%s not found\n", PREFETCH_FILE_PATH);
+		return 1;
+	}
+
+	struct inode_block disk_inode = get_inode_from_id(inode->id);
+	struct vfs_superblock *sb = inode->sb;
+
+	vfs_iput(inode);
+
+	// the list is written directly in its (only) block on the disk
+	if (sb != diskfs_get_superblock() ||
+		disk_inode.size_bytes < PREFETCH_FILE_SIZE ||
+		disk_inode.extent[0].length == 0) {
+		printk("invalid prefetch list\n");
+		return 1;
+	}
+
+	prefetch_list_inode = disk_inode.id;
+	prefetch_list_block = disk_inode.extent[0].first_block;
+
+	prefetch_boot_list = kmalloc(FS_BLOCK_SIZE);
+	prefetch_recording = kmalloc(FS_BLOCK_SIZE);
+
+	if (prefetch_boot_list == NULL || prefetch_recording == NULL) {
+		printk("out of memory\n");
+		goto err;
+	}
+
+	if (bcache_disk_read(prefetch_list_block, 1, prefetch_boot_list)) {
+		goto err;
+	}
+
+	memset(prefetch_recording, 0, FS_BLOCK_SIZE);
+	prefetch_recording->header.magic = PREFETCH_MAGIC;
+
+	char *argv[] = {"prefetch"};
+	struct task_struct *task = create_task(prefetch_task_func, 1, argv, 0);
+
+	if (task == NULL) {
+		printk("failed to create the prefetch task\n");
+		goto err;
+	}
+
+	prefetch_recording_active = 1;
+	enqueue_task(task);
+
+	return 0;
+
+err:
+	kfree(prefetch_recording);
+	kfree(prefetch_boot_list);
+	prefetch_recording = NULL;
+	prefetch_boot_list = NULL;
+	return 1;
+}
+
+/**
+ * @brief Record an extent loaded from the disk
+ *
+ * Extents already in the list are not added again.
+ *
+ * @param inode		Id of the file
+ * @param block		First block of the extent
+ * @param length	Length of the extent in blocks
+ */
+void prefetch_record(uint32_t inode, uint32_t block, uint32_t length) {
+	if (!prefetch_recording_active || inode == prefetch_list_inode ||
+		get_uptime() >= PREFETCH_RECORD_MS) {
+		return;
+	}
+
+	struct prefetch_header *header = &prefetch_recording->header;
+	struct prefetch_entry *entries = prefetch_recording->entries;
+
+	for (uint32_t i = 0; i < header->count; i++) {
+		if (entries[i].block == block && entries[i].length == length) {
+			return;
+		}
+	}
+
+	if (header->count == PREFETCH_MAX_ENTRIES) {
+		return;
+	}
+
+	entries[header->count].inode = inode;
+	entries[header->count].block = block;
+	entries[header->count].length = length;
+	header->count++;
+}
+
+/**
+ * @brief Sort the entries in disk order (insertion sort, the list is short)
+ *
+ * @param entries	The entries
+ * @param count		Number of entries
+ */
+void prefetch_sort(struct prefetch_entry *entries, uint32_t count) {
+	for (uint32_t i = 1; i < count; i++) {
+		struct prefetch_entry entry = entries[i];
+		uint32_t j = i;
+
+		while (j > 0 && entries[j - 1].block > entry.block) {
+			entries[j] = entries[j - 1];
+			j--;
+		}
+
+		entries[j] = entry;
+	}
+}
+
+/**
+ * @brief Read the blocks recorded during the previous boot into the cache
+ *
+ * The extents are sorted and merged, so the disk is read in one pass with as
+ * few commands as possible. Extents that bcache_read() would not cache are
+ * skipped, and no more blocks than the cache can hold are read. Interrupts are
+ * enabled between two disk commands, so the other tasks are not delayed.
+ */
+void prefetch_replay(void) {
+	struct prefetch_list *list = prefetch_boot_list;
+	struct prefetch_entry *entries = list->entries;
+	uint32_t count = list->header.count;
+	uint32_t first_block = superblock->first_data_block;
+	uint32_t total = 0;
+	uint32_t i = 0;
+
+	// first boot, nothing recorded yet
+	if (list->header.magic != PREFETCH_MAGIC || count > PREFETCH_MAX_ENTRIES) {
+		count = 0;
+	}
+
+	prefetch_sort(entries, count);
+
+	while (i < count && total < BCACHE_ENTRIES) {
+		uint32_t start = entries[i].block;
+		uint32_t end = start + entries[i].length;
+
+		if (entries[i].length == 0 ||
+			entries[i].length > BCACHE_STREAM_BLOCKS || start < first_block) {
+			i++;
+			continue;
+		}
+
+		// merge the following extents that overlap or touch this one
+		for (i++; i < count && entries[i].block <= end; i++) {
+			uint32_t entry_end = entries[i].block + entries[i].length;
+
+			if (entries[i].length <= BCACHE_STREAM_BLOCKS && entry_end > end) {
+				end = entry_end;
+			}
+		}
+
+		if (end - start > BCACHE_ENTRIES - total) {
+			end = start + BCACHE_ENTRIES - total;
+		}
+
+		for (uint32_t block = start; block < end; block += BCACHE_MAX_RUN) {
+			uint32_t run =
+				end - block < BCACHE_MAX_RUN ? end - block : BCACHE_MAX_RUN;
+
+			if (bcache_prefetch(block, run)) {
+				goto out;
+			}
+
+			__asm__ __volatile__("sti; nop; cli");
+		}
+
+		total += end - start;
+	}
+
+#ifdef CONFIG_VERBOSE
+	printk("prefetched %d blocks\n", total);
+#endif
+
+out:
+	kfree(prefetch_boot_list);
+	prefetch_boot_list = NULL;
+}
+
+/**
+ * @brief Write the list recorded during this boot to the disk
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t prefetch_save(void) {
+	uint32_t sectors_per_block = FS_BLOCK_SIZE / FS_SECTOR_SIZE;
+
+	bcache_invalidate(prefetch_list_block, 1);
+
+	if (write_sectors(prefetch_list_block * sectors_per_block + 1,
+					  sectors_per_block, (uint32_t) prefetch_recording)) {
+		printk("error writing block to disk\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Boot prefetch task
+ *
+ * The task replays the list recorded during the previous boot while the shell
+ * starts, then waits for the end of the recording and saves the new list.
+ * Runs with interrupts disabled, like the syscalls that use the disk.
+ *
+ * @param argc Number of arguments
+ * @param argv Arguments
+ */
+void prefetch_task_func(int argc, char *argv[]) {
+	(void) argc;
+	(void) argv;
+
+	__asm__ __volatile__("cli");
+
+	prefetch_replay();
+
+	while (get_uptime() < PREFETCH_RECORD_MS) {
+		__asm__ __volatile__("sti; hlt; cli");
+	}
+
+	prefetch_recording_active = 0;
+
+	if (prefetch_save()) {
+		printk("failed to save the prefetch list\n");
+	}
+
+	kfree(prefetch_recording);
+	prefetch_recording = NULL;
+
+	ktask_exit();
+}
+
+#endif /* CONFIG_BOOT_PREFETCH */
@@ -2,22 +2,31 @@
 #include <kernel/elf.h>
 #include <kernel/fs.h>
 #include <kernel/global_addresses.h>
+#include <kernel/initrd.h>
 #include <kernel/shell.h>
 #include <kernel/string.h>
 #include <kernel/tty.h>
 #include <kernel/utils.h>
+#include <kernel/vfs.h>
+#include <mm/frame.h>
 #include <mm/kmalloc.h>
 #include <mm/pmm.h>
+#include <mm/slab.h>
 #include <mm/vmm.h>
 #include <process/process.h>
 
 #include <stddef.h>
 
-extern int syscall_open(char *, uint32_t);
-extern int syscall_close(int);
-
 elf_phys_mem_info *elf_phys_mem_info_header = NULL;
 extern struct task_struct *current_running_task;
+extern struct slab_cache *mapping_cache;
+
+// block of the executable being copied to a page (page faults don't nest)
+static uint8_t elf_page_buffer[FS_BLOCK_SIZE];
+
+struct elf_text *elf_texts; // executables that are running
+struct elf_text_page *elf_text_pages[ELF_TEXT_BUCKETS];
+struct slab_cache *elf_text_page_cache; // created by the first shared page
 
 /**
  * @brief Add new node with the given info to list
@@ -73,22 +82,40 @@ void deallocate_elf_memory(void) {
 	}
 
 	elf_phys_mem_info_header = NULL;
+
+	// the segments are not filled from the executable any more
+	if (current_running_task->exec_inode != NULL) {
+		elf_text_put(current_running_task->exec_inode);
+		vfs_iput(current_running_task->exec_inode);
+		current_running_task->exec_inode = NULL;
+	}
 }
 
-uint8_t add_process_mapping(void *addr, uint32_t size) {
-	struct mapping *map = kmalloc(sizeof(struct mapping));
+/**
+ * @brief Add a mapping to the running task
+ *
+ * @param addr Start of the mapping
+ * @param size Size of the mapping in bytes
+ *
+ * @return The mapping (not backed by the executable), NULL if error occured
+ */
+struct mapping *add_process_mapping(void *addr, uint32_t size) {
+	struct mapping *map = slab_alloc(mapping_cache);
 
 	if (map == NULL) {
-		return 1;
+		return NULL;
 	}
 
 	map->address = addr;
 	map->size = size;
+	map->offset = 0;
+	map->file_size = 0;
+	map->flags = 0;
 	map->next = NULL;
 
 	if (current_running_task->maps == NULL) {
 		current_running_task->maps = map;
-		return 0;
+		return map;
 	}
 
 	struct mapping *tmp = current_running_task->maps;
@@ -99,7 +126,7 @@ uint8_t add_process_mapping(void *addr, uint32_t size) {
 
 	tmp->next = (struct mapping *) map;
 
-	return 0;
+	return map;
 }
 
 /**
@@ -165,20 +192,29 @@ void print_elf_header(Elf32_Ehdr *header) {
 	printk("\tSection header string table index: %d\n", header->e_shstrndx);
 }
 
+/**
+ * @brief Record the segments of the executable and set up the heap and stack
+ *
+ * The loadable segments are only recorded as mappings of the running task;
+ * their pages are filled from the executable when they are first touched (see
+ * elf_page_fault()). The first page of the heap and the top page of the stack
+ * are mapped.
+ *
+ * @param elf_address	The beginning of the file (ELF and program headers)
+ * @param ustack_start	Set to the lowest address of the stack
+ * @param ustack_end	Set to the top of the stack
+ *
+ * @return The entry point, NULL if error occured
+ */
 void *load_elf(uint32_t *elf_address, uint32_t *ustack_start,
 			   uint32_t *ustack_end) {
-	// read from loaded file and create another location in the main memory
-	// to put the data and code segments
 	Elf32_Ehdr *elf_header = (Elf32_Ehdr *) elf_address;
+	uint32_t segments_end = 0;
 
 	// print_elf_header(elf_header);
 
-	// read elf header
-	Elf32_Phdr *pr_header = NULL;
-
-	// printk("Program headers info:\n");
 	for (size_t i = 0; i < elf_header->e_phnum; i++) {
-		pr_header =
+		Elf32_Phdr *pr_header =
 			(Elf32_Phdr *) ((void *) elf_address + elf_header->e_phoff) + i;
 
 		if (pr_header->p_type != PT_LOAD) {
@@ -187,143 +223,372 @@ void *load_elf(uint32_t *elf_address, uint32_t *ustack_start,
 
 		// virtual address not allowed for a user task
 		if (pr_header->p_vaddr < LOWER_4MB_VIRT_ADDR ||
-			pr_header->p_vaddr >= KERNEL_VIRT_ADDR) {
+			pr_header->p_vaddr >= KERNEL_VIRT_ADDR ||
+			pr_header->p_memsz > KERNEL_VIRT_ADDR - pr_header->p_vaddr ||
+			pr_header->p_filesz > pr_header->p_memsz) {
 			return NULL;
 		}
 
-		// printk("\tSegment number: %d\n", i + 1);
-		// printk("\tType: %s\n", pr_header->p_type == PT_LOAD ? "Loadable
-		// program segment" :
-		//         pr_header->p_type == PT_DYNAMIC ? "Dynamic linking
-		//         information" : "Unknown");
-		// printk("\tOffset: %d\n", pr_header->p_offset);
-
-		// printk("\tSegment virtual address: %x\n", pr_header->p_vaddr);
-		// printk("\tSegment physical address: %x\n", pr_header->p_paddr);
-		// printk("\tSegment size in file: %d (bytes)\n", pr_header->p_filesz);
-		// printk("\tSegment size in memory: %d (bytes)\n", pr_header->p_memsz);
-		// printk("\tFlags: %x\n", pr_header->p_flags);
-		// printk("\tSegment alignment: %x\n", pr_header->p_align);
-		// printk("\n");
-
-		// each segment will have minimum a block of memory
-		uint8_t needed_blocks = 0;
-
-		if (pr_header->p_memsz % BLOCK_SIZE == 0) {
-			needed_blocks = pr_header->p_memsz / BLOCK_SIZE;
-		} else {
-			needed_blocks = pr_header->p_memsz / BLOCK_SIZE + 1;
+		struct mapping *map = add_process_mapping((void *) pr_header->p_vaddr,
+												  pr_header->p_memsz);
+
+		if (map == NULL) {
+			printk("out of memory!\n");
+			return NULL;
 		}
 
-		add_process_mapping((void *) pr_header->p_vaddr,
-							needed_blocks * BLOCK_SIZE);
-		// printk("segment %d needed %d blocks\n", i, needed_blocks);
+		map->offset = pr_header->p_offset;
+		map->file_size = pr_header->p_filesz;
+		map->flags = MAPPING_FILE;
 
-		// map obtained blocks to corresponding virtual addresses
-		for (uint32_t i = 0, virt = pr_header->p_vaddr; i < needed_blocks;
-			 i++, virt += PAGE_SIZE) {
-			void *addr = allocate_blocks(1);
+		// make only those pages that need to be writable writable
+		if (pr_header->p_flags & PF_W) {
+			map->flags |= MAPPING_WRITABLE;
+		}
 
-			if (addr == NULL) {
-				printk("out of memory!\n");
-				return NULL;
-			}
+		if (pr_header->p_vaddr + pr_header->p_memsz > segments_end) {
+			segments_end = pr_header->p_vaddr + pr_header->p_memsz;
+		}
+	}
 
-			map_user_page(addr, (void *) virt);
+	uint32_t stack_limit =
+		KERNEL_VIRT_ADDR - ALIGN(USER_STACK_MAX_SIZE, PAGE_SIZE);
 
-			pt_entry *page = get_page(virt);
+	// the heap needs at least one page under the stack's guard gap
+	if (segments_end == 0 ||
+		segments_end > stack_limit - USER_STACK_GUARD_SIZE - PAGE_SIZE) {
+		return NULL;
+	}
 
-			SET_ATTRIBUTE(page, PAGE_PTE_USER | PAGE_PTE_PRESENT);
+	// set the heap after the segments, initial size: 4K
+	uint32_t uheap_start = ALIGN(segments_end, PAGE_SIZE);
+#ifdef CONFIG_VERBOSE
+	uint32_t uheap_end = uheap_start + PAGE_SIZE;
+#endif
 
-			// make only those pages that need to be writable writable
-			if (pr_header->p_flags & PF_W) {
-				SET_ATTRIBUTE(page, PAGE_PTE_WRITABLE);
-			}
+	void *addr = allocate_blocks_flags(1, PMM_ZERO);
 
-			add_phys_info(addr, (void *) virt, needed_blocks);
-		}
+	if (addr == NULL) {
+		printk("out of memory\n");
+		return NULL;
+	}
+
+	map_user_page(addr, (void *) uheap_start);
 
-		// copy data from the ELF file image to the "executable location"
-		uint32_t *src, *dst;
-		uint32_t length = pr_header->p_filesz;
+	pt_entry *page = get_page(uheap_start);
 
-		src = (void *) elf_address + pr_header->p_offset;
-		dst = (void *) pr_header->p_vaddr;
+	SET_ATTRIBUTE(page, PAGE_PTE_WRITABLE);
+	SET_ATTRIBUTE(page, PAGE_PTE_USER | PAGE_PTE_PRESENT);
 
-		// first set memory to 0
-		memset(dst, 0, pr_header->p_memsz);
-		memcpy(dst, src, length);
+	add_process_mapping((void *) uheap_start, BLOCK_SIZE);
+	current_running_task->heap_start = (void *) uheap_start;
+
+	// set program break to the start of the heap
+	current_running_task->program_break = (void *) uheap_start;
+	current_running_task->heap_size_blocks = 1;
 
-		// set up the heap and stack
-		if ((int) i == elf_header->e_phnum - 1) {
-			// last program header, set heap after it, initial size: 4K
-			uint32_t uheap_start = ALIGN((uint32_t) pr_header->p_vaddr +
-											 needed_blocks * BLOCK_SIZE,
-										 PAGE_SIZE);
 #ifdef CONFIG_VERBOSE
-			uint32_t uheap_end = uheap_start + PAGE_SIZE;
+	printk("heap start: %x\n", uheap_start);
+	printk("heap end: %x\n", uheap_end);
 #endif
 
-			void *addr = allocate_blocks(1);
+	// set user stack, only its top page is mapped now (the rest on first
+	// touch, see page_fault_stack())
+	*ustack_end = KERNEL_VIRT_ADDR;
+	*ustack_start = KERNEL_VIRT_ADDR - PAGE_SIZE;
+	current_running_task->stack_limit = (void *) stack_limit;
 
-			if (addr == NULL) {
-				printk("out of memory\n");
-				return NULL;
-			}
+	// map stack
+	addr = allocate_blocks_flags(1, PMM_ZERO);
 
-			map_user_page(addr, (void *) uheap_start);
+	if (addr == NULL) {
+		printk("out of memory!\n");
+		return NULL;
+	}
 
-			pt_entry *page = get_page(uheap_start);
+	map_user_page(addr, (void *) (*ustack_start));
 
-			SET_ATTRIBUTE(page, PAGE_PTE_WRITABLE);
-			SET_ATTRIBUTE(page, PAGE_PTE_USER | PAGE_PTE_PRESENT);
+	page = get_page(*ustack_start);
 
-			add_process_mapping((void *) uheap_start, BLOCK_SIZE);
-			current_running_task->heap_start = (void *) uheap_start;
+	SET_ATTRIBUTE(page, PAGE_PTE_WRITABLE);
+	SET_ATTRIBUTE(page, PAGE_PTE_USER | PAGE_PTE_PRESENT);
 
-			// set program break to the start of the heap
-			current_running_task->program_break = (void *) uheap_start;
-			current_running_task->heap_size_blocks = 1;
+	add_phys_info(addr, (void *) (*ustack_start), 1);
+	add_process_mapping((void *) stack_limit, KERNEL_VIRT_ADDR - stack_limit);
 
 #ifdef CONFIG_VERBOSE
-			printk("heap start: %x\n", uheap_start);
-			printk("heap end: %x\n", uheap_end);
+	printk("uspace start: %x, end: %x, phys: %x\n", *ustack_start, *ustack_end,
+		   (uint32_t) addr);
 #endif
 
-			// set user stack
-			*ustack_end = KERNEL_VIRT_ADDR;
-			*ustack_start = KERNEL_VIRT_ADDR - PAGE_SIZE;
+	// return entry point to that location
+	return (void *) elf_header->e_entry;
+}
 
-			// map stack
-			addr = allocate_blocks(1);
+/**
+ * @brief Add a user to the shared pages of the executable
+ *
+ * @param inode The executable
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t elf_text_get(struct vfs_inode *inode) {
+	struct elf_text *text = elf_texts;
+
+	while (text != NULL && text->inode != inode) {
+		text = text->next;
+	}
+
+	if (text == NULL) {
+		text = kmalloc(sizeof(struct elf_text));
 
-			if (addr == NULL) {
-				printk("out of memory!\n");
-				return NULL;
+		if (text == NULL) {
+			printk("out of memory\n");
+			return 1;
+		}
+
+		text->inode = inode;
+		text->users = 0;
+		text->next = elf_texts;
+		elf_texts = text;
+	}
+
+	text->users++;
+
+	return 0;
+}
+
+/**
+ * @brief Remove a user of the shared pages of the executable
+ *
+ * When the last user is removed, the table's references to the pages are
+ * dropped (the pages are freed if no address space maps them any more).
+ *
+ * @param inode The executable
+ */
+void elf_text_put(struct vfs_inode *inode) {
+	struct elf_text **link = &elf_texts;
+
+	while (*link != NULL && (*link)->inode != inode) {
+		link = &(*link)->next;
+	}
+
+	if (*link == NULL || --(*link)->users > 0) {
+		return;
+	}
+
+	struct elf_text *text = *link;
+
+	*link = text->next;
+	kfree(text);
+
+	for (uint32_t i = 0; i < ELF_TEXT_BUCKETS; i++) {
+		struct elf_text_page **page_link = &elf_text_pages[i];
+
+		while (*page_link != NULL) {
+			struct elf_text_page *page = *page_link;
+
+			if (page->inode != inode) {
+				page_link = &page->next;
+				continue;
 			}
 
-			map_user_page(addr, (void *) (*ustack_start));
+			*page_link = page->next;
 
-			page = get_page(*ustack_start);
+			if (frame_put(page->frame) == 0) {
+				free_blocks(page->frame, 1);
+			}
 
-			SET_ATTRIBUTE(page, PAGE_PTE_WRITABLE);
-			SET_ATTRIBUTE(page, PAGE_PTE_USER | PAGE_PTE_PRESENT);
+			slab_free(elf_text_page_cache, page);
+		}
+	}
+}
 
-			add_phys_info(addr, (void *) (*ustack_start), 1);
-			add_process_mapping((void *) (*ustack_start), BLOCK_SIZE);
+/**
+ * @brief Get the bucket of the page of the executable
+ */
+static inline uint32_t elf_text_bucket(struct vfs_inode *inode,
+									   uint32_t address) {
+	return (((uint32_t) inode >> 4) ^ (address >> 12)) &
+		   (ELF_TEXT_BUCKETS - 1);
+}
 
-#ifdef CONFIG_VERBOSE
-			printk("uspace start: %x, end: %x, phys: %x\n", *ustack_start,
-				   *ustack_end, (uint32_t) addr);
-#endif
+/**
+ * @brief Find the shared frame of a page of the executable
+ *
+ * @param inode		The executable
+ * @param address	Virtual address of the page
+ *
+ * @return The frame, NULL if the page was not filled yet
+ */
+void *elf_text_find(struct vfs_inode *inode, uint32_t address) {
+	struct elf_text_page *page =
+		elf_text_pages[elf_text_bucket(inode, address)];
+
+	for (; page != NULL; page = page->next) {
+		if (page->inode == inode && page->address == address) {
+			return page->frame;
 		}
 	}
 
-	// return entry point to that location
-	// printk("info about the executable:\n");
-	// printk("entry point: %x\n", elf_header->e_entry);
+	return NULL;
+}
 
-	return (void *) elf_header->e_entry;
+/**
+ * @brief Share a filled page of the executable
+ *
+ * The table takes a reference to the frame. The page is simply not shared if
+ * there is no memory for the entry.
+ *
+ * @param inode		The executable
+ * @param address	Virtual address of the page
+ * @param frame		The frame
+ */
+void elf_text_add(struct vfs_inode *inode, uint32_t address, void *frame) {
+	if (elf_text_page_cache == NULL) {
+		elf_text_page_cache = slab_cache_create(
+			"elf_text_page", sizeof(struct elf_text_page), NULL);
+	}
+
+	struct elf_text_page *page = slab_alloc(elf_text_page_cache);
+
+	if (page == NULL) {
+		return;
+	}
+
+	if (frame_get(frame)) {
+		slab_free(elf_text_page_cache, page);
+		return;
+	}
+
+	uint32_t bucket = elf_text_bucket(inode, address);
+
+	page->inode = inode;
+	page->address = address;
+	page->frame = frame;
+	page->next = elf_text_pages[bucket];
+	elf_text_pages[bucket] = page;
+}
+
+/**
+ * @brief Fill the page of a segment that caused a page fault
+ *
+ * The page is mapped zeroed and the bytes of every segment of the running task
+ * that overlaps it are read from the executable (through the block cache for
+ * the files on the disk); the rest of the segments (.bss) stays zero. The page
+ * is writable only if one of the segments is. Read-only pages are shared with
+ * the other tasks running the same executable.
+ *
+ * @param address The address that caused the page fault
+ *
+ * @return 0 if the page was mapped, 1 if the address is not in a segment (or
+ * the page could not be filled)
+ */
+uint8_t elf_page_fault(uint32_t address) {
+	struct task_struct *task = current_running_task;
+	uint32_t page_start = address & ~(PAGE_SIZE - 1);
+	uint32_t page_end = page_start + PAGE_SIZE;
+	uint8_t found = 0, writable = 0;
+
+	if (task == NULL || task->exec_inode == NULL) {
+		return 1;
+	}
+
+	for (struct mapping *map = task->maps; map != NULL; map = map->next) {
+		uint32_t map_start = (uint32_t) map->address;
+
+		if (!(map->flags & MAPPING_FILE) || map_start >= page_end ||
+			map_start + map->size <= page_start) {
+			continue;
+		}
+
+		if (address >= map_start && address - map_start < map->size) {
+			found = 1;
+		}
+
+		if (map->flags & MAPPING_WRITABLE) {
+			writable = 1;
+		}
+	}
+
+	if (!found) {
+		return 1;
+	}
+
+	// read-only page already filled by another task running the executable
+	void *frame = writable ? NULL : elf_text_find(task->exec_inode, page_start);
+
+	if (frame != NULL && frame_get(frame) == 0) {
+		if (map_user_page(frame, (void *) page_start)) {
+			frame_put(frame);
+			return 1;
+		}
+
+		SET_ATTRIBUTE(get_page(page_start), PAGE_PTE_USER | PAGE_PTE_PRESENT);
+
+		return 0;
+	}
+
+	if (map_user_zero_page(page_start)) {
+		return 1;
+	}
+
+	for (struct mapping *map = task->maps; map != NULL; map = map->next) {
+		uint32_t map_start = (uint32_t) map->address;
+
+		if (!(map->flags & MAPPING_FILE) || map_start >= page_end ||
+			map_start + map->size <= page_start) {
+			continue;
+		}
+
+		// bytes of the page that come from the file
+		uint32_t start = map_start > page_start ? map_start : page_start;
+		uint32_t end = map_start + map->file_size < page_end
+						   ? map_start + map->file_size
+						   : page_end;
+
+		while (start < end) {
+			uint32_t offset = map->offset + (start - map_start);
+			uint32_t block_offset = offset & ~(FS_BLOCK_SIZE - 1);
+			uint32_t count = block_offset + FS_BLOCK_SIZE - offset;
+
+			if (count > end - start) {
+				count = end - start;
+			}
+
+			// whole blocks are read directly into the page
+			if (offset == block_offset && count == FS_BLOCK_SIZE) {
+				if (vfs_read_block(task->exec_inode, (void *) start,
+								   offset) != FS_BLOCK_SIZE) {
+					return 1;
+				}
+			} else {
+				size_t read = vfs_read_block(task->exec_inode, elf_page_buffer,
+											 block_offset);
+
+				if (read == (size_t) -1 || read < offset - block_offset + count) {
+					return 1;
+				}
+
+				memcpy((void *) start, elf_page_buffer + offset - block_offset,
+					   count);
+			}
+
+			start += count;
+		}
+	}
+
+	if (!writable) {
+		pt_entry *page = get_page(page_start);
+
+		CLEAR_ATTRIBUTE(page, PAGE_PTE_WRITABLE);
+		flush_tlb_entry(page_start);
+
+		elf_text_add(task->exec_inode, page_start,
+					 (void *) PAGE_GET_PHY_ADDRESS(page));
+	}
+
+	return 0;
 }
 
 void elf_after_program_execution(int return_code) {
@@ -335,7 +600,10 @@ void elf_after_program_execution(int return_code) {
 		printkc(2, "execution finished successfully\n");
 	}
 
-	shell_cleanup();
+	// the prompt is shown again when the task started by the shell exits
+	if (current_running_task->shell_task) {
+		shell_cleanup();
+	}
 }
 
 /**
@@ -415,59 +683,106 @@ void set_argc_argv(uint32_t *ustack_end) {
 	*ustack_end = (uint32_t) stack;
 }
 
-uint8_t prepare_elf_execution(int argc, char **argv) {
-	if (argc < 1) {
-		printk("argc has to be at least 1!\n");
-		return 1;
-	}
+/**
+ * @brief Look up the executable file
+ *
+ * Programs packed in the initrd are already in memory, so the initrd is
+ * searched first (by the file's basename), then the given path. The file is
+ * not opened, so its data is not loaded.
+ *
+ * @param path Path of the executable
+ *
+ * @return The referenced in-memory inode, NULL if the file was not found
+ */
+struct vfs_inode *elf_open(char *path) {
+	char initrd_path[sizeof(INITRD_MOUNT_PATH) + INITRD_NAME_LENGTH];
+	char *name = strrchr(path, '/');
+	struct vfs_inode *inode;
+
+	name = (name == NULL) ? path : name + 1;
+
+	if (strlen(name) < INITRD_NAME_LENGTH) {
+		strcpy(initrd_path, INITRD_MOUNT_PATH "/");
+		strcat(initrd_path, name);
 
-	// data from the kernel
-	extern struct open_files_table *open_files_table;
-	int ret;
+		inode = vfs_lookup(initrd_path, FILETYPE_FILE);
 
-	// open syscall to get the fd for the elf file
-	int fd = -1;
+		if (inode != NULL) {
+			return inode;
+		}
+	}
 
-	//__asm__ __volatile__ ("mov %0, %%ebx\n"
-	//                    "mov %1, %%ecx\n": : "r"(argv[0]), "r"(O_RDWR));
+	return vfs_lookup(path, FILETYPE_FILE);
+}
 
-	fd = syscall_open(argv[0], O_RDWR);
+/**
+ * @brief Find the executable and prepare its execution in the running task
+ *
+ * Only the first block of the file (ELF and program headers) is read; the
+ * segments are read when their pages are first touched. The reference to the
+ * executable is kept by the task until deallocate_elf_memory().
+ *
+ * @param path			Path of the executable
+ * @param ustack_start	Set to the lowest address of the stack
+ * @param ustack_end	Set to the top of the stack
+ *
+ * @return The entry point, NULL if error occured
+ */
+void *elf_load_exec(char *path, uint32_t *ustack_start, uint32_t *ustack_end) {
+	struct vfs_inode *inode = elf_open(path);
+	void *entry_point = NULL;
 
-	//__asm__ __volatile ("mov %%eax, %0" : "=r"(fd));
+	if (inode == NULL) {
+		printk("%s no such file or directory!\n", path);
+		return NULL;
+	}
 
-	if (fd < 0) {
-		printk("%s no such file or directory!\n", argv[0]);
-		goto err2;
+	if (elf_text_get(inode)) {
+		vfs_iput(inode);
+		return NULL;
 	}
 
-	struct open_files_table *oft_entry = open_files_table + fd;
+	current_running_task->exec_inode = inode;
 
-	ret = check_elf(oft_entry->address);
+	void *header = kmalloc(FS_BLOCK_SIZE);
 
-	if (ret) {
+	if (header == NULL) {
+		printk("out of memory\n");
+		return NULL;
+	}
+
+	size_t read = vfs_read_block(inode, header, 0);
+	Elf32_Ehdr *elf_header = header;
+
+	// the program headers have to be in the first block
+	if (read == (size_t) -1 || read < sizeof(Elf32_Ehdr) ||
+		check_elf(header) ||
+		elf_header->e_phoff + elf_header->e_phnum * sizeof(Elf32_Phdr) >
+			read) {
 		printk("file is not an executable ELF file!\n");
-		goto err;
+		goto out;
 	}
 
-	uint32_t ustack_start = 0, ustack_end = 0;
+	entry_point = load_elf(header, ustack_start, ustack_end);
 
-	// get entry point of elf
-	void *entry_point =
-		load_elf(oft_entry->address, &ustack_start, &ustack_end);
+out:
+	kfree(header);
+	return entry_point;
+}
 
-	if (entry_point == NULL) {
-		goto err;
+uint8_t prepare_elf_execution(int argc, char **argv) {
+	if (argc < 1) {
+		printk("argc has to be at least 1!\n");
+		return 1;
 	}
 
-	// close file descriptor
-	//__asm__ __volatile__ ("mov %0, %%ebx" : : "r"(fd));
-
-	ret = syscall_close(fd);
+	uint32_t ustack_start = 0, ustack_end = 0;
 
-	//__asm__ __volatile__ ("mov %%eax, %0" : "=r"(ret));
+	// get entry point of elf
+	void *entry_point = elf_load_exec(argv[0], &ustack_start, &ustack_end);
 
-	if (ret) {
-		return 1;
+	if (entry_point == NULL) {
+		goto err;
 	}
 
 	// update stack pointer to include the main function parameters argc and
@@ -485,12 +800,6 @@ uint8_t prepare_elf_execution(int argc, char **argv) {
 
 err:
 	deallocate_elf_memory();
-
-err2:
-	//__asm__ __volatile__ ("mov %0, %%ebx" : : "r"(fd));
-
-	syscall_close(fd);
-
 	restore_kernel_address_space();
 	return 1;
 }
@@ -502,50 +811,13 @@ int32_t execute_elf(int argc, char **argv) {
 		return 1;
 	}
 
-	// data from the kernel
-	extern struct open_files_table *open_files_table;
-	int ret;
-
-	// open syscall to get the fd for the elf file
-	// int fd = open(name, O_RDONLY);
-	int fd = -1;
-
-	//__asm__ __volatile__ ("mov %0, %%ebx\n"
-	//"mov %1, %%ecx\n": : "r"(argv[0]), "r"(O_RDWR));
-
-	fd = syscall_open(argv[0], O_RDWR);
-
-	//__asm__ __volatile ("mov %%eax, %0" : "=r"(fd));
-
-	if (fd < 0) {
-		printk("%s no such file or directory!\n", argv[0]);
-		goto err2;
-	}
-
-	struct open_files_table *oft_entry = open_files_table + fd;
-
-	ret = check_elf(oft_entry->address);
-
-	if (ret) {
-		printk("file is not an executable ELF file!\n");
-		goto err;
-	}
-
 	uint32_t ustack_start = 0, ustack_end = 0;
 
 	// get entry point of elf
-	void *entry_point =
-		load_elf(oft_entry->address, &ustack_start, &ustack_end);
-
-	// close file descriptor
-	//__asm__ __volatile__ ("mov %0, %%ebx" : : "r"(fd));
-
-	ret = syscall_close(fd);
-
-	//__asm__ __volatile__ ("mov %%eax, %0" : "=r"(ret));
+	void *entry_point = elf_load_exec(argv[0], &ustack_start, &ustack_end);
 
-	if (ret) {
-		return 1;
+	if (entry_point == NULL) {
+		goto err;
 	}
 
 	// update stack pointer to include the main function parameters argc and
@@ -562,12 +834,6 @@ int32_t execute_elf(int argc, char **argv) {
 
 err:
 	deallocate_elf_memory();
-
-err2:
-	//__asm__ __volatile__ ("mov %0, %%ebx" : : "r"(fd));
-
-	syscall_close(fd);
-
 	restore_kernel_address_space();
 	return 1;
 }
@@ -1,16 +1,17 @@
+#include <disk/bcache.h>
 #include <disk/disk.h>
+#include <disk/prefetch.h>
 #include <kernel/fs.h>
 #include <kernel/global_addresses.h>
 #include <kernel/string.h>
 #include <kernel/tty.h>
+#include <kernel/vfs.h>
 #include <mm/kmalloc.h>
 
 #include <stddef.h>
 
 struct superblock *superblock = (struct superblock *) SUPERBLOCK_ADDRESS;
-struct inode_block current_directory;
-struct inode_block parent_directory;
-char current_path[MAX_PATH_LENGTH];
+struct inode_block *inode_cache;
 
 void print_superblock_info(void) {
 	printk("memory layout information (from the superblock):\n");
@@ -33,7 +34,8 @@ void print_superblock_info(void) {
  * @brief Load file from disk into main memory
  *
  * This function loads a file given through its inode into main memory.
- * Memory at address has to be reserved prior to this call.
+ * Memory at address has to be reserved prior to this call. The blocks are
+ * read through the block cache.
  *
  * @param inode     The file's inode
  * @param address   Location where the file will be loaded
@@ -49,19 +51,18 @@ uint8_t load_file(struct inode_block *inode, uint32_t address) {
 	for (int i = 0;
 		 number_of_blocks > read_blocks && i < superblock->extents_per_inode;
 		 i++) {
-		uint32_t starting_sector =
-			inode->extent[0].first_block * (FS_BLOCK_SIZE / FS_SECTOR_SIZE) + 1;
-		uint32_t number_of_sectors =
-			inode->extent[i].length * (FS_BLOCK_SIZE / FS_SECTOR_SIZE);
-
-		ret =
-			read_sectors(starting_sector, number_of_sectors, address + offset);
+		ret = bcache_read(inode->extent[i].first_block,
+						  inode->extent[i].length, (void *) address + offset);
 
 		if (ret) {
-			printk("error loading block from disk\n");
 			return 1;
 		}
 
+#ifdef CONFIG_BOOT_PREFETCH
+		prefetch_record(inode->id, inode->extent[i].first_block,
+						inode->extent[i].length);
+#endif
+
 		read_blocks += inode->extent[i].length;
 		offset += (inode->extent[i].length) * FS_BLOCK_SIZE;
 	}
@@ -72,9 +73,9 @@ uint8_t load_file(struct inode_block *inode, uint32_t address) {
 /**
  * @brief Return inode corresponding to the given id
  *
- * This function loads one block with inodes at a time and searches in the
- * loaded block for the given id. If it is found, the respective inode is
- * returned, otherwise an empty inode is returned.
+ * Inodes are stored on disk in the order of their ids, and all the blocks
+ * with inodes are kept in the inode cache (loaded by fs_init()), so the inode
+ * is found by indexing the cache with the id.
  *
  * @param id The inode's id
  *
@@ -82,113 +83,60 @@ uint8_t load_file(struct inode_block *inode, uint32_t address) {
  * otherwise
  */
 struct inode_block get_inode_from_id(uint32_t id) {
-	struct inode_block result = (struct inode_block) {0};
-	void *addr = kmalloc(FS_BLOCK_SIZE);
-
-	if (addr == NULL) {
-		printk("out of memory\n");
-		return result;
+	if (id == 0 || id >= superblock->total_inodes || inode_cache == NULL) {
+		return (struct inode_block) {0};
 	}
 
-	// go through each block with inodes and load it
-	for (int i = 0; i < superblock->inode_blocks; i++) {
-		uint32_t starting_sector = (superblock->first_inode_block + i) *
-								   (FS_BLOCK_SIZE / FS_SECTOR_SIZE);
-		uint32_t number_of_sector =
-			FS_BLOCK_SIZE / FS_SECTOR_SIZE; // one full block
-
-		int ret =
-			read_sectors(starting_sector, number_of_sector, (uint32_t) addr);
-
-		if (ret) {
-			printk("error loading block from disk\n");
-			break;
-		}
-
-		// block with inodes is loaded at addr, go through each inode and check
-		// id
-		for (size_t j = 0; j < FS_BLOCK_SIZE / sizeof(struct inode_block);
-			 j++) {
-			struct inode_block *current_inode = (struct inode_block *) addr + j;
-
-			if (current_inode->id == id) {
-				result = *current_inode;
-				break;
-			}
-		}
+	if (inode_cache[id].id != id) {
+		return (struct inode_block) {0};
 	}
 
-	kfree(addr);
-	return result;
+	return inode_cache[id];
 }
 
 /**
- * @brief Print files in current directory
- *
- * This function loads the data blocks for the current directory, goes through
- * each entry and prints information (also from the file's inode).
- *
- * (currently, if you want to print files in another directlry, you'll have to
- * go to that directlry using cd)
+ * @brief Load the blocks with inodes into the inode cache
  *
  * @return 1 if error occured, 0 otherwise
  */
-uint8_t fs_print_dir(void) {
-	uint32_t needed_bytes =
-		bytes_to_blocks(current_directory.size_bytes) * FS_BLOCK_SIZE;
+uint8_t load_inode_cache(void) {
+	uint32_t sectors_per_block = FS_BLOCK_SIZE / FS_SECTOR_SIZE;
+	uint32_t max_inodes =
+		superblock->inode_blocks * (FS_BLOCK_SIZE / sizeof(struct inode_block));
 	int ret;
 
-	void *addr = kmalloc(needed_bytes);
-
-	if (addr == NULL) {
-		printk("out of memory\n");
+	if (superblock->total_inodes > max_inodes) {
+		printk("invalid number of inodes: %d\n", superblock->total_inodes);
 		return 1;
 	}
 
-	// load data blocks containing direcory entries
-	ret = load_file(&current_directory, (uint32_t) addr);
+	inode_cache = kmalloc(superblock->inode_blocks * FS_BLOCK_SIZE);
 
-	if (ret) {
-		kfree(addr);
+	if (inode_cache == NULL) {
+		printk("out of memory\n");
 		return 1;
 	}
 
-	int limit = (FS_BLOCK_SIZE / sizeof(struct directory_entry)) *
-				bytes_to_blocks(needed_bytes);
-
-	for (int i = 0; i < limit; i++) {
-		struct directory_entry *dir_entry = (struct directory_entry *) addr + i;
-
-		// file's id
-		uint32_t id = dir_entry->id;
-
-		if (id == 0) {
-			break;
-		}
-
-		// search inode for file id
-		struct inode_block file_inode = get_inode_from_id(id);
+	// one block at a time (the sector count register is only 8 bits wide)
+	for (int i = 0; i < superblock->inode_blocks; i++) {
+		uint32_t starting_sector =
+			(superblock->first_inode_block + i) * sectors_per_block + 1;
 
-		if (file_inode.id == 0) {
-			printk("file with id %d not found\n", id);
-			break;
-		}
+		ret = read_sectors(starting_sector, sectors_per_block,
+						   (uint32_t) inode_cache + i * FS_BLOCK_SIZE);
 
-		if (dir_entry->id != 0) {
-			printk("%s ", file_inode.file_type == 1 ? "d" : "f");
-			printk(" %d/%d/%d ", file_inode.datetime.day,
-				   file_inode.datetime.month, file_inode.datetime.year);
-			printk(" %d", file_inode.size_bytes);
-			printk("\t%s\n", dir_entry->name);
+		if (ret) {
+			printk("error loading block from disk\n");
+			kfree(inode_cache);
+			inode_cache = NULL;
+			return 1;
 		}
 	}
 
-	kfree(addr);
-
 	return 0;
 }
 
-// function replaced by fs_print_dir()
+// function replaced by vfs_print_dir()
 void ls_root_dir(void) {
 	// load root dir block from disk (we know that it is the first data block)
 	// uint8_t read_sectors(uint8_t starting_sector, uint8_t size, uint32_t
@@ -228,309 +176,389 @@ void ls_root_dir(void) {
 }
 
 /**
- * @brief Return current path in the filesystem
+ * @brief Initialize the file system
  *
- * This function returns the current path starting from the root directory.
+ * This function initializes the block cache and loads all the blocks with
+ * inodes into the inode cache. The file system is then mounted as the root of
+ * the VFS by vfs_init().
  *
- * @return Current path starting with "/"
+ * @return 1 if error occured, 0 otherwise
  */
-char *get_current_path(void) {
-	return current_path;
+uint8_t fs_init(void) {
+	if (bcache_init() || load_inode_cache()) {
+		return 1;
+	}
+
+	// root has always id 1
+	if (get_inode_from_id(1).file_type != FILETYPE_DIR) {
+		printk("root directory not found\n");
+		return 1;
+	}
+
+	return 0;
 }
 
 /**
- * @brief Initialize the file system
+ * @brief Write the inode to the disk
  *
- * This function loads the first block with inodes in order to get the inode of
- * the root directory (which is inode 1). It sets the current_directory to that
- * inode and initializes the current_path to "/".
+ * The sector that holds the inode is read, the inode is replaced and the
+ * sector is written back. The inode cache is updated as well.
+ *
+ * @param inode The inode
  *
  * @return 1 if error occured, 0 otherwise
  */
-uint8_t fs_init(void) {
-	// load first inode block from memory and save rood directory node
-	uint32_t starting_sector =
-		superblock->first_inode_block * (FS_BLOCK_SIZE / FS_SECTOR_SIZE) + 1;
-	uint32_t number_of_sectors = FS_BLOCK_SIZE / FS_SECTOR_SIZE;
+uint8_t update_inode_data_disk(struct inode_block *inode) {
+	uint32_t *tmp_sector = kmalloc(FS_SECTOR_SIZE);
 	int ret;
 
-	void *addr = kmalloc(FS_BLOCK_SIZE);
+	if (tmp_sector == NULL) {
+		printk("out of memory\n");
+		return 1;
+	}
 
-	if (addr != NULL) {
-		ret = read_sectors(starting_sector, number_of_sectors, (uint32_t) addr);
+	// 8 = number of sectors per block
+	// 8 = inodes per sector
+	ret =
+		read_sectors((superblock->first_inode_block * 8) + (inode->id / 8) + 1,
+					 1, (uint32_t) tmp_sector);
 
-		if (ret) {
-			printk("error loading block from disk\n");
-			return 1;
-		}
+	if (ret) {
+		goto err;
+	}
 
-		// go to inode with id 1 (root dir) (second inode in the block)
-		struct inode_block *root_dir_inode =
-			(struct inode_block *) ((void *) addr + sizeof(struct inode_block));
+	struct inode_block *tmp_inode =
+		(struct inode_block *) tmp_sector + (inode->id % 8);
+	*tmp_inode = *inode;
 
-		current_directory = *root_dir_inode;
-		parent_directory = current_directory; // parent of root is root
-		strcpy(current_path, "/"); // initial path is the root direcotry
+	ret =
+		write_sectors((superblock->first_inode_block * 8) + (inode->id / 8) + 1,
+					  1, (uint32_t) tmp_sector);
 
-		kfree(addr);
+	if (ret) {
+		goto err;
+	}
 
-		return 0;
+	// keep the inode cache in sync with the disk
+	if (inode_cache != NULL && inode->id < superblock->total_inodes) {
+		inode_cache[inode->id] = *inode;
 	}
 
+	kfree(tmp_sector);
+	return 0;
+
+err:
+	kfree(tmp_sector);
 	return 1;
 }
 
-// get inode of the requested file (last file in the given path)
-struct inode_block get_inode_from_path(char *path) {
-	char *character = path;
-	struct inode_block current_directory_copy = current_directory;
-	struct inode_block parent_directory_copy = parent_directory;
-	int file_found = 0;
+/**
+ * @brief Write the file's data to its blocks on the disk
+ *
+ * The data is written extent by extent, until all the blocks used by the file
+ * are written. The blocks are removed from the block cache first.
+ *
+ * @param inode	The file's inode
+ * @param addr	Location of the file's data in memory
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t update_data_block_disk(struct inode_block *inode, uint32_t addr) {
+	uint32_t sectors_per_block = FS_BLOCK_SIZE / FS_SECTOR_SIZE;
+	uint32_t nr_blocks = bytes_to_blocks(inode->size_bytes);
+	int ret;
 
-	if (*character == '/') {
-		current_directory_copy = get_inode_from_id(1); // root has always id 1
-		parent_directory_copy = current_directory_copy;
-	}
+	for (int i = 0; i < superblock->extents_per_inode && nr_blocks > 0; i++) {
+		uint32_t length = inode->extent[i].length < nr_blocks
+							  ? inode->extent[i].length
+							  : nr_blocks;
 
-	while (*character != '\0') {
-		if (*character == '/') {
-			character++;
-			continue;
-		}
+		bcache_invalidate(inode->extent[i].first_block, length);
 
-		if (*character == '.' &&
-			(*(character + 1) == '/' || *(character + 1) == '\0')) {
-			character++;
-			continue;
+		ret = write_sectors(inode->extent[i].first_block * sectors_per_block +
+								1,
+							length * sectors_per_block, addr);
+
+		if (ret) {
+			return 1;
 		}
 
-		if (strncmp(character, "..", 2) == 0) {
-			// current directory -> parent directory
-			// parent directory -> get inode from the id of ".."
-			current_directory_copy = parent_directory_copy;
+		addr += length * FS_BLOCK_SIZE;
+		nr_blocks -= length;
+	}
 
-			uint32_t needed_bytes =
-				bytes_to_blocks(current_directory_copy.size_bytes) *
-				FS_BLOCK_SIZE;
-			int ret;
+	return 0;
+}
 
-			void *addr = kmalloc(needed_bytes);
+struct vfs_super_operations diskfs_super_ops = {
+	.read_inode = diskfs_read_inode,
+	.put_inode = diskfs_put_inode,
+};
+
+struct vfs_inode_operations diskfs_inode_ops = {
+	.lookup = diskfs_lookup,
+	.create = NULL, // the files on the disk are created by the image tool
+	.unlink = NULL,
+	.readdir = diskfs_readdir,
+};
+
+struct vfs_file_operations diskfs_file_ops = {
+	.open = diskfs_load_data,
+	.read = diskfs_read,
+	.write = diskfs_write,
+	.read_block = diskfs_read_block,
+};
+
+struct vfs_superblock diskfs_superblock = {
+	.name = "diskfs",
+	.flags = 0,
+	.root_id = 1, // root has always id 1
+	.s_op = &diskfs_super_ops,
+	.private = NULL,
+};
 
-			if (addr == NULL) {
-				printk("out of memory\n");
-				return (struct inode_block) {0};
-			}
+/**
+ * @brief Return the superblock used to mount the on-disk file system
+ */
+struct vfs_superblock *diskfs_get_superblock(void) {
+	return &diskfs_superblock;
+}
 
-			// load data blocks containing direcory entries
-			ret = load_file(&current_directory_copy, (uint32_t) addr);
+uint8_t diskfs_read_inode(struct vfs_inode *inode) {
+	struct inode_block disk_inode = get_inode_from_id(inode->id);
 
-			if (ret) {
-				kfree(addr);
-				return (struct inode_block) {0};
-			}
+	if (disk_inode.id == 0) {
+		return 1;
+	}
 
-			int limit = (FS_BLOCK_SIZE / sizeof(struct directory_entry)) *
-						bytes_to_blocks(needed_bytes);
+	inode->type = disk_inode.file_type;
+	inode->size = disk_inode.size_bytes;
+	inode->datetime = disk_inode.datetime;
+	inode->address = NULL; // loaded when needed
+	inode->i_op = &diskfs_inode_ops;
+	inode->f_op = &diskfs_file_ops;
 
-			for (int i = 0; i < limit; i++) {
-				struct directory_entry *dir_entry =
-					(struct directory_entry *) addr + i;
+	return 0;
+}
 
-				if (strcmp((char *) dir_entry->name, "..") == 0) {
-					printk("parent inode has id: %d\n", dir_entry->id);
-					parent_directory_copy = get_inode_from_id(dir_entry->id);
-				}
-			}
+/**
+ * @brief Release the in-memory data of a file of the on-disk file system
+ *
+ * If the file was written, its data (and its size, if it changed) is written
+ * back to the disk first.
+ *
+ * @param inode The in-memory inode
+ */
+void diskfs_put_inode(struct vfs_inode *inode) {
+	if (inode->dirty && inode->address != NULL) {
+		struct inode_block disk_inode = get_inode_from_id(inode->id);
+		uint8_t ret = 0;
+
+		if (disk_inode.size_bytes != inode->size) {
+			disk_inode.size_bytes = inode->size;
+			disk_inode.size_sectors = bytes_to_sectors(inode->size);
+			ret = update_inode_data_disk(&disk_inode);
+		}
 
-			character += 2;
-			kfree(addr);
-			continue;
+		if (ret || update_data_block_disk(&disk_inode,
+										  (uint32_t) inode->address)) {
+			printk("error writing file %d to disk\n", inode->id);
 		}
+	}
 
-		// get directory/file name
+	kfree(inode->address);
+}
 
-		char *name = character;
-		file_found = 0;
+/**
+ * @brief Load the file's data from disk
+ *
+ * The data stays in memory (shared by all the users of the in-memory inode)
+ * until the last reference is dropped.
+ *
+ * @param inode The in-memory inode
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t diskfs_load_data(struct vfs_inode *inode) {
+	if (inode->address != NULL || inode->size == 0) {
+		return 0;
+	}
 
-		while (*character != '/' && *character != '\0') {
-			character++;
-		}
+	struct inode_block disk_inode = get_inode_from_id(inode->id);
+	uint32_t needed_bytes =
+		bytes_to_blocks(disk_inode.size_bytes) * FS_BLOCK_SIZE;
 
-		name[character - name] = '\0';
+	void *addr = kmalloc(needed_bytes);
 
-		// look for the name in the current directory and get the inode
-		uint32_t needed_bytes =
-			bytes_to_blocks(current_directory_copy.size_bytes) * FS_BLOCK_SIZE;
-		int ret;
+	if (addr == NULL) {
+		printk("out of memory\n");
+		return 1;
+	}
 
-		void *addr = kmalloc(needed_bytes);
+	if (load_file(&disk_inode, (uint32_t) addr)) {
+		kfree(addr);
+		return 1;
+	}
 
-		if (addr == NULL) {
-			printk("out of memory\n");
-			return (struct inode_block) {0};
-		}
+	inode->address = addr;
 
-		// load data blocks containing direcory entries
-		ret = load_file(&current_directory_copy, (uint32_t) addr);
+	return 0;
+}
 
-		if (ret) {
-			kfree(addr);
-			return (struct inode_block) {0};
-		}
+uint32_t diskfs_lookup(struct vfs_inode *dir, const char *name, size_t len) {
+	if (diskfs_load_data(dir)) {
+		return 0;
+	}
 
-		int limit = (FS_BLOCK_SIZE / sizeof(struct directory_entry)) *
-					bytes_to_blocks(needed_bytes);
-		struct inode_block tmp_inode;
+	uint32_t entries = dir->size / sizeof(struct directory_entry);
+	struct directory_entry *dir_entry = (struct directory_entry *) dir->address;
 
-		// go through each entry in the directory and search for the file name
-		for (int i = 0; i < limit; i++) {
-			struct directory_entry *dir_entry =
-				(struct directory_entry *) addr + i;
+	if (len >= sizeof(dir_entry->name)) {
+		return 0;
+	}
 
-			if (strcmp((char *) dir_entry->name, name) == 0) {
-				file_found = 1;
-				if (*character == '/') {
-					// this means that the found file is a directory
-					tmp_inode = get_inode_from_id(dir_entry->id);
-					if (tmp_inode.file_type != FILETYPE_DIR) {
-						kfree(addr);
-						return (struct inode_block) {0};
-					}
-
-					parent_directory_copy = current_directory_copy;
-					current_directory_copy = tmp_inode;
-				} else {
-					// final file reached!
-					tmp_inode = get_inode_from_id(dir_entry->id);
-					if (tmp_inode.file_type == FILETYPE_DIR) {
-						kfree(addr);
-						return (struct inode_block) {0};
-					}
-
-					kfree(addr);
-					return tmp_inode;
-				}
-			}
+	for (uint32_t i = 0; i < entries; i++) {
+		if (dir_entry[i].id != 0 &&
+			strncmp((char *) dir_entry[i].name, name, len) == 0 &&
+			dir_entry[i].name[len] == '\0') {
+			return dir_entry[i].id;
 		}
+	}
 
-		if (file_found == 0) {
-			kfree(addr);
-			return (struct inode_block) {0};
-		}
+	return 0;
+}
 
-		kfree(addr);
+int32_t diskfs_readdir(struct vfs_inode *dir, uint32_t index,
+					   struct vfs_dirent *dirent) {
+	if (diskfs_load_data(dir)) {
+		return -1;
 	}
 
-	// !!! I can get the parent inode of the current inode by looking (this
-	// inodes are inodes representing directories) at the id of "..". I can then
-	// get the inode of the found index using the get_inode_from_id() function
-
-	return (struct inode_block) {0};
-}
+	uint32_t entries = dir->size / sizeof(struct directory_entry);
+	struct directory_entry *dir_entry = (struct directory_entry *) dir->address;
 
-struct inode_block create_file(char *path) {
-	// add directory entry in the current directory
-	if (strcmp(path, "tmp") == 0) {}
+	for (uint32_t i = index; i < entries; i++) {
+		if (dir_entry[i].id == 0) {
+			continue;
+		}
 
-	return (struct inode_block) {0};
-}
+		// inode information comes from the inode cache
+		struct inode_block inode = get_inode_from_id(dir_entry[i].id);
 
-uint8_t update_inode_data_disk(struct inode_block *inode) {
-	uint32_t *tmp_sector = kmalloc(FS_SECTOR_SIZE);
-	int ret;
+		dirent->id = dir_entry[i].id;
+		dirent->type = inode.file_type;
+		dirent->size = inode.size_bytes;
+		dirent->datetime = inode.datetime;
+		strncpy(dirent->name, (char *) dir_entry[i].name, VFS_NAME_LENGTH - 1);
+		dirent->name[VFS_NAME_LENGTH - 1] = '\0';
 
-	if (tmp_sector == NULL) {
-		return 1;
+		return i + 1;
 	}
 
-	// 8 = number of sectors per block
-	// 8 = inodes per sector
-	ret =
-		read_sectors((superblock->first_inode_block * 8) + (inode->id / 8) + 1,
-					 1, (uint32_t) tmp_sector);
+	return -1;
+}
 
-	if (ret) {
-		goto err;
+size_t diskfs_read(struct vfs_inode *inode, void *buf, size_t count,
+				   uint32_t offset) {
+	if (offset >= inode->size || count == 0) {
+		return 0;
 	}
 
-	struct inode_block *tmp_inode =
-		(struct inode_block *) tmp_sector + (inode->id % 8);
-	printk("test test: %d\n", tmp_inode->size_bytes);
-	*tmp_inode = *inode;
+	// do not read past the end of the file
+	if (count > inode->size - offset) {
+		count = inode->size - offset;
+	}
 
-	tmp_inode = (struct inode_block *) tmp_sector + (inode->id % 8);
-	printk("test test: %d\n", tmp_inode->size_bytes);
+	memcpy(buf, (void *) inode->address + offset, count);
 
-	ret =
-		write_sectors((superblock->first_inode_block * 8) + (inode->id / 8) + 1,
-					  1, (uint32_t) tmp_sector);
+	return count;
+}
 
-	if (ret) {
-		goto err;
+/**
+ * @brief Read one block of a file of the on-disk file system
+ *
+ * The block is read through the block cache, the rest of the file is not
+ * loaded. Blocks of a file written since it was loaded come from memory.
+ *
+ * @param inode		The in-memory inode
+ * @param buf		Destination buffer (FS_BLOCK_SIZE bytes)
+ * @param offset	Offset in the file (multiple of FS_BLOCK_SIZE)
+ *
+ * @return Number of bytes read (0 at end of file), or -1 if error
+ */
+size_t diskfs_read_block(struct vfs_inode *inode, void *buf, uint32_t offset) {
+	if (offset >= inode->size) {
+		return 0;
 	}
 
-	// ret = read_sectors((superblock->first_inode_block * 8) + (inode->id / 8)
-	// + 1, 1, (uint32_t)tmp_sector);
+	uint32_t count = inode->size - offset < FS_BLOCK_SIZE ? inode->size - offset
+														  : FS_BLOCK_SIZE;
 
-	// if (ret)
-	//     goto err;
-
-	// tmp_inode = (struct inode_block*) tmp_sector;
-	// printk("test test after write: %d\n", tmp_inode->id);
-
-	kfree(tmp_sector);
-	return 0;
+	// the blocks on the disk are stale until the written data is put back
+	if (inode->dirty) {
+		memcpy(buf, (void *) inode->address + offset, count);
+		return count;
+	}
 
-err:
-	kfree(tmp_sector);
-	return 1;
-}
+	struct inode_block disk_inode = get_inode_from_id(inode->id);
+	uint32_t block = offset / FS_BLOCK_SIZE;
 
-uint8_t update_data_block_disk(struct inode_block *inode, uint32_t addr) {
-	uint32_t nr_blocks = bytes_to_blocks(inode->size_bytes);
-	int ret;
+	// find the extent that holds the block
+	for (int i = 0; i < superblock->extents_per_inode; i++) {
+		if (block >= disk_inode.extent[i].length) {
+			block -= disk_inode.extent[i].length;
+			continue;
+		}
 
-	for (size_t i = 0; i < superblock->extents_per_inode && nr_blocks > 0;
-		 i++) {
-		ret = write_sectors(inode->extent[i].first_block * 8,
-							inode->extent[i].length * 8, addr);
+		block += disk_inode.extent[i].first_block;
 
-		if (ret) {
+		if (bcache_read(block, 1, buf)) {
 			return -1;
 		}
+
+#ifdef CONFIG_BOOT_PREFETCH
+		prefetch_record(inode->id, block, 1);
+#endif
+
+		return count;
 	}
 
-	return 0;
+	return -1;
 }
 
-void *init_open_files_table(void) {
-	struct open_files_table *tmp = (struct open_files_table *) kmalloc(
-		sizeof(struct open_files_table) * MAX_OPEN_FILES);
+/**
+ * @brief Write to a file of the on-disk file system
+ *
+ * The in-memory copy of the file is changed and written back to the disk when
+ * the last reference to the inode is dropped. No blocks are allocated on the
+ * disk, so the file can grow only up to the end of its last block: the write
+ * is refused if it does not fit.
+ *
+ * @param inode		The in-memory inode
+ * @param buf		Data to write
+ * @param count		Number of bytes to write
+ * @param offset	Offset in the file
+ *
+ * @return Number of bytes written, or -1 if error
+ */
+size_t diskfs_write(struct vfs_inode *inode, const void *buf, size_t count,
+					uint32_t offset) {
+	uint32_t capacity = bytes_to_blocks(inode->size) * FS_BLOCK_SIZE;
 
-	if (tmp == NULL) {
-		printk("out of memory\n");
-		return NULL;
+	if (count == 0) {
+		return 0;
 	}
 
-	for (int i = 0; i < MAX_OPEN_FILES; i++) {
-		tmp[i] = (struct open_files_table) {0};
+	if (offset >= capacity || count > capacity - offset) {
+		return -1;
 	}
 
-	return tmp;
-}
-
-void *init_open_inodes_table(void) {
-	struct inode_block *tmp = (struct inode_block *) kmalloc(
-		sizeof(struct inode_block) * MAX_OPEN_FILES);
-
-	if (tmp == NULL) {
-		printk("out of memory\n");
-		return NULL;
-	}
+	memcpy((void *) inode->address + offset, buf, count);
+	inode->dirty = 1;
 
-	for (int i = 0; i < MAX_OPEN_FILES; i++) {
-		tmp[i] = (struct inode_block) {0};
+	if (offset + count > inode->size) {
+		inode->size = offset + count;
 	}
 
-	return tmp;
+	return count;
 }
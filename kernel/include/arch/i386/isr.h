@@ -12,6 +12,8 @@ struct interrupt_regs {
 };
 
 void isr_handler(struct interrupt_regs *r);
+uint8_t page_fault_heap(uint32_t);
+uint8_t page_fault_stack(uint32_t);
 void add_isrs_to_idt(void);
 
 extern void isr0();
@@ -0,0 +1,50 @@
+#ifndef ARCH_I386_SERIAL_H
+#define ARCH_I386_SERIAL_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define COM1_PORT		 0x3F8
+#define SERIAL_BAUD_RATE 38400
+#define SERIAL_MAX_BAUD	 115200
+
+/**
+ * UART registers (offsets from the port of the serial line). With the DLAB bit
+ * of the line control register set, the first two registers are the low and
+ * high bytes of the baud rate divisor.
+ */
+typedef enum {
+	SERIAL_REG_DATA			 = 0,
+	SERIAL_REG_INT_ENABLE	 = 1,
+	SERIAL_REG_DIVISOR_LOW	 = 0,
+	SERIAL_REG_DIVISOR_HIGH	 = 1,
+	SERIAL_REG_FIFO_CONTROL	 = 2,
+	SERIAL_REG_LINE_CONTROL	 = 3,
+	SERIAL_REG_MODEM_CONTROL = 4,
+	SERIAL_REG_LINE_STATUS	 = 5
+} SERIAL_REGISTERS;
+
+typedef enum {
+	SERIAL_LCR_8N1	= 0x03, // 8 data bits, no parity, one stop bit
+	SERIAL_LCR_DLAB = 0x80
+} SERIAL_LINE_CONTROL;
+
+typedef enum {
+	SERIAL_MCR_DTR		= 0x01,
+	SERIAL_MCR_RTS		= 0x02,
+	SERIAL_MCR_OUT2		= 0x08,
+	SERIAL_MCR_LOOPBACK = 0x10
+} SERIAL_MODEM_CONTROL;
+
+// enable and clear the FIFOs, 14 bytes interrupt threshold
+#define SERIAL_FIFO_ENABLE 0xC7
+#define SERIAL_LSR_THR_EMPTY 0x20
+
+uint8_t serial_init(void);
+void serial_putchar(char);
+void serial_write(const char *, size_t);
+
+extern uint8_t serial_present;
+extern uint8_t serial_mirror;
+
+#endif /* !ARCH_I386_SERIAL_H */
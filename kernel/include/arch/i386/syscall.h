@@ -14,15 +14,17 @@
 #include <kernel/string.h>
 #include <kernel/tty.h>
 #include <kernel/utils.h>
+#include <kernel/vfs.h>
 #include <mm/kmalloc.h>
 #include <mm/pmm.h>
 #include <mm/vmm.h>
+#include <process/fdtable.h>
 #include <process/process.h>
 #include <process/scheduler.h>
 
 #include <stdint.h>
 
-#define MAX_SYSCALLS 9
+#define MAX_SYSCALLS 19
 TASK_SWITCH_STACK_PROBLEM isr_prob;
 
 // data from the scheduler
@@ -42,30 +44,19 @@ void syscall_test1(void) {
 	printk("Syscall test 1 works\n");
 }
 
+#ifndef CONFIG_FCFS_SCH
 /**
- * @brief Sleep syscall
+ * @brief Return from the syscall to the task chosen by the scheduler
  *
- * Block process by putting it in the sleeping queue until the requested
- * number of milliseconds pass. Schedule another process in the meanwhile
+ * Called after schedule() by the syscalls that give up the processor. The
+ * registers on the stack are updated, so the interrupt returns to the new
+ * current_running_task.
+ *
+ * @param r The registers saved on the stack by the syscall interrupt
  */
-void syscall_sleep(struct interrupt_regs *r) {
-#ifdef CONFIG_FCFS_SCH
-	wait_millis(r->ebx);
-#else
+void syscall_switch_task(struct interrupt_regs *r) {
 	int ret;
 
-	// save context of process that initiated sleep syscall
-	current_running_task->state = TASK_BLOCKED;
-
-	save_current_context(r);
-
-	current_running_task->run_time = 0;
-	current_running_task->sleep_time = r->ebx;
-
-	// put task in the sleeping queue and call scheduler to
-	// schedule another task
-	schedule(SLEEPING_TASK_QUEUE);
-
 	// if new current_running_task is a kernel task
 	if (current_running_task->ring == 0) {
 		isr_prob = MANUAL_POP;
@@ -102,6 +93,31 @@ void syscall_sleep(struct interrupt_regs *r) {
 	}
 
 	current_running_task->state = TASK_RUNNING;
+}
+#endif /* !CONFIG_FCFS_SCH */
+
+/**
+ * @brief Sleep syscall
+ *
+ * Block process by putting it in the sleeping queue until the requested
+ * number of milliseconds pass. Schedule another process in the meanwhile
+ */
+void syscall_sleep(struct interrupt_regs *r) {
+#ifdef CONFIG_FCFS_SCH
+	wait_millis(r->ebx);
+#else
+	// save context of process that initiated sleep syscall
+	current_running_task->state = TASK_BLOCKED;
+
+	save_current_context(r);
+
+	current_running_task->run_time = 0;
+	current_running_task->sleep_time = r->ebx;
+
+	// put task in the sleeping queue and call scheduler to
+	// schedule another task
+	schedule(SLEEPING_TASK_QUEUE);
+	syscall_switch_task(r);
 #endif
 }
 
@@ -112,278 +128,421 @@ void syscall_sleep(struct interrupt_regs *r) {
  * the flags will be in ECX
  */
 int syscall_open(char *path, uint32_t flags) {
-	// char *path = 0;
-	// uint32_t flags = 0;
-
-	// data from kernel
-	extern struct open_files_table *open_files_table;
-
-	//__asm__ __volatile__ ("mov %%ebx, %0\n"
-	//                      "mov %%ecx, %1" : "=b"(path), "=c"(flags));
+	// get the in-memory inode (shared with other open entries of the same
+	// file, the file's data is loaded only once); with O_CREAT, a missing
+	// file is created by the file system
+	struct vfs_inode *inode = vfs_open(path, flags);
 
-	// get file inode
-	struct inode_block inode = get_inode_from_path(path);
-
-	// file doesn't exist
-	if (inode.id == 0) {
-		if (flags & O_CREAT) {
-			inode = create_file(path);
-
-			if (inode.id == 0) {
-				printk("file could not be created\n");
-				goto err;
-			}
-		} else {
-			goto err;
-		}
+	if (inode == NULL) {
+		goto err;
 	}
 
-	// add to open files table
-	struct open_files_table *tmp_oft = open_files_table;
-	int tmp_idx = 3; // skip first three entries
+	struct open_files_table *file = open_file_create(inode, flags);
 
-	// skip first three entries in the table (stdin, stdout and stderr)
-	tmp_oft += 3;
-
-	// search for an empty place for the file
-	while (tmp_idx < MAX_OPEN_FILES && tmp_oft->address != 0) {
-		tmp_idx++;
-		tmp_oft++;
-	}
-
-	if (tmp_idx == MAX_OPEN_FILES) {
-		printk("limit of open files reached: %d! close some to open more!\n",
-			   MAX_OPEN_FILES);
+	if (file == NULL) {
+		vfs_iput(inode);
 		goto err;
 	}
 
-	// add new open_files_table_t entry at the found free position and return
-	// the position
-
-	// allocate memory for the inode (as the inode is a local variable here)
-	void *addr = kmalloc(sizeof(struct inode_block));
+	// lowest free descriptor in the task's table
+	int fd = fd_alloc(current_running_task, file);
 
-	if (addr == NULL) {
-		printk("out of memory\n");
+	if (fd < 0) {
+		open_file_put(file);
 		goto err;
 	}
 
-	*(struct inode_block *) addr = inode;
+	return fd;
 
-	tmp_oft->inode = addr;
-	tmp_oft->reference_number = 0;
-	tmp_oft->offset = 0;
-	tmp_oft->flags = flags;
-
-	// allocate memory for the file's data
-	uint32_t needed_bytes = bytes_to_blocks(inode.size_bytes) * FS_BLOCK_SIZE;
+err:
+	return -1;
+}
 
-	addr = kmalloc(needed_bytes);
+/**
+ * @brief Close syscall
+ *
+ * The open file is closed when no other descriptor refers to it.
+ *
+ * @param fd The file descriptor
+ *
+ * @return 0 if successful, -1 if error
+ */
+int syscall_close(int fd) {
+	struct open_files_table *file = fd_free(current_running_task, fd);
 
-	if (addr == NULL) {
-		printk("out of memory\n");
-		goto err;
+	if (file == NULL) {
+		return -1;
 	}
 
-	int ret = load_file(&inode, (uint32_t) addr);
+	open_file_put(file);
 
-	if (ret) {
-		// TODO: goto err2 to free allocated memory
-		goto err;
+	return 0;
+}
+
+/**
+ * @brief Get the open files table entry for the given file descriptor
+ *
+ * @param fd The file descriptor
+ *
+ * @return The entry if the descriptor refers to an open file, NULL otherwise
+ */
+struct open_files_table *get_open_file(int fd) {
+	return fd_get(current_running_task, fd);
+}
+
+/**
+ * @brief Read from the open file starting at the given offset
+ *
+ * @param oft		The open file
+ * @param buf		Destination buffer
+ * @param count		Number of bytes to read
+ * @param offset	Offset in the file
+ *
+ * @return Number of bytes read (0 at end of file), or -1 if error
+ */
+size_t file_read_at(struct open_files_table *oft, void *buf, size_t count,
+					uint32_t offset) {
+	// directories are read with getdents
+	if (oft->flags & (O_WRONLY | O_DIRECTORY)) {
+		return -1;
 	}
 
-	tmp_oft->address = addr;
+	return vfs_read(oft->inode, buf, count, offset);
+}
 
-	// put index in the open files table into EAX and return
-	//__asm__ __volatile__ ("mov %%ebx, %%eax" : : "b"(tmp_idx));
-	return tmp_idx;
+/**
+ * @brief Write to the open file starting at the given offset
+ *
+ * @param oft		The open file
+ * @param buf		Source buffer
+ * @param count		Number of bytes to write
+ * @param offset	Offset in the file
+ *
+ * @return Number of bytes written, or -1 if error
+ */
+size_t file_write_at(struct open_files_table *oft, const void *buf,
+					 size_t count, uint32_t offset) {
+	if (oft->flags & (O_RDONLY | O_DIRECTORY)) {
+		return -1;
+	}
 
-err:
-	//__asm__ __volatile__ ("mov $-1, %eax");
-	return -1;
+	return vfs_write(oft->inode, buf, count, offset);
 }
 
-int syscall_close(int fd) {
-	// get file descriptor from EBX
-	//__asm__ __volatile__ ("mov %%ebx, %0" : "=b"(fd));
+/**
+ * @brief Read syscall
+ *
+ * Read count bytes starting at the file descriptor's offset and advance the
+ * offset by the number of bytes read.
+ */
+size_t syscall_read(int fd, void *buf, size_t count) {
+	struct open_files_table *oft = get_open_file(fd);
 
-	if (fd < 0 || fd >= MAX_OPEN_FILES) {
-		goto err;
+	if (oft == NULL || buf == NULL) {
+		return -1;
 	}
 
-	// data from kernel
-	extern struct open_files_table *open_files_table;
+	size_t read_bytes = file_read_at(oft, buf, count, oft->offset);
 
-	// get entry at fd index from the open files table
-	// free the allocated memory and the entry
-	struct open_files_table entry = open_files_table[fd];
+	if (read_bytes != (size_t) -1) {
+		oft->offset += read_bytes;
+	}
 
-	// free memory allocated for the inode
-	kfree(entry.inode);
+	return read_bytes;
+}
 
-	// free memory allocated for the file's data
-	kfree(entry.address);
+/**
+ * @brief Write syscall
+ *
+ * Write count bytes starting at the file descriptor's offset and advance the
+ * offset by the number of bytes written.
+ */
+size_t syscall_write(int fd, void *buf, size_t count) {
+	if (count == 0) {
+		return 0;
+	}
 
-	// empty entry
-	open_files_table[fd] = (struct open_files_table) {0};
+	// chech for special file descriptors: stdin, stdout, stderr
+	if (fd == stdout || fd == stderr) {
+		terminal_writestring(buf);
+		return strlen(buf);
+	}
 
-	// return 0 on success
-	//__asm__ __volatile__ ("mov $0, %eax");
-	return 0;
+	struct open_files_table *oft = get_open_file(fd);
 
-err:
-	//__asm__ __volatile__ ("mov $-1, %eax");
-	return -1;
-}
+	if (oft == NULL || buf == NULL) {
+		return -1;
+	}
 
-size_t syscall_read(int fd, void *buf, size_t count) {
-	// data from kernel
-	extern struct open_files_table *open_files_table;
+	size_t written_bytes = file_write_at(oft, buf, count, oft->offset);
 
-	int read_bytes = 0;
-	// int fd = -1, read_bytes = 0;
-	// size_t count = 0;
-	// void *buf = NULL;
+	if (written_bytes != (size_t) -1) {
+		oft->offset += written_bytes;
+	}
 
-	//__asm__ __volatile__ ("mov %%ebx, %0\n"
-	//                      "mov %%ecx, %1\n"
-	//                      "mov %%edx, %2": "=b"(fd), "=c"(buf), "=d"(count)::
-	//                      "edi", "esi");
+	return written_bytes;
+}
 
-	//__asm__ __volatile__ ("mov %%ebx, %0": "=r"(fd));
-	//__asm__ __volatile__ ("mov %%ecx, %0": "=r"(buf));
-	//__asm__ __volatile__ ("mov %%esi, %0": "=r"(count));
+/**
+ * @brief Lseek syscall
+ *
+ * Reposition the file descriptor's offset. The offset can be set past the end
+ * of the file, in which case reads return 0.
+ *
+ * @param fd		The file descriptor
+ * @param offset	New offset relative to whence
+ * @param whence	SEEK_SET, SEEK_CUR or SEEK_END
+ *
+ * @return The resulting offset, or -1 if error
+ */
+int32_t syscall_lseek(int fd, int32_t offset, int whence) {
+	struct open_files_table *oft = get_open_file(fd);
+	int32_t base;
 
-	printk("read parameters: fd: %d, count: %d, buf: %x\n", fd, count, buf);
+	if (oft == NULL) {
+		return -1;
+	}
 
-	if (fd < 0 || fd >= MAX_OPEN_FILES || buf == NULL) {
-		goto err;
+	switch (whence) {
+	case SEEK_SET:
+		base = 0;
+		break;
+	case SEEK_CUR:
+		base = oft->offset;
+		break;
+	case SEEK_END:
+		base = oft->inode->size;
+		break;
+	default:
+		return -1;
 	}
 
-	if (count == 0) {
-		//__asm__ __volatile__ ("mov $0, %eax");
-		return 0;
+	// the offset returned to userspace must fit in an int32_t
+	if (base < 0 || (offset > 0 && base > INT32_MAX - offset) ||
+		base + offset < 0) {
+		return -1;
 	}
 
-	struct open_files_table *oft = open_files_table + fd;
+	oft->offset = base + offset;
 
-	if (oft->address == 0) {
-		goto err;
-	}
+	return oft->offset;
+}
 
-	if (oft->flags & O_WRONLY) {
-		goto err;
-	}
+/**
+ * @brief Pread syscall
+ *
+ * Read from the given offset without changing the file descriptor's offset.
+ */
+size_t syscall_pread(int fd, void *buf, size_t count, uint32_t offset) {
+	struct open_files_table *oft = get_open_file(fd);
 
-	if (oft->inode->size_bytes < count) {
-		// if number of requested bytes to read is bigger than the actual data
-		read_bytes = oft->inode->size_bytes;
-	} else {
-		read_bytes = count;
+	if (oft == NULL || buf == NULL) {
+		return -1;
 	}
 
-	// copy bytes
-	memcpy(buf, oft->address, read_bytes);
+	return file_read_at(oft, buf, count, offset);
+}
 
-	//__asm__ __volatile__ ("mov %0, %%eax" : : "r"(read_bytes));
+/**
+ * @brief Pwrite syscall
+ *
+ * Write at the given offset without changing the file descriptor's offset.
+ */
+size_t syscall_pwrite(int fd, void *buf, size_t count, uint32_t offset) {
+	struct open_files_table *oft = get_open_file(fd);
 
-	return read_bytes;
+	if (oft == NULL || buf == NULL) {
+		return -1;
+	}
 
-err:
-	//__asm__ __volatile__ ("mov $-1, %eax");
-	return -1;
+	return file_write_at(oft, buf, count, offset);
 }
 
-size_t syscall_write(int fd, void *buf, size_t count) {
-	// data from kernel
-	extern struct open_files_table *open_files_table;
+/**
+ * @brief Readv syscall
+ *
+ * Fill the given buffers in order, starting at the file descriptor's offset,
+ * with a single syscall. Stops at the first buffer that cannot be filled
+ * completely (end of file).
+ *
+ * @param fd		The file descriptor
+ * @param iov		Array of buffers
+ * @param iovcnt	Number of buffers in the array
+ *
+ * @return Total number of bytes read, or -1 if error
+ */
+size_t syscall_readv(int fd, const struct iovec *iov, int iovcnt) {
+	struct open_files_table *oft = get_open_file(fd);
+	size_t total = 0;
+
+	if (oft == NULL || iov == NULL || iovcnt < 0 || iovcnt > MAX_IOVEC) {
+		return -1;
+	}
 
-	int written_bytes = 0;
-	// int fd, ret = 0;
-	// size_t count, written_bytes = 0;
-	// void *buf = NULL;
+	for (int i = 0; i < iovcnt; i++) {
+		size_t ret =
+			file_read_at(oft, iov[i].iov_base, iov[i].iov_len, oft->offset);
 
-	//__asm__ __volatile__ ("mov %%ebx, %0": "=r"(fd));
-	//__asm__ __volatile__ ("mov %%ecx, %0": "=r"(buf));
-	//__asm__ __volatile__ ("mov %%esi, %0": "=r"(count));
+		if (ret == (size_t) -1) {
+			return total == 0 ? (size_t) -1 : total;
+		}
 
-	// printk("write function called, fd: %d, buf: %x, count: %d\n", fd, buf,
-	// count);
+		oft->offset += ret;
+		total += ret;
 
-	if (fd < 0 || fd >= MAX_OPEN_FILES) {
-		goto err;
+		if (ret < iov[i].iov_len) {
+			break;
+		}
 	}
 
-	if (count == 0) {
-		//__asm__ __volatile__ ("mov $0, %eax");
-		return 0;
+	return total;
+}
+
+/**
+ * @brief Writev syscall
+ *
+ * Write the given buffers in order, starting at the file descriptor's offset,
+ * with a single syscall.
+ *
+ * @param fd		The file descriptor
+ * @param iov		Array of buffers
+ * @param iovcnt	Number of buffers in the array
+ *
+ * @return Total number of bytes written, or -1 if error
+ */
+size_t syscall_writev(int fd, const struct iovec *iov, int iovcnt) {
+	size_t total = 0;
+
+	if (iov == NULL || iovcnt < 0 || iovcnt > MAX_IOVEC) {
+		return -1;
 	}
 
-	// chech for special file descriptors: stdin, stdout, stderr
 	if (fd == stdout || fd == stderr) {
-		terminal_writestring(buf);
-		written_bytes = strlen(buf);
+		for (int i = 0; i < iovcnt; i++) {
+			terminal_write(iov[i].iov_base, iov[i].iov_len);
+			total += iov[i].iov_len;
+		}
 
-		//__asm__ __volatile__ ("mov %0, %%eax" : : "r"(written_bytes));
-		return written_bytes;
+		return total;
 	}
 
-	struct open_files_table *oft = open_files_table + fd;
+	struct open_files_table *oft = get_open_file(fd);
 
-	if (oft->address == 0) {
-		goto err;
+	if (oft == NULL) {
+		return -1;
 	}
 
-	if (oft->flags & O_RDONLY) {
-		goto err;
+	for (int i = 0; i < iovcnt; i++) {
+		size_t ret =
+			file_write_at(oft, iov[i].iov_base, iov[i].iov_len, oft->offset);
+
+		if (ret == (size_t) -1) {
+			return total == 0 ? (size_t) -1 : total;
+		}
+
+		oft->offset += ret;
+		total += ret;
+
+		if (ret < iov[i].iov_len) {
+			break;
+		}
 	}
 
-	// TODO: add O_APPEND flag and file offset
+	return total;
+}
 
-	if (oft->inode->size_bytes >= count) {
-		// if number of requested bytes to write is smaller than the actual
-		// data, then write count bytes
-		written_bytes = count;
-	} else {
-		// else write maximum oft->inode->size_bytes bytes
-		// TODO: increase size of file on disk
-		written_bytes = oft->inode->size_bytes;
+/**
+ * @brief Getdents syscall
+ *
+ * Fill the buffer with as many directory entries (struct fs_dirent) as fit,
+ * starting with the entry at the file descriptor's offset. The offset is a
+ * cookie (returned by the file system as d_off) and is advanced past the
+ * returned entries, so consecutive calls walk the whole directory.
+ *
+ * @param fd	File descriptor of a directory opened with O_DIRECTORY
+ * @param buf	Buffer for the entries
+ * @param count	Size of the buffer in bytes
+ *
+ * @return Number of bytes filled, 0 at the end of the directory, or -1 if error
+ * (including a buffer too small for the next entry)
+ */
+size_t syscall_getdents(int fd, void *buf, size_t count) {
+	struct open_files_table *oft = get_open_file(fd);
+	struct vfs_dirent entry;
+	size_t filled = 0;
+	int32_t next;
+
+	if (oft == NULL || buf == NULL || !(oft->flags & O_DIRECTORY)) {
+		return -1;
 	}
 
-	memcpy(oft->address, buf, written_bytes);
+	while ((next = vfs_readdir(oft->inode, oft->offset, &entry)) >= 0) {
+		size_t name_len = strlen(entry.name) + 1;
+		// keep records 4 bytes aligned
+		size_t reclen = (sizeof(struct fs_dirent) + name_len + 3) & ~3;
 
-	// update inode info
-	oft->inode->size_bytes = written_bytes;
-	oft->inode->size_sectors = bytes_to_sectors(written_bytes);
+		if (filled + reclen > count) {
+			// the next entry does not fit in the given buffer
+			if (filled == 0) {
+				return -1;
+			}
 
-	// update inode info on disk TODO: fix
-	// int ret = update_inode_data_disk(oft->inode);
+			break;
+		}
 
-	// printk("ret: %d\n", ret);
-	// if (ret)
-	//     goto err;
+		struct fs_dirent *dirent = (struct fs_dirent *) (buf + filled);
 
-	// update data block on disk TODO: fix
-	// ret = update_data_block_disk(oft->inode, (uint32_t)oft->address);
+		dirent->d_ino = entry.id;
+		dirent->d_off = next;
+		dirent->d_reclen = reclen;
+		dirent->d_type = entry.type;
+		dirent->d_size = entry.size;
+		memcpy(dirent->d_name, entry.name, name_len);
 
-	// if (ret)
-	//     goto err;
+		filled += reclen;
+		oft->offset = next;
+	}
 
-	//__asm__ __volatile__ ("mov %0, %%eax" : : "r"(written_bytes));
-	return written_bytes;
+	return filled;
+}
 
-err:
-	//__asm__ __volatile__ ("mov $-1, %eax");
-	return -1;
+/**
+ * @brief Unlink syscall
+ *
+ * Remove the file at the given path. Open files keep their data until they
+ * are closed.
+ *
+ * @param path Path of the file
+ *
+ * @return 0 if successful, -1 if error
+ */
+int syscall_unlink(char *path) {
+	if (path == NULL || vfs_unlink(path)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Uptime syscall
+ *
+ * @return Number of milliseconds since boot
+ */
+uint32_t syscall_uptime(void) {
+	return (uint32_t) get_uptime();
 }
 
 void syscall_exit(struct interrupt_regs *r) {
 	//__asm__ __volatile__ ("mov %%ebx, %0" : "=r"(return_code));
-	int ret;
+	current_running_task->exit_code = r->ebx;
 
 	// cleanup elf data
 	elf_after_program_execution(r->ebx);
 
+	// close the files left open
+	fd_table_destroy(current_running_task);
+
 	// restore kernel virtual address space
 	restore_kernel_address_space();
 
@@ -399,138 +558,152 @@ void syscall_exit(struct interrupt_regs *r) {
 	current_running_task = NULL;
 
 	schedule(RUNNING_TASK_QUEUE);
+	syscall_switch_task(r);
+#endif
+}
 
-	if (current_running_task->ring == 0) {
-		isr_prob = MANUAL_POP;
-	}
+/**
+ * @brief Fork syscall
+ *
+ * Create a copy of the running task. The address space is shared
+ * copy-on-write, so only the page tables are copied here.
+ *
+ * @param r The registers saved on the stack by the syscall interrupt
+ *
+ * @return The pid of the child in the parent (0 in the child), -1 if error
+ */
+int syscall_fork(struct interrupt_regs *r) {
+#ifdef CONFIG_FCFS_SCH
+	(void) r;
+	return -1;
+#else
+	// the child resumes from the context of the parent, with 0 returned
+	save_current_context(r);
 
-	// prepare elf execution if user space process
-	if (current_running_task->vas != NULL &&
-		current_running_task->state == TASK_CREATED) {
-		ret = prepare_elf_execution(current_running_task->argc,
-									current_running_task->argv);
+	struct task_struct *child = fork_task(current_running_task);
 
-		if (ret) {
-			// failed to prepare elf file, terminate task and call scheduler
-			// again
-			current_running_task = NULL;
-			current_running_task->state = TASK_TERMINATED;
-		}
+	if (child == NULL) {
+		return -1;
 	}
 
-	// update registers on the stack (context) for the new task
-	if (current_running_task->state == TASK_CREATED) {
-		if (current_running_task->ring == 3) {
-			change_context(r, isr_prob);
-		} else if (current_running_task->ring == 0) {
-			change_context_kernel(r);
-			isr_prob |= CHANGE_KSTACK;
-		}
-	} else {
-		resume_context(r, isr_prob);
-		if (current_running_task->ring == 0) {
-			isr_prob |= RESUME_KSTACK;
-		}
-	}
+	child->context->eax = 0;
+	enqueue_task(child);
 
-	current_running_task->state = TASK_RUNNING;
+	return child->task_id;
 #endif
 }
 
-void *syscall_sbrk(intptr_t increment) {
-	//__asm__ __volatile__ ("mov %%ebx, %0\n" : "=r"(increment));
+/**
+ * @brief Waitpid syscall
+ *
+ * Wait for the given child (-1 for any child) to exit. If the child did not
+ * exit yet, the task is blocked and the syscall is restarted when one of its
+ * children exits.
+ *
+ * the pid will be in EBX
+ * the pointer to the exit code will be in ECX (can be NULL)
+ *
+ * @param r The registers saved on the stack by the syscall interrupt
+ *
+ * @return The pid of the child that exited, -1 if the task has no such child
+ */
+int syscall_waitpid(struct interrupt_regs *r) {
+	int *status = (int *) r->ecx;
+	int pid = r->ebx;
+	int exit_code;
 
-	// printk("sbrk current program break addr: %x\n",
-	// current_running_task->program_break);
+	if (pid <= 0 && pid != -1) {
+		return -1;
+	}
 
-	// printk("free heap size: %d\n",
-	// (uint32_t)(current_running_task->heap_start +
-	//         current_running_task->heap_size_blocks * BLOCK_SIZE) -
-	//         (uint32_t)(current_running_task->program_break));
+	int child = task_reap_child(current_running_task, pid, &exit_code);
 
-	if (increment == 0) {
-		// return current program break
-		//__asm__ __volatile__ ("mov %0, %%eax" : :
-		//"r"(current_running_task->program_break));
-		return current_running_task->program_break;
+	if (child > 0 && status != NULL) {
+		*status = exit_code;
 	}
 
-	uint32_t next_pr_break =
-		(uint32_t) (current_running_task->program_break + increment);
-
-	// check if next program break exceeds upper limit
-	if (next_pr_break >= KERNEL_VIRT_ADDR - BLOCK_SIZE * 4) {
-		printk("heapp upper limit reached!\n");
-		//__asm__ __volatile__ ("mov %0, %%eax" : : "r"(-1));
-		return NULL;
+#ifdef CONFIG_FCFS_SCH
+	return child == 0 ? -1 : child;
+#else
+	if (child != 0) {
+		return child;
 	}
 
-	// check if new address is still mapped
-	if (next_pr_break <
-		(uint32_t) (current_running_task->heap_start +
-					current_running_task->heap_size_blocks * BLOCK_SIZE)) {
-		// address is mapped
-		uint32_t prev_pr_break = (uint32_t) current_running_task->program_break;
-		current_running_task->program_break = (void *) next_pr_break;
+	save_current_context(r);
 
-		//__asm__ __volatile__ ("mov %0, %%eax" : : "r"(prev_pr_break));
-		return (void *) prev_pr_break;
-	} else {
-		// extend heap with extra blocks
-		void *addr_start = current_running_task->heap_start +
-						   current_running_task->heap_size_blocks * BLOCK_SIZE;
+	// go back to the int $0x80 instruction (2 bytes)
+	current_running_task->context->eip -= 2;
+	current_running_task->wait_pid = pid;
+	current_running_task->state = TASK_BLOCKED;
+	current_running_task->run_time = 0;
 
-		// calculate needed blocks
-		uint8_t needed_blocks = 0;
-		intptr_t increment_copy = increment;
+	// the task is put back in the queue by the exit of a child
+	current_running_task = NULL;
 
-		// determine size that needs to be allocated and mapped
-		increment_copy -=
-			((uint32_t) (current_running_task->heap_start +
-						 current_running_task->heap_size_blocks * BLOCK_SIZE) -
-			 (uint32_t) current_running_task->program_break);
+	schedule(RUNNING_TASK_QUEUE);
+	syscall_switch_task(r);
 
-		needed_blocks = increment_copy / BLOCK_SIZE;
+	return r->eax;
+#endif
+}
 
-		if (increment_copy % BLOCK_SIZE != 0) {
-			needed_blocks++;
-		}
+/**
+ * @brief Move the program break of the running task
+ *
+ * Only the break is moved and the heap region is extended to cover it; the
+ * pages are allocated and mapped by the page fault handler when they are first
+ * touched (see page_fault_heap()).
+ *
+ * @param increment Number of bytes to add to the program break (may be
+ * negative)
+ *
+ * @return The previous program break, NULL if error occured
+ */
+void *syscall_sbrk(intptr_t increment) {
+	struct task_struct *task = current_running_task;
+	uint32_t prev_pr_break = (uint32_t) task->program_break;
 
-		// allocate and map memory
-		for (uint32_t i = 0, virt = (uint32_t) addr_start; i < needed_blocks;
-			 i++, virt += PAGE_SIZE) {
-			void *phys_addr = allocate_blocks(1);
+	if (increment == 0) {
+		// return current program break
+		return task->program_break;
+	}
 
-			if (phys_addr == NULL) {
-				printk("out of memory!\n");
-				//__asm__ __volatile__ ("mov %0, %%eax" : : "r"(-1));
-				return NULL;
-			}
+	uint32_t next_pr_break = prev_pr_break + increment;
 
-			map_user_page(phys_addr, (void *) virt);
+	// check if next program break reaches the stack's guard gap (or wrapped
+	// around)
+	if (next_pr_break >
+			(uint32_t) task->stack_limit - USER_STACK_GUARD_SIZE ||
+		(increment > 0 && next_pr_break < prev_pr_break)) {
+		printk("heap upper limit reached!\n");
+		return NULL;
+	}
 
-			pt_entry *page = get_page((uint32_t) virt);
+	if (next_pr_break < (uint32_t) task->heap_start) {
+		printk("program break below the heap start!\n");
+		return NULL;
+	}
 
-			SET_ATTRIBUTE(page, PAGE_PTE_WRITABLE);
-			SET_ATTRIBUTE(page, PAGE_PTE_USER | PAGE_PTE_PRESENT);
-		}
+	// extend the heap region, the new pages are mapped on first touch
+	uint32_t heap_blocks =
+		ALIGN(next_pr_break - (uint32_t) task->heap_start, PAGE_SIZE) /
+		PAGE_SIZE;
 
-		// update heap size
-		current_running_task->heap_size_blocks += needed_blocks;
+	if (heap_blocks > task->heap_size_blocks) {
+		task->heap_size_blocks = heap_blocks;
+	}
 
-		// update program break and return previous program break
-		uint32_t prev_pr_break = (uint32_t) current_running_task->program_break;
-		current_running_task->program_break = (void *) next_pr_break;
+	task->program_break = (void *) next_pr_break;
 
-		//__asm__ __volatile__ ("mov %0, %%eax" : : "r"(prev_pr_break));
-		printk("%x\n", prev_pr_break);
-		return (void *) prev_pr_break;
-	}
+	return (void *) prev_pr_break;
 }
 
-void *syscalls[MAX_SYSCALLS] = {syscall_test0, syscall_test1, syscall_sleep,
-								syscall_open,  syscall_close, syscall_read,
-								syscall_write, syscall_exit,  syscall_sbrk};
+void *syscalls[MAX_SYSCALLS] = {
+	syscall_test0, syscall_test1, syscall_sleep, syscall_open,	 syscall_close,
+	syscall_read,  syscall_write, syscall_exit,	 syscall_sbrk,	 syscall_lseek,
+	syscall_pread, syscall_pwrite, syscall_readv, syscall_writev,
+	syscall_getdents, syscall_unlink, syscall_uptime, syscall_fork,
+	syscall_waitpid};
 
 /**
  * @brief Syscall interrupt handler
@@ -613,8 +786,9 @@ void *syscall_handler(struct interrupt_regs *r) {
 		syscall_test1();
 		break;
 	case 2:
+		// the registers of the task that runs next are on the stack
 		syscall_sleep(r);
-		break;
+		return (void *) r->eax;
 	case 3:
 		return (void *) syscall_open((char *) r->ebx, r->ecx);
 	case 4:
@@ -625,9 +799,30 @@ void *syscall_handler(struct interrupt_regs *r) {
 		return (void *) syscall_write(r->ebx, (void *) r->ecx, r->esi);
 	case 7:
 		syscall_exit(r);
-		break;
+		return (void *) r->eax;
 	case 8:
 		return syscall_sbrk(r->ebx);
+	case 9:
+		return (void *) syscall_lseek(r->ebx, r->ecx, r->esi);
+	case 10:
+		return (void *) syscall_pread(r->ebx, (void *) r->ecx, r->esi, r->edx);
+	case 11:
+		return (void *) syscall_pwrite(r->ebx, (void *) r->ecx, r->esi,
+									   r->edx);
+	case 12:
+		return (void *) syscall_readv(r->ebx, (struct iovec *) r->ecx, r->esi);
+	case 13:
+		return (void *) syscall_writev(r->ebx, (struct iovec *) r->ecx, r->esi);
+	case 14:
+		return (void *) syscall_getdents(r->ebx, (void *) r->ecx, r->esi);
+	case 15:
+		return (void *) syscall_unlink((char *) r->ebx);
+	case 16:
+		return (void *) syscall_uptime();
+	case 17:
+		return (void *) syscall_fork(r);
+	case 18:
+		return (void *) syscall_waitpid(r);
 	default:
 		printk("error: syscall not defined! (yet)\n");
 	}
@@ -0,0 +1,44 @@
+#ifndef BCACHE_H
+#define BCACHE_H 1
+
+#include <kernel/list.h>
+
+#include <stdint.h>
+
+/**
+ * Cache of file system blocks read from the disk, kept in LRU order. Reads
+ * larger than BCACHE_STREAM_BLOCKS go directly to the disk, so one big file
+ * doesn't evict every other cached block.
+ *
+ * The cache is not locked: it has to be used with interrupts disabled (as in
+ * syscalls and interrupt handlers).
+ */
+
+#define BCACHE_ENTRIES		 64
+#define BCACHE_STREAM_BLOCKS (BCACHE_ENTRIES / 2)
+#define BCACHE_MAX_RUN		 8			// blocks read by one prefetch command
+#define BCACHE_NO_BLOCK		 0xFFFFFFFF // the entry doesn't hold any block
+
+struct bcache_entry {
+	uint32_t block;				// number of the cached block
+	void *data;					// FS_BLOCK_SIZE bytes, allocated when needed
+	struct embedded_link list;	// position in the LRU list
+};
+
+struct bcache_stats {
+	uint32_t hits;		 // blocks found in the cache
+	uint32_t misses;	 // blocks read from the disk and cached
+	uint32_t bypassed;	 // blocks read from the disk without being cached
+	uint32_t prefetched; // blocks read ahead by bcache_prefetch()
+};
+
+uint8_t bcache_init(void);
+struct bcache_entry *bcache_find(uint32_t);
+void bcache_insert(uint32_t, const void *);
+uint8_t bcache_disk_read(uint32_t, uint32_t, void *);
+uint8_t bcache_read(uint32_t, uint32_t, void *);
+uint8_t bcache_prefetch(uint32_t, uint32_t);
+void bcache_invalidate(uint32_t, uint32_t);
+void bcache_print_stats(void);
+
+#endif /* !BCACHE_H */
@@ -11,6 +11,9 @@ typedef enum {
 #define ATA_PIO_PR_BASE		  0x1F0
 #define ATA_PIO_PR_CTRL_BASE  0x3F7
 
+#define ATA_PIO_DHR_LBA		  0xE0 // LBA addressing, master drive
+#define ATA_PIO_MAX_SECTORS	  256  // sectors transferred by one command
+
 #define ATA_PIO_SEC_BASE	  0x170
 #define ATA_PIO_SEC_CTRL_BASE 0x376
 
@@ -60,6 +63,7 @@ typedef enum {
  */
 typedef enum { ATA_PIO_SR_BSY = 0x80 } ATA_PIO_STATUS_REG;
 
+void ata_pio_select_sectors(uint32_t, uint32_t);
 uint8_t read_sectors(uint32_t, uint32_t, uint32_t);
 uint8_t write_sectors(uint32_t, uint32_t, uint32_t);
 
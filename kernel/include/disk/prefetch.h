@@ -0,0 +1,56 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H 1
+
+#include <stdint.h>
+
+/**
+ * Boot prefetch list, stored as a regular file (named "prefetch.lst") in the
+ * root directory of the disk image. During the first PREFETCH_RECORD_MS
+ * milliseconds after boot, every extent loaded from the disk is recorded and
+ * the list is then written back to the file. At the next boot, the prefetch
+ * task reads the recorded blocks into the block cache in disk order, before
+ * the programs ask for them. Layout (one block):
+ *
+ * |--------|---------|-----|---------|
+ * | header | entry 0 | ... | entry n |
+ * |--------|---------|-----|---------|
+ */
+
+#define PREFETCH_MAGIC		 0x4C465250 // "PRFL"
+#define PREFETCH_FILE_NAME	 "prefetch.lst"
+#define PREFETCH_FILE_PATH	 "/" PREFETCH_FILE_NAME
+#define PREFETCH_FILE_SIZE	 4096  // size of the file (one block)
+#define PREFETCH_RECORD_MS	 10000 // length of the recording after boot
+#define PREFETCH_MAX_ENTRIES 340
+
+// sizeof prefetch header: 8B
+struct prefetch_header {
+	uint32_t magic;
+	uint32_t count; // number of valid entries
+} __attribute__((packed));
+
+// sizeof prefetch entry: 12B
+struct prefetch_entry {
+	uint32_t inode;	 // id of the file the extent belongs to
+	uint32_t block;	 // first block of the extent
+	uint32_t length; // length in blocks
+} __attribute__((packed));
+
+// sizeof prefetch list: 4088B (fits in PREFETCH_FILE_SIZE)
+struct prefetch_list {
+	struct prefetch_header header;
+	struct prefetch_entry entries[PREFETCH_MAX_ENTRIES];
+} __attribute__((packed));
+
+#ifdef CONFIG_BOOT_PREFETCH
+
+uint8_t prefetch_init(void);
+void prefetch_record(uint32_t, uint32_t, uint32_t);
+void prefetch_sort(struct prefetch_entry *, uint32_t);
+void prefetch_replay(void);
+uint8_t prefetch_save(void);
+void prefetch_task_func(int, char **);
+
+#endif /* CONFIG_BOOT_PREFETCH */
+
+#endif /* !PREFETCH_H */
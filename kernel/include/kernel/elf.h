@@ -74,8 +74,37 @@ typedef struct {
 	struct elf_phys_mem_info *next;
 } elf_phys_mem_info;
 
+/**
+ * The pages of the read-only segments are shared by all the tasks running the
+ * same executable: the first task that touches a page fills it and adds it to
+ * a hash table (by inode and virtual address), the next ones map the same
+ * frame. The table holds one reference to every frame, dropped when the last
+ * task running the executable ends.
+ */
+#define ELF_TEXT_BUCKETS 64
+
+struct elf_text {
+	struct vfs_inode *inode; // the executable
+	uint32_t users;			 // tasks running it
+	struct elf_text *next;
+};
+
+struct elf_text_page {
+	struct vfs_inode *inode;
+	uint32_t address; // virtual address of the page
+	void *frame;	  // the shared frame
+	struct elf_text_page *next;
+};
+
 // void *load_elf(uint32_t *);
 void elf_after_program_execution(int);
+uint8_t elf_page_fault(uint32_t);
+uint8_t elf_text_get(struct vfs_inode *);
+void elf_text_put(struct vfs_inode *);
+void *elf_text_find(struct vfs_inode *, uint32_t);
+void elf_text_add(struct vfs_inode *, uint32_t, void *);
+struct vfs_inode *elf_open(char *);
+void *elf_load_exec(char *, uint32_t *, uint32_t *);
 uint8_t prepare_elf_execution(int, char **);
 
 #ifdef CONFIG_FCFS_SCH
@@ -1,6 +1,7 @@
 #ifndef FS_H
 #define FS_H 1
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define FS_BLOCK_SIZE	4096
@@ -8,6 +9,7 @@
 
 #define MAX_PATH_LENGTH 1024
 #define MAX_OPEN_FILES	256
+#define MAX_IOVEC		64
 
 typedef enum { FILETYPE_FILE = 0x0, FILETYPE_DIR = 0x1 } FS_FILETYPES;
 
@@ -70,15 +72,38 @@ struct directory_entry {
 	uint8_t name[60];
 } __attribute__((packed));
 
-// sizeof open files table: 16B
+struct vfs_inode;
+struct vfs_dirent;
+struct vfs_superblock;
+
+// open file, referred to by the file descriptors of the tasks
+// (see process/fdtable.h)
+// sizeof open files table: 12B
 struct open_files_table {
-	uint32_t *address;		   // virtual address - where file is loaded
-	uint32_t offset;		   // offset from base address
-	struct inode_block *inode; // file's inode
+	struct vfs_inode *inode; // shared in-memory inode (VFS)
+	uint32_t offset;		 // offset from base address
 	uint16_t flags;
-	uint16_t reference_number;
+	uint16_t reference_number; // number of descriptors referring to it
+} __attribute__((packed));
+
+// directory entry filled by the getdents syscall: records have variable
+// length (the name is stored right after the header) and are packed one after
+// the other in the user buffer
+struct fs_dirent {
+	uint32_t d_ino;	   // inode id
+	uint32_t d_off;	   // cookie of the next entry (directory offset)
+	uint16_t d_reclen; // length of this record
+	uint8_t d_type;	   // FILETYPE_FILE or FILETYPE_DIR
+	uint32_t d_size;   // size of the file in bytes
+	char d_name[];	   // null terminated file name
 } __attribute__((packed));
 
+// buffer description used by the vectored I/O syscalls (readv/writev)
+struct iovec {
+	void *iov_base; // start of the buffer
+	size_t iov_len; // size of the buffer
+};
+
 /**
  * @brief Convert bytes to blocks
  *
@@ -128,14 +153,21 @@ static uint32_t bytes_to_sectors(uint32_t bytes) {
 void print_superblock_info(void);
 void ls_root_dir(void);
 uint8_t fs_init(void);
-uint8_t fs_print_dir(void);
-char *get_current_path(void);
-void *init_open_files_table(void);
-void *init_open_inodes_table(void);
-struct inode_block get_inode_from_path(char *);
+struct inode_block get_inode_from_id(uint32_t);
+uint8_t load_inode_cache(void);
 uint8_t load_file(struct inode_block *, uint32_t);
-struct inode_block create_file(char *);
 uint8_t update_inode_data_disk(struct inode_block *);
 uint8_t update_data_block_disk(struct inode_block *, uint32_t);
 
+// on-disk file system backend of the VFS
+struct vfs_superblock *diskfs_get_superblock(void);
+uint8_t diskfs_read_inode(struct vfs_inode *);
+void diskfs_put_inode(struct vfs_inode *);
+uint8_t diskfs_load_data(struct vfs_inode *);
+uint32_t diskfs_lookup(struct vfs_inode *, const char *, size_t);
+int32_t diskfs_readdir(struct vfs_inode *, uint32_t, struct vfs_dirent *);
+size_t diskfs_read(struct vfs_inode *, void *, size_t, uint32_t);
+size_t diskfs_write(struct vfs_inode *, const void *, size_t, uint32_t);
+size_t diskfs_read_block(struct vfs_inode *, void *, uint32_t);
+
 #endif /* !FS_H */
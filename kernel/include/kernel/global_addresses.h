@@ -10,4 +10,13 @@
 #define KERNEL_VIRT_ADDR	0xC0000000
 #define LOWER_4MB_VIRT_ADDR 0x400000
 
+// the kernel image and heap; the page tables of the kernel range up to
+// KERNEL_TABLES_END are created at boot and shared by every address space
+#define KERNEL_HEAP_END		0xC4000000
+#define SLAB_VIRT_ADDR		0xC4000000 // slabs of the object caches
+#define SLAB_VIRT_END		0xC7000000
+#define PMM_METADATA_VIRT_ADDR 0xC7000000 // block metadata, see pmm.c
+#define KERNEL_TABLES_END	0xC8000000
+#define TEMP_MAP_VIRT_ADDR	0xC7FF0000 // temporary mappings, see vmm.h
+
 #endif
@@ -0,0 +1,50 @@
+#ifndef INITRD_H
+#define INITRD_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Initial RAM disk archive, stored as a regular file (named "initrd") in the
+ * root directory of the disk image. It is read in one sequential transfer at
+ * boot and mounted read-only at /initrd. Layout:
+ *
+ * |--------|---------|-----|---------|--------|-----|--------|
+ * | header | entry 0 | ... | entry n | data 0 | ... | data n |
+ * |--------|---------|-----|---------|--------|-----|--------|
+ *
+ * Offsets are relative to the beginning of the archive.
+ */
+
+#define INITRD_MAGIC		0x44525449 // "ITRD"
+#define INITRD_FILE_NAME	"initrd"
+#define INITRD_MOUNT_PATH	"/initrd"
+#define INITRD_NAME_LENGTH	60
+#define INITRD_MAX_FILES	64
+#define INITRD_ALIGNMENT	16 // alignment of the files' data
+
+// sizeof initrd header: 8B
+struct initrd_header {
+	uint32_t magic;
+	uint32_t num_files;
+} __attribute__((packed));
+
+// sizeof initrd entry: 68B
+struct initrd_entry {
+	char name[INITRD_NAME_LENGTH];
+	uint32_t offset; // offset of the file's data
+	uint32_t size;	 // size of the file in bytes
+} __attribute__((packed));
+
+struct vfs_superblock;
+struct vfs_inode;
+struct vfs_dirent;
+
+uint8_t initrd_init(void);
+struct vfs_superblock *initrd_create(void *, uint32_t);
+uint8_t initrd_read_inode(struct vfs_inode *);
+uint32_t initrd_lookup(struct vfs_inode *, const char *, size_t);
+int32_t initrd_readdir(struct vfs_inode *, uint32_t, struct vfs_dirent *);
+size_t initrd_read(struct vfs_inode *, void *, size_t, uint32_t);
+
+#endif /* !INITRD_H */
@@ -0,0 +1,44 @@
+#ifndef TMPFS_H
+#define TMPFS_H 1
+
+#include <kernel/fs.h>
+#include <kernel/vfs.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TMPFS_MAX_NODES		 128
+#define TMPFS_ROOT_ID		 1
+#define TMPFS_MIN_CAPACITY	 64
+#define TMPFS_MAX_FILE_SIZE	 0x100000 // 1MB, the data lives in the kernel heap
+
+typedef enum {
+	TMPFS_NODE_USED		= 0x1, // the node describes a file
+	TMPFS_NODE_UNLINKED = 0x2  // removed, freed when it is no longer in use
+} TMPFS_NODE_FLAGS;
+
+// file kept entirely in kernel memory, the node index is the inode id
+struct tmpfs_node {
+	uint32_t parent;			 // id of the parent directory
+	uint8_t type;				 // FILETYPE_FILE or FILETYPE_DIR
+	uint8_t flags;				 // TMPFS_NODE_FLAGS
+	uint32_t size;				 // size of the file in bytes
+	uint32_t capacity;			 // size of the allocated data buffer
+	void *data;					 // file's data
+	struct fs_datetime datetime; // creation date
+	char name[VFS_NAME_LENGTH];
+};
+
+struct vfs_superblock *tmpfs_create(void);
+struct tmpfs_node *tmpfs_get_node(struct vfs_inode *);
+uint32_t tmpfs_find(struct tmpfs_node *, uint32_t, const char *, size_t);
+uint8_t tmpfs_read_inode(struct vfs_inode *);
+void tmpfs_put_inode(struct vfs_inode *);
+uint32_t tmpfs_lookup(struct vfs_inode *, const char *, size_t);
+uint32_t tmpfs_create_file(struct vfs_inode *, const char *, size_t, uint8_t);
+uint8_t tmpfs_unlink(struct vfs_inode *, const char *, size_t);
+int32_t tmpfs_readdir(struct vfs_inode *, uint32_t, struct vfs_dirent *);
+size_t tmpfs_read(struct vfs_inode *, void *, size_t, uint32_t);
+size_t tmpfs_write(struct vfs_inode *, const void *, size_t, uint32_t);
+
+#endif /* !TMPFS_H */
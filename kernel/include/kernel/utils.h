@@ -1,6 +1,8 @@
 #ifndef _KUTILS_H
 #define _KUTILS_H 1
 
+#include <stdint.h>
+
 #define stdin	  0
 #define stdout	  1
 #define stderr	  2
@@ -9,9 +11,66 @@ typedef enum {
 	O_RDONLY	= 0x1, // open file only with read permissions
 	O_WRONLY	= 0x2, // open file only with write permissions
 	O_RDWR		= 0x4,	// open file with read-write permissions
-	O_CREAT		= 0x8	// create file if it doesn't exits
+	O_CREAT		= 0x8,	// create file if it doesn't exits
+	O_DIRECTORY	= 0x10	// open a directory (for getdents)
 } OPEN_FLAGS;
 
+typedef enum {
+	SEEK_SET	= 0x0, // offset is set to the given offset
+	SEEK_CUR	= 0x1, // offset is set to the current offset plus the given one
+	SEEK_END	= 0x2  // offset is set to the file size plus the given one
+} SEEK_WHENCE;
+
 int ceil(int a, int b);
 
+/**
+ * @brief Get the index of the lowest set bit (bsf instruction)
+ *
+ * @param value The value, has to be different from 0
+ */
+static inline uint32_t bit_scan_forward(uint32_t value) {
+	uint32_t index;
+
+	__asm__("bsf %1, %0" : "=r"(index) : "rm"(value));
+
+	return index;
+}
+
+/**
+ * @brief Get the index of the highest set bit (bsr instruction)
+ *
+ * @param value The value, has to be different from 0
+ */
+static inline uint32_t bit_scan_reverse(uint32_t value) {
+	uint32_t index;
+
+	__asm__("bsr %1, %0" : "=r"(index) : "rm"(value));
+
+	return index;
+}
+
+/**
+ * @brief Get the number of set bits
+ *
+ * @param value The value
+ */
+static inline uint32_t bit_count(uint32_t value) {
+	value = value - ((value >> 1) & 0x55555555);
+	value = (value & 0x33333333) + ((value >> 2) & 0x33333333);
+	value = (value + (value >> 4)) & 0x0F0F0F0F;
+
+	return (value * 0x01010101) >> 24;
+}
+
+/**
+ * @brief Read the time stamp counter (CPU cycles since reset)
+ */
+static inline uint64_t read_tsc(void) {
+	uint64_t tsc;
+
+	__asm__ __volatile__("rdtsc" : "=A"(tsc));
+
+	return tsc;
+}
+
 #endif
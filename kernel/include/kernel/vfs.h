@@ -0,0 +1,111 @@
+#ifndef VFS_H
+#define VFS_H 1
+
+#include <kernel/fs.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VFS_MAX_MOUNTS		8
+#define VFS_INODE_BUCKETS	64
+#define VFS_MOUNT_PATH_LEN	64
+#define VFS_NAME_LENGTH		60
+
+typedef enum {
+	VFS_MOUNT_RDONLY = 0x1 // files cannot be written, created or removed
+} VFS_MOUNT_FLAGS;
+
+struct vfs_superblock;
+struct vfs_inode;
+
+// directory entry as returned by the readdir inode operation
+struct vfs_dirent {
+	uint32_t id;				 // inode id inside the file system
+	uint8_t type;				 // FILETYPE_FILE or FILETYPE_DIR
+	uint32_t size;				 // size of the file in bytes
+	struct fs_datetime datetime; // creation date
+	char name[VFS_NAME_LENGTH];
+};
+
+// operations on a mounted file system
+struct vfs_super_operations {
+	// fill the in-memory inode (its id is already set) from the file system
+	uint8_t (*read_inode)(struct vfs_inode *);
+	// the last reference to the in-memory inode was dropped
+	void (*put_inode)(struct vfs_inode *);
+};
+
+// operations on directories (names are not null terminated)
+struct vfs_inode_operations {
+	// return the id of the named file in the directory, 0 if not found
+	uint32_t (*lookup)(struct vfs_inode *, const char *, size_t);
+	// create a file in the directory and return its id, 0 if error (optional,
+	// files cannot be created on the file system without it)
+	uint32_t (*create)(struct vfs_inode *, const char *, size_t, uint8_t);
+	// remove the named file from the directory
+	uint8_t (*unlink)(struct vfs_inode *, const char *, size_t);
+	// fill the first entry at or after the given index and return the index
+	// of the next one, -1 if there are no more entries
+	int32_t (*readdir)(struct vfs_inode *, uint32_t, struct vfs_dirent *);
+};
+
+// operations on open files
+struct vfs_file_operations {
+	// called every time the file is opened
+	uint8_t (*open)(struct vfs_inode *);
+	size_t (*read)(struct vfs_inode *, void *, size_t, uint32_t);
+	size_t (*write)(struct vfs_inode *, const void *, size_t, uint32_t);
+	// read one block of the file without loading the whole file (optional)
+	size_t (*read_block)(struct vfs_inode *, void *, uint32_t);
+};
+
+struct vfs_superblock {
+	const char *name;	   // file system name
+	uint8_t flags;		   // VFS_MOUNT_FLAGS
+	uint32_t root_id;	   // id of the root directory
+	struct vfs_super_operations *s_op;
+	void *private;		   // file system specific data
+};
+
+struct vfs_mount {
+	char path[VFS_MOUNT_PATH_LEN]; // normalized path of the mount point
+	size_t path_len;
+	struct vfs_superblock *sb; // NULL if the entry is free
+};
+
+// in-memory inode, shared by every open file entry that refers to the same
+// file (same superblock and id)
+struct vfs_inode {
+	uint32_t id;				 // inode id inside the file system
+	uint8_t type;				 // FILETYPE_FILE or FILETYPE_DIR
+	uint32_t size;				 // size of the file in bytes
+	struct fs_datetime datetime; // creation date
+	uint32_t *address; // file's data, if the file system keeps it in memory
+	uint8_t dirty; // data changed, written back when the last user drops it
+	struct vfs_superblock *sb;
+	struct vfs_inode_operations *i_op;
+	struct vfs_file_operations *f_op;
+	void *private;			   // file system specific data
+	uint16_t reference_number; // number of users of the inode
+	struct vfs_inode *next;	   // next inode in the same bucket
+};
+
+uint8_t vfs_init(void);
+uint8_t vfs_mount(const char *, struct vfs_superblock *);
+struct vfs_inode *vfs_iget(struct vfs_superblock *, uint32_t);
+void vfs_iput(struct vfs_inode *);
+uint8_t vfs_normalize_path(const char *, char *);
+struct vfs_mount *vfs_find_mount(const char *, const char **);
+struct vfs_inode *vfs_walk(const char *);
+struct vfs_inode *vfs_walk_parent(char *, char **);
+struct vfs_inode *vfs_lookup(const char *, uint8_t);
+struct vfs_inode *vfs_open(const char *, uint32_t);
+uint8_t vfs_unlink(const char *);
+size_t vfs_read(struct vfs_inode *, void *, size_t, uint32_t);
+size_t vfs_write(struct vfs_inode *, const void *, size_t, uint32_t);
+size_t vfs_read_block(struct vfs_inode *, void *, uint32_t);
+int32_t vfs_readdir(struct vfs_inode *, uint32_t, struct vfs_dirent *);
+uint8_t vfs_print_dir(const char *);
+char *vfs_get_cwd(void);
+
+#endif /* !VFS_H */
@@ -0,0 +1,43 @@
+#ifndef MM_BUDDY_H
+#define MM_BUDDY_H 1
+
+#include <stdint.h>
+
+/**
+ * Binary buddy allocator for physical memory. A free block of order k has
+ * 2^k frames and starts with a frame whose index is a multiple of 2^k. Every
+ * order has its own free list; a free block and its buddy (the block whose
+ * index differs only in bit k) are merged when both are free.
+ *
+ * The free lists are linked through a metadata array with one entry per
+ * frame, as the frames themselves are not mapped. The metadata is used only
+ * for the first frame of every free block.
+ */
+
+#define BUDDY_MAX_ORDER		10		   // 1024 frames (4MB)
+#define BUDDY_NONE			0xFFFFFFFF // end of a free list
+
+struct buddy_frame {
+	uint32_t next; // next free block of the same order
+	uint32_t prev; // previous free block of the same order
+	uint8_t order; // order of the free block starting with the frame
+	uint8_t free;  // 1 if a free block starts with the frame
+} __attribute__((packed));
+
+struct buddy_stats {
+	uint32_t allocations;
+	uint32_t splits;	// blocks split in two
+	uint32_t merges;	// blocks merged with their buddy
+};
+
+void buddy_init(struct buddy_frame *, uint32_t);
+void buddy_relocate(struct buddy_frame *);
+uint8_t buddy_order(uint32_t);
+void buddy_list_add(uint32_t, uint8_t);
+void buddy_list_remove(uint32_t);
+uint32_t buddy_alloc(uint8_t);
+void buddy_free(uint32_t, uint8_t);
+void buddy_free_range(uint32_t, uint32_t);
+void buddy_print_info(void);
+
+#endif /* !MM_BUDDY_H */
@@ -0,0 +1,46 @@
+#ifndef MM_FRAME_H
+#define MM_FRAME_H 1
+
+#include <stdint.h>
+
+/**
+ * Page frame database: one entry for every physical frame, recording how many
+ * references the frame has (a page table entry mapping it counts as one) and
+ * what it is used for. Frames are freed when their last reference is dropped,
+ * so a frame can be mapped in several address spaces.
+ */
+
+// owner types
+#define FRAME_OWNER_FREE		0
+#define FRAME_OWNER_RESERVED	1 // firmware, kernel image, unusable memory
+#define FRAME_OWNER_METADATA	2 // memory manager structures
+#define FRAME_OWNER_KERNEL		3 // other kernel allocations
+#define FRAME_OWNER_PAGE_TABLE	4 // page directories and page tables
+#define FRAME_OWNER_KHEAP		5 // kmalloc heap
+#define FRAME_OWNER_USER		6 // user space pages
+#define FRAME_OWNER_SLAB		7 // slabs of the object caches
+#define FRAME_OWNER_COUNT		8
+
+// flags
+#define FRAME_MAPPED			0x1 // mapped in a user address space
+
+#define FRAME_MAX_REFCOUNT		0xFFFF
+
+struct page_frame {
+	uint16_t refcount;
+	uint8_t flags;
+	uint8_t owner;
+} __attribute__((packed));
+
+void frame_db_init(struct page_frame *, uint32_t);
+void frame_db_relocate(struct page_frame *);
+void frame_db_alloc(uint32_t, uint32_t);
+void frame_db_free(uint32_t, uint32_t);
+void frame_db_set_owner(uint32_t, uint32_t, uint8_t);
+struct page_frame *frame_info(void *);
+void frame_set_owner(void *, uint8_t);
+uint8_t frame_get(void *);
+uint16_t frame_put(void *);
+void frame_db_print_info(void);
+
+#endif /* !MM_FRAME_H */
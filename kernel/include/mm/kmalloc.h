@@ -13,16 +13,70 @@
 #define ALIGN(size, alignment) (((size) + (alignment - 1)) & ~(alignment - 1))
 #define METADATA_BLK_SIZE	   ALIGN(sizeof(struct kblock_meta), ALIGNMENT)
 
+/**
+ * Free blocks are kept in segregated lists, one for every power-of-two size
+ * class: class k holds the free blocks with sizes in [2^k, 2^(k+1)). The last
+ * class holds all the large blocks. A request is served by the first block of
+ * the first non-empty class whose blocks are all big enough (found with bsf
+ * on a mask of non-empty classes); large requests use a best fit search in
+ * the large classes.
+ */
+#define KMALLOC_CLASSES		   16
+#define KMALLOC_LARGE_CLASS	   (KMALLOC_CLASSES - 1) // blocks of 32KB and more
+#define KMALLOC_MAGIC		   0x4B4D // "KM"
+
+/**
+ * The whole pages inside the free blocks are unmapped and given back to the
+ * physical memory manager once more than KMALLOC_RELEASE_WATERMARK free bytes
+ * are kept mapped, so small bursts don't remap pages again and again. The
+ * virtual range stays in the block and is mapped again when it is reused.
+ */
+#define KMALLOC_RELEASE_WATERMARK (64 * 1024)
+
+#ifdef CONFIG_KHEAP_PROFILE
+/**
+ * Allocation sites are the return addresses of the kmalloc() calls. They are
+ * kept in a small open addressing table; when it is full, the new sites are
+ * counted in the last entry.
+ */
+#define KMALLOC_PROFILE_SITES 128
+#define KMALLOC_PROFILE_TOP	  16 // sites shown by kmalloc_print_stats()
+
+struct kmalloc_site {
+	uint32_t address;	  // return address of the call, 0 for the others
+	uint32_t live_bytes;  // bytes of the blocks still allocated
+	uint32_t live_blocks; // blocks still allocated
+	uint32_t allocations; // all the allocations made
+};
+#endif /* CONFIG_KHEAP_PROFILE */
+
 // structure for the block metadata
 struct kblock_meta {
 	size_t size;
-	uint8_t status;
-	struct kblock_meta *next;
-	struct kblock_meta *prev;
+	uint16_t status;
+	uint16_t magic;			   // KMALLOC_MAGIC, checked by kfree()
+	struct kblock_meta *next;  // next block in memory
+	struct kblock_meta *prev;  // previous block in memory
+	struct kblock_meta *next_free; // next block in the free list (free blocks)
+	struct kblock_meta *prev_free;
+#ifdef CONFIG_KHEAP_PROFILE
+	uint32_t site; // index of the allocation site (allocated blocks)
+#endif
 };
 
 void *kmalloc(size_t size);
 void kfree(void *ptr);
 void kmalloc_print_list(void);
+uint32_t kmalloc_size_class(uint32_t);
+void kmalloc_free_list_add(struct kblock_meta *);
+void kmalloc_free_list_remove(struct kblock_meta *);
+uint8_t kmalloc_map_range(uint32_t, uint32_t);
+void kmalloc_release_block(struct kblock_meta *);
+void kmalloc_print_stats(void);
+#ifdef CONFIG_KHEAP_PROFILE
+void kmalloc_profile_alloc(struct kblock_meta *, uint32_t, uint32_t);
+void kmalloc_profile_free(struct kblock_meta *);
+void kmalloc_print_profile(void);
+#endif
 
 #endif /* !MM_KMALLOC_H */
@@ -0,0 +1,31 @@
+#ifndef MM_PAGEZERO_H
+#define MM_PAGEZERO_H 1
+
+#include <stdint.h>
+
+/**
+ * Pool of zeroed blocks. Single blocks given back with free_blocks() are kept
+ * (instead of going back to the buddy allocator) and the init task zeroes them
+ * when no other task is ready to run, so allocations with PMM_ZERO (page
+ * directories, user pages) don't clear the memory on the spot. At most
+ * PAGEZERO_POOL_SIZE blocks are kept, zeroed or not; they are given back to
+ * the buddy allocator when it runs out of memory.
+ */
+
+#define PAGEZERO_POOL_SIZE 64 // blocks kept, zeroed or waiting to be zeroed
+#define PAGEZERO_BATCH	   4  // blocks zeroed every time the CPU is idle
+
+struct pagezero_stats {
+	uint32_t hits;	 // allocations served from the pool
+	uint32_t misses; // allocations that found the pool empty
+	uint32_t zeroed; // blocks zeroed while idle
+};
+
+void pagezero_init(void);
+uint8_t pagezero_put(void *);
+void *pagezero_get(void);
+uint32_t pagezero_reclaim(void);
+void pagezero_idle(void);
+void pagezero_print_info(void);
+
+#endif /* !MM_PAGEZERO_H */
@@ -7,7 +7,14 @@
 #define MEM_MAP_ADDRESS			   0x1004
 
 #define BLOCK_SIZE				   4096 // 4K
-#define BITMAP_ADDRESS			   0x60000
+#define BITMAP_ADDRESS			   0x60000 // up to 128KB, below the boot stack
+
+#define PMM_MAX_ADDRESS			   0xFFFFFFFF // memory above is not used (no PAE)
+
+#define PMM_BENCHMARK_ITERATIONS   1000
+
+// allocation flags
+#define PMM_ZERO				   0x1 // the blocks are filled with zeros
 
 struct mem_map_entry {
 	uint64_t base_addr;
@@ -18,8 +25,15 @@ struct mem_map_entry {
 
 void print_mem_map(void);
 uint8_t initialize_memory(void);
+uint32_t __allocate_metadata(uint32_t);
+uint8_t initialize_buddy(void);
+void pmm_get_metadata(uint32_t *, uint32_t *);
+void pmm_relocate_metadata(void *);
 void *allocate_blocks(uint32_t);
+void *allocate_blocks_flags(uint32_t, uint8_t);
 void free_blocks(void *, uint32_t);
+void __free_range(uint32_t, uint32_t);
 void print_phymem_info(void);
+void pmm_benchmark(void);
 
 #endif /* !MM_PMM_H */
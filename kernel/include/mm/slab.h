@@ -0,0 +1,77 @@
+#ifndef MM_SLAB_H
+#define MM_SLAB_H 1
+
+#include <kernel/list.h>
+
+#include <stdint.h>
+
+/**
+ * Slab allocator for fixed-size kernel objects. Every cache holds objects of
+ * one type, carved out of slabs of 2^k physical blocks. A slab starts with its
+ * header and a stack with the indices of its free objects, followed by the
+ * objects:
+ *
+ * |--------|------------------|----------|-----|----------|
+ * | header | free index stack | object 0 | ... | object n |
+ * |--------|------------------|----------|-----|----------|
+ *
+ * Slabs are aligned to their size, so the slab of an object is found by
+ * clearing the low bits of its address. Every slab gets a virtual range of
+ * SLAB_VIRT_SIZE bytes between SLAB_VIRT_ADDR and SLAB_VIRT_END, where its
+ * blocks (any free blocks, not contiguous) are mapped; the page tables of this
+ * range are shared by every address space. The constructor of a cache
+ * is called once for every object, when its slab is created: objects have to
+ * be returned to their constructed state before they are freed.
+ */
+
+#define SLAB_MAX_ORDER		  3	 // at most 8 blocks per slab
+#define SLAB_MAX_WASTE		  8	 // at most 1/8 of a slab is wasted if possible
+#define SLAB_MAX_EMPTY		  1	 // empty slabs kept by a cache
+#define SLAB_MAX_OBJECTS	  0xFFFF
+#define SLAB_CACHE_NAME_SIZE  20
+
+// virtual range of a slab (fits the biggest slab, so every slab is aligned)
+#define SLAB_VIRT_SIZE		  (BLOCK_SIZE << SLAB_MAX_ORDER)
+#define SLAB_VIRT_SLOTS		  ((SLAB_VIRT_END - SLAB_VIRT_ADDR) / SLAB_VIRT_SIZE)
+
+struct slab {
+	struct embedded_link list; // in the full, partial or empty list
+	struct slab_cache *cache;
+	uint16_t in_use;		   // allocated objects
+	uint16_t free_count;	   // number of indices on the free stack
+	uint16_t free_stack[];	   // indices of the free objects
+};
+
+struct slab_cache_stats {
+	uint32_t allocations;
+	uint32_t frees;
+	uint32_t slabs_created;
+	uint32_t slabs_destroyed;
+};
+
+struct slab_cache {
+	char name[SLAB_CACHE_NAME_SIZE];
+	uint32_t object_size;	   // aligned size of an object
+	uint32_t slab_blocks;	   // blocks per slab (power of two)
+	uint32_t objects_per_slab;
+	uint32_t objects_offset;   // offset of the first object in a slab
+	void (*ctor)(void *);
+	struct embedded_link full;
+	struct embedded_link partial;
+	struct embedded_link empty;
+	uint32_t num_slabs;
+	uint32_t num_empty;
+	uint32_t active_objects;
+	struct slab_cache_stats stats;
+	struct embedded_link list; // in the list of all caches
+};
+
+struct slab_cache *slab_cache_create(const char *, uint32_t, void (*)(void *));
+void *slab_virt_alloc(void);
+void slab_virt_free(void *);
+void slab_unmap(struct slab *, uint32_t);
+void *slab_alloc(struct slab_cache *);
+void slab_free(struct slab_cache *, void *);
+void slab_print_info(void);
+
+#endif /* !MM_SLAB_H */
@@ -7,6 +7,11 @@
 #define TABLES_PER_DIR					1024
 
 #define PAGE_SIZE						4096
+#define LARGE_PAGE_SIZE					0x400000 // 4MB page (PSE)
+
+// CPUID (EAX = 1) feature flags in EDX
+#define CPUID_EDX_PSE					0x8	   // 4MB pages
+#define CPUID_EDX_PGE					0x2000 // global pages
 
 #define PAGE_DIRECTORY_INDEX(x)			(((x) >> 22) & 0x3FF)
 #define PAGE_TABLE_INDEX(x)				(((x) >> 12) & 0x3FF)
@@ -17,6 +22,36 @@
 #define TEST_ATTRIBUTE(entry, attr)		(*entry & attr)
 #define SET_FRAME(entry, address)		(*entry = (*entry & ~0x7FFFF000) | address)
 
+/**
+ * The last entry of every page directory maps the page directory itself, so
+ * the paging structures of the current address space are at fixed virtual
+ * addresses: the page directory in the last page and the page table of every
+ * 4MB region in the last 4MB of the address space (the page table of region i
+ * at RECURSIVE_WINDOW + i * PAGE_SIZE).
+ */
+#define RECURSIVE_PDE_INDEX				1023
+#define RECURSIVE_WINDOW				0xFFC00000
+#define CURRENT_PAGE_DIRECTORY			((struct page_directory *) 0xFFFFF000)
+#define CURRENT_PAGE_TABLE(x)                                                  \
+	((struct page_table *) (RECURSIVE_WINDOW +                                 \
+							(PAGE_DIRECTORY_INDEX(x) << 12)))
+
+/**
+ * Slots of the temporary mappings (pages at TEMP_MAP_VIRT_ADDR), used to reach
+ * the blocks that are not mapped in the current address space: blocks cleared
+ * by the physical memory manager, page directories and page tables of other
+ * address spaces, copies of pages. A slot is reused by the next mapping, so
+ * its users must not interrupt each other (they run with interrupts disabled,
+ * the idle zeroing of the pagezero pool has its own slot).
+ */
+typedef enum {
+	TEMP_MAP_PMM,
+	TEMP_MAP_DIRECTORY,
+	TEMP_MAP_TABLE,
+	TEMP_MAP_PAGEZERO,
+	TEMP_MAP_SLOTS
+} TEMP_MAP_SLOT;
+
 /**
  * Page Directory Entry Format (4K)
  *
@@ -32,6 +67,7 @@
  * PCD: 1 = the page will not be cached; 0 = the page will be cached
  * A: Accessed: used to discover whether a PDE or PTE was read during the
  * virtual address translation PS: Page Size: 1 = 4MB page; 0 = 4KB page
+ * G: (bit 8, only for 4MB pages) Global, see the PTE format
  */
 typedef enum {
 	PAGE_PDE_PRESENT		= 0x1,
@@ -40,6 +76,7 @@ typedef enum {
 	PAGE_PDE_WRITE_THROUGH	= 0x8,
 	PAGE_PDE_DISABLE_CACHE	= 0x10,
 	PAGE_PDE_4MB			= 0x80,
+	PAGE_PDE_GLOBAL			= 0x100,
 	PAGE_PDE_FRAME			= 0x7FFFF000
 } PAGE_PDE_FLAGS;
 
@@ -58,6 +95,8 @@ typedef enum {
  * 		to the page upon a MOV to CR3 instruction (change of PDE)
  * PAT: Page Attribute Table. If PAT is supported, then PAT along with PCD and
  * PWT indiccate the memory caching type. Otherwise must be set to 0 (reserved)
+ * COW: (first bit ignored by the processor) the page is shared read-only after
+ * a fork and is copied on the first write
  */
 typedef enum {
 	PAGE_PTE_PRESENT		= 0x1,
@@ -68,6 +107,7 @@ typedef enum {
 	PAGE_PTE_DIRTY			= 0x40,
 	PAGE_PTE_PAT			= 0x80,
 	PAGE_PTE_GLOBAL			= 0x100,
+	PAGE_PTE_COW			= 0x200,
 	PAGE_PTE_FRAME			= 0x7FFFF000
 } PAGE_PTE_FLAGS;
 
@@ -94,9 +134,16 @@ struct page_table {
 uint8_t initialize_virtual_memory(void);
 uint8_t map_page(void *, void *);
 uint8_t map_user_page(void *, void *);
+uint8_t map_large_page(void *, void *);
+uint8_t user_page_present(address);
+uint8_t map_user_zero_page(address);
 void unmap_page(void *);
+void flush_tlb_entry(address);
 pt_entry *get_page(address);
+void *map_temporary(void *, TEMP_MAP_SLOT);
 struct page_directory *create_address_space(void);
+struct page_directory *clone_address_space(void);
+uint8_t copy_on_write_page(address);
 uint8_t set_page_directory(struct page_directory *);
 void restore_kernel_address_space(void);
 address get_physical_addr(address);
@@ -0,0 +1,44 @@
+#ifndef _FDTABLE_H
+#define _FDTABLE_H 1
+
+#include <kernel/fs.h>
+
+#include <stdint.h>
+
+/**
+ * Per-task file descriptor table. Descriptors point at open file objects
+ * (struct open_files_table), which can be shared by several descriptors.
+ *
+ * Free descriptors are found with a two level bitmap: a bit in the bitmap is
+ * set if the descriptor is used, and a bit in the summary is set if the
+ * corresponding bitmap word is full. The lowest free descriptor is found with
+ * two bsf instructions. The table is created by the first open and doubles in
+ * size when it is full, up to MAX_OPEN_FILES descriptors.
+ */
+
+#define FD_TABLE_INITIAL_SIZE 32
+#define FD_TABLE_MAX_SIZE	  MAX_OPEN_FILES // at most 32 bitmap words
+#define FD_RESERVED			  3 // stdin, stdout and stderr
+
+struct fd_table {
+	struct open_files_table **files; // NULL if the descriptor is free
+	uint32_t *bitmap;				 // one bit per descriptor, set if used
+	uint32_t summary;				 // one bit per bitmap word, set if full
+	uint32_t size;					 // number of descriptors
+	uint32_t used;					 // number of used descriptors
+};
+
+struct task_struct;
+struct vfs_inode;
+
+struct fd_table *fd_table_create(uint32_t);
+uint8_t fd_table_grow(struct fd_table *);
+struct fd_table *fd_table_copy(struct fd_table *);
+int fd_alloc(struct task_struct *, struct open_files_table *);
+struct open_files_table *fd_get(struct task_struct *, int);
+struct open_files_table *fd_free(struct task_struct *, int);
+struct open_files_table *open_file_create(struct vfs_inode *, uint16_t);
+void open_file_put(struct open_files_table *);
+void fd_table_destroy(struct task_struct *);
+
+#endif /* !_FDTABLE_H */
@@ -1,11 +1,26 @@
 #ifndef _PROCESS_H
 #define _PROCESS_H 1
 
+#include <kernel/list.h>
 #include <mm/vmm.h>
+#include <process/fdtable.h>
 
 #include <stdint.h>
 
-#define KSTACK_SIZE 4096
+#define KSTACK_SIZE			   4096
+
+// heap pages mapped by a heap page fault (the faulting one and the next ones)
+#define USER_HEAP_FAULT_AROUND 4
+
+// largest size of the user stack, the stack grows on page faults up to it
+#ifdef CONFIG_USER_STACK_SIZE
+#define USER_STACK_MAX_SIZE	   (CONFIG_USER_STACK_SIZE * 1024)
+#else
+#define USER_STACK_MAX_SIZE	   (64 * 1024)
+#endif
+
+// pages under the stack region that are never mapped (the heap stops before)
+#define USER_STACK_GUARD_SIZE  (16 * PAGE_SIZE)
 
 enum task_state {
 	TASK_CREATED,
@@ -15,6 +30,35 @@ enum task_state {
 	TASK_TERMINATED
 };
 
+// node in the task queue (embedded in the task, so queueing a task never
+// allocates memory)
+struct task_node {
+	struct task_struct *task;
+	struct embedded_link list;
+};
+
+/*
+ * delta queue for sleeping tasks
+ *
+ * tasks are sorted by the difference in sleeping
+ * times relative to the previous task
+ *
+ * e.g. task1 sleeps 10ms, task2 12ms and task3 2ms:
+ *
+ *          -------    -------    -------
+ * head ->  | 2ms | -> | 8ms | -> | 2ms |
+ *          -------    -------    -------
+ *           task3      task1      task2
+ *
+ * the head represents the next task to wake up, with the
+ * smallest remaining time
+ */
+struct delta_queue_node {
+	int delta_time_ms;
+	struct task_struct *task;
+	struct embedded_link list;
+};
+
 /*
  * context of a running process
  *
@@ -44,12 +88,27 @@ struct proc_context {
 	uint32_t useresp;
 };
 
+typedef enum {
+	MAPPING_FILE	 = 0x1, // filled from the executable on page fault
+	MAPPING_WRITABLE = 0x2
+} MAPPING_FLAGS;
+
 struct mapping {
 	void *address;
 	uint32_t size;
+	uint32_t offset;	// offset of the data in the executable (MAPPING_FILE)
+	uint32_t file_size; // bytes from the file, the rest is zero-filled
+	uint8_t flags;		// MAPPING_FLAGS
 	struct mapping *next;
 };
 
+// exit of a forked task, kept until its parent waits for it
+struct task_exit {
+	uint32_t task_id;
+	int exit_code;
+	struct task_exit *next;
+};
+
 /**
  * task struct
  *
@@ -71,15 +130,31 @@ struct task_struct {
 	void *kstack;
 	void *heap_start;
 	void *program_break;
-	uint32_t heap_size_blocks;
+	uint32_t heap_size_blocks; // heap region, mapped on first touch
+	void *stack_limit; // lowest address of the stack, mapped on first touch
 	struct mapping *maps;
 	uint32_t run_time;
 	uint32_t sleep_time;
 	int ring;
+	struct fd_table *files; // created by the first open
+	struct vfs_inode *exec_inode; // executable (segments mapped on demand)
+	struct task_struct *parent;	  // task that forked this one, NULL if none
+	struct task_struct *children; // forked tasks that did not exit yet
+	struct task_struct *sibling;  // next child of the parent
+	struct task_exit *exited;	  // children that exited, not waited for yet
+	int wait_pid; // child waited for (-1: any child), 0 if not waiting
+	int exit_code;
+	uint8_t shell_task; // started by the shell, which waits for it to exit
+	struct task_node run_node;			 // in the task queue
+	struct delta_queue_node sleep_node; // in the sleeping queue
 };
 
+uint8_t process_caches_init(void);
+void free_kstack(void *);
 struct task_struct *create_task(void *, int, char **, int);
+struct task_struct *fork_task(struct task_struct *);
 void destroy_task(struct task_struct *);
+int task_reap_child(struct task_struct *, int, int *);
 void ktask_exit(void);
 
 #ifdef CONFIG_FCFS_SCH
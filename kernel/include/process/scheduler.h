@@ -7,34 +7,6 @@
 
 #include <stdint.h>
 
-// node in the task queue
-struct task_node {
-	struct task_struct *task;
-	struct embedded_link list;
-};
-
-/*
- * delta queue for sleeping tasks
- *
- * tasks are sorted by the difference in sleeping
- * times relative to the previous task
- *
- * e.g. task1 sleeps 10ms, task2 12ms and task3 2ms:
- *
- *          -------    -------    -------
- * head ->  | 2ms | -> | 8ms | -> | 2ms |
- *          -------    -------    -------
- *           task3      task1      task2
- *
- * the head represents the next task to wake up, with the
- * smallest remaining time
- */
-struct delta_queue_node {
-	int delta_time_ms;
-	struct task_struct *task;
-	struct embedded_link list;
-};
-
 typedef enum { RUNNING_TASK_QUEUE, SLEEPING_TASK_QUEUE } QUEUE_TYPE;
 
 /*
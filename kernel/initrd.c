@@ -0,0 +1,200 @@
+#include <kernel/initrd.h>
+#include <kernel/string.h>
+#include <kernel/tty.h>
+#include <kernel/utils.h>
+#include <kernel/vfs.h>
+#include <mm/kmalloc.h>
+
+#include <stddef.h>
+
+// id of the root directory, the file at entry i has id i + 2
+#define INITRD_ROOT_ID 1
+
+// in-memory inode of the archive (never released, the archive's data is used
+// directly by the mounted file system)
+struct vfs_inode *initrd_archive;
+
+struct vfs_super_operations initrd_super_ops = {
+	.read_inode = initrd_read_inode,
+	.put_inode = NULL, // data belongs to the archive
+};
+
+struct vfs_inode_operations initrd_inode_ops = {
+	.lookup = initrd_lookup,
+	.create = NULL,
+	.unlink = NULL,
+	.readdir = initrd_readdir,
+};
+
+struct vfs_file_operations initrd_file_ops = {
+	.open = NULL,
+	.read = initrd_read,
+	.write = NULL,
+	.read_block = NULL,
+};
+
+/**
+ * @brief Load the initial RAM disk and mount it
+ *
+ * The archive is a regular file in the root directory of the disk and is
+ * stored in a single extent, so opening it loads the whole archive in one
+ * sequential transfer. It is then mounted read-only at /initrd. A missing
+ * archive is not an error.
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t initrd_init(void) {
+	initrd_archive = vfs_open("/" INITRD_FILE_NAME, O_RDONLY);
+
+	if (initrd_archive == NULL) {
+#ifdef CONFIG_VERBOSE
+		printk("no initrd found\n");
+#endif
+		return 0;
+	}
+
+	struct vfs_superblock *sb =
+		initrd_create(initrd_archive->address, initrd_archive->size);
+
+	if (sb == NULL || vfs_mount(INITRD_MOUNT_PATH, sb)) {
+		vfs_iput(initrd_archive);
+		initrd_archive = NULL;
+		return 1;
+	}
+
+#ifdef CONFIG_VERBOSE
+	struct initrd_header *header = sb->private;
+	printk("initrd: %d files, %d bytes\n", header->num_files,
+		   initrd_archive->size);
+#endif
+
+	return 0;
+}
+
+/**
+ * @brief Create a read-only file system from an initrd archive in memory
+ *
+ * @param archive	Start of the archive
+ * @param size		Size of the archive in bytes
+ *
+ * @return The superblock of the file system, NULL if the archive is invalid
+ */
+struct vfs_superblock *initrd_create(void *archive, uint32_t size) {
+	struct initrd_header *header = archive;
+
+	if (archive == NULL || size < sizeof(struct initrd_header) ||
+		header->magic != INITRD_MAGIC ||
+		header->num_files > INITRD_MAX_FILES ||
+		size < sizeof(struct initrd_header) +
+				   header->num_files * sizeof(struct initrd_entry)) {
+		printk("invalid initrd archive\n");
+		return NULL;
+	}
+
+	struct initrd_entry *entry = archive + sizeof(struct initrd_header);
+
+	for (uint32_t i = 0; i < header->num_files; i++) {
+		if (entry[i].offset > size || entry[i].size > size - entry[i].offset ||
+			entry[i].name[INITRD_NAME_LENGTH - 1] != '\0') {
+			printk("invalid initrd entry: %d\n", i);
+			return NULL;
+		}
+	}
+
+	struct vfs_superblock *sb = kmalloc(sizeof(struct vfs_superblock));
+
+	if (sb == NULL) {
+		printk("out of memory\n");
+		return NULL;
+	}
+
+	sb->name = "initrd";
+	sb->flags = VFS_MOUNT_RDONLY;
+	sb->root_id = INITRD_ROOT_ID;
+	sb->s_op = &initrd_super_ops;
+	sb->private = archive;
+
+	return sb;
+}
+
+uint8_t initrd_read_inode(struct vfs_inode *inode) {
+	struct initrd_header *header = inode->sb->private;
+	struct initrd_entry *entry =
+		inode->sb->private + sizeof(struct initrd_header);
+
+	inode->datetime = (struct fs_datetime) {0};
+	inode->i_op = &initrd_inode_ops;
+	inode->f_op = &initrd_file_ops;
+
+	if (inode->id == INITRD_ROOT_ID) {
+		inode->type = FILETYPE_DIR;
+		inode->size = header->num_files * sizeof(struct initrd_entry);
+		inode->address = NULL;
+		return 0;
+	}
+
+	uint32_t index = inode->id - 2;
+
+	if (inode->id < 2 || index >= header->num_files) {
+		return 1;
+	}
+
+	// the file's data is used in place
+	inode->type = FILETYPE_FILE;
+	inode->size = entry[index].size;
+	inode->address = inode->sb->private + entry[index].offset;
+
+	return 0;
+}
+
+uint32_t initrd_lookup(struct vfs_inode *dir, const char *name, size_t len) {
+	struct initrd_header *header = dir->sb->private;
+	struct initrd_entry *entry = dir->sb->private + sizeof(struct initrd_header);
+
+	if (len >= INITRD_NAME_LENGTH) {
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < header->num_files; i++) {
+		if (strncmp(entry[i].name, name, len) == 0 &&
+			entry[i].name[len] == '\0') {
+			return i + 2;
+		}
+	}
+
+	return 0;
+}
+
+int32_t initrd_readdir(struct vfs_inode *dir, uint32_t index,
+					   struct vfs_dirent *dirent) {
+	struct initrd_header *header = dir->sb->private;
+	struct initrd_entry *entry = dir->sb->private + sizeof(struct initrd_header);
+
+	if (index >= header->num_files) {
+		return -1;
+	}
+
+	dirent->id = index + 2;
+	dirent->type = FILETYPE_FILE;
+	dirent->size = entry[index].size;
+	dirent->datetime = (struct fs_datetime) {0};
+	strcpy(dirent->name, entry[index].name);
+
+	return index + 1;
+}
+
+size_t initrd_read(struct vfs_inode *inode, void *buf, size_t count,
+				   uint32_t offset) {
+	if (offset >= inode->size || count == 0) {
+		return 0;
+	}
+
+	// do not read past the end of the file
+	if (count > inode->size - offset) {
+		count = inode->size - offset;
+	}
+
+	memcpy(buf, (void *) inode->address + offset, count);
+
+	return count;
+}
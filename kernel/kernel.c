@@ -2,16 +2,22 @@
 #include <arch/i386/idt.h>
 #include <arch/i386/pit.h>
 #include <arch/i386/ps2.h>
+#include <arch/i386/serial.h>
+#include <disk/prefetch.h>
 #include <kernel/acpi.h>
 #include <kernel/elf.h>
 #include <kernel/fs.h>
+#include <kernel/initrd.h>
 #include <kernel/keyboard.h>
 #include <kernel/shell.h>
 #include <kernel/string.h>
 #include <kernel/tty.h>
+#include <kernel/vfs.h>
 #include <mm/kmalloc.h>
+#include <mm/pagezero.h>
 #include <mm/pmm.h>
 #include <mm/vmm.h>
+#include <process/process.h>
 #include <process/scheduler.h>
 
 #include <stdint.h>
@@ -19,7 +25,6 @@
 extern char kernel_end[];
 
 // the system-wide table of open files
-struct open_files_table *open_files_table;
 
 void halt_processor(void) {
 	while (1) {
@@ -52,6 +57,7 @@ void kmain() {
 
 	keyboard_init(); // install keyboard irq handler
 	PIT_init();		 // initialize programmable interrupt timer
+	serial_init();	 // COM1, used to dump reports (no error if missing)
 
 	ret = initialize_memory(); // initialize physical memory manager
 
@@ -81,17 +87,30 @@ void kmain() {
 		halt_processor();
 	}
 
-	open_files_table = init_open_files_table();
+	ret = vfs_init(); // mount the file systems
 
-	if (open_files_table == NULL) {
-		printkc(4, "failed to init open files table!\n");
+	if (ret) {
+		printkc(4, "failed to init the virtual file system!\n");
 		halt_processor();
 	}
 
+	ret = initrd_init(); // load the initial RAM disk
+
+	if (ret) {
+		printkc(4, "failed to init the initrd!\n");
+	}
+
 	printk("Welcome to MyOS!\n\n");
 	printk("-- type help for available commands --\n\n");
 	shell_init(); // initialize the shell
 
+	ret = process_caches_init(); // create the object caches for the tasks
+
+	if (ret) {
+		printkc(4, "failed to create the task caches\n");
+		halt_processor();
+	}
+
 #ifdef CONFIG_FCFS_SCH
 	ret = scheduler_init();
 
@@ -110,6 +129,18 @@ void kmain() {
 		halt_processor();
 	}
 
+#ifdef CONFIG_BOOT_PREFETCH
+	ret = prefetch_init(); // replay and record the boot prefetch list
+
+	if (ret) {
+		printkc(4, "failed to start the boot prefetch!\n");
+	}
+#endif
+
+#ifdef CONFIG_PAGE_ZERO
+	pagezero_init(); // zero freed blocks while the CPU is idle
+#endif
+
 	// start first process
 	start_init_task();
 #endif
@@ -0,0 +1,231 @@
+#include <kernel/tty.h>
+#include <kernel/utils.h>
+#include <mm/buddy.h>
+
+#include <stddef.h>
+
+struct buddy_frame *buddy_frames; // metadata, one entry per frame
+uint32_t buddy_num_frames;
+uint32_t buddy_free_lists[BUDDY_MAX_ORDER + 1];
+uint32_t buddy_free_counts[BUDDY_MAX_ORDER + 1];
+uint32_t buddy_nonempty_orders; // bit k is set if the order k list has blocks
+struct buddy_stats buddy_stats;
+
+/**
+ * @brief Initialize the buddy allocator with empty free lists
+ *
+ * Free memory is added with buddy_free_range().
+ *
+ * @param frames		Memory for the metadata (num_frames entries)
+ * @param num_frames	Number of frames
+ */
+void buddy_init(struct buddy_frame *frames, uint32_t num_frames) {
+	buddy_frames = frames;
+	buddy_num_frames = num_frames;
+	buddy_nonempty_orders = 0;
+	buddy_stats = (struct buddy_stats) {0};
+
+	for (uint32_t i = 0; i < num_frames; i++) {
+		frames[i].free = 0;
+	}
+
+	for (int order = 0; order <= BUDDY_MAX_ORDER; order++) {
+		buddy_free_lists[order] = BUDDY_NONE;
+		buddy_free_counts[order] = 0;
+	}
+}
+
+/**
+ * @brief Move the metadata of the buddy allocator
+ *
+ * Called when the metadata is mapped at a new virtual address, its content
+ * is not changed.
+ *
+ * @param frames The new address of the metadata
+ */
+void buddy_relocate(struct buddy_frame *frames) {
+	buddy_frames = frames;
+}
+
+/**
+ * @brief Get the smallest order whose blocks have at least the given number
+ * of frames
+ *
+ * @param num_frames Number of frames (at least 1)
+ */
+uint8_t buddy_order(uint32_t num_frames) {
+	if (num_frames <= 1) {
+		return 0;
+	}
+
+	return bit_scan_reverse(num_frames - 1) + 1;
+}
+
+/**
+ * @brief Add a free block to the free list of its order
+ *
+ * @param frame The first frame of the block
+ * @param order The order of the block
+ */
+void buddy_list_add(uint32_t frame, uint8_t order) {
+	struct buddy_frame *entry = &buddy_frames[frame];
+
+	entry->next = buddy_free_lists[order];
+	entry->prev = BUDDY_NONE;
+	entry->order = order;
+	entry->free = 1;
+
+	if (entry->next != BUDDY_NONE) {
+		buddy_frames[entry->next].prev = frame;
+	}
+
+	buddy_free_lists[order] = frame;
+	buddy_free_counts[order]++;
+	buddy_nonempty_orders |= 1U << order;
+}
+
+/**
+ * @brief Remove a free block from the free list of its order
+ *
+ * @param frame The first frame of the block
+ */
+void buddy_list_remove(uint32_t frame) {
+	struct buddy_frame *entry = &buddy_frames[frame];
+	uint8_t order = entry->order;
+
+	if (entry->prev != BUDDY_NONE) {
+		buddy_frames[entry->prev].next = entry->next;
+	} else {
+		buddy_free_lists[order] = entry->next;
+	}
+
+	if (entry->next != BUDDY_NONE) {
+		buddy_frames[entry->next].prev = entry->prev;
+	}
+
+	entry->free = 0;
+	buddy_free_counts[order]--;
+
+	if (buddy_free_lists[order] == BUDDY_NONE) {
+		buddy_nonempty_orders &= ~(1U << order);
+	}
+}
+
+/**
+ * @brief Allocate a block of the given order
+ *
+ * The smallest free block that is big enough is found with bsf on the mask of
+ * non-empty lists, and split in two until it has the requested order (the
+ * second halves go back to the free lists).
+ *
+ * @param order The order of the block
+ *
+ * @return The first frame of the block, 0 if there is no free block big
+ * enough (frame 0 is always reserved)
+ */
+uint32_t buddy_alloc(uint8_t order) {
+	if (order > BUDDY_MAX_ORDER) {
+		return 0;
+	}
+
+	uint32_t orders = buddy_nonempty_orders & ~((1U << order) - 1);
+
+	if (orders == 0) {
+		return 0;
+	}
+
+	uint8_t current = bit_scan_forward(orders);
+	uint32_t frame = buddy_free_lists[current];
+
+	buddy_list_remove(frame);
+
+	while (current > order) {
+		current--;
+		buddy_list_add(frame + (1U << current), current);
+		buddy_stats.splits++;
+	}
+
+	buddy_stats.allocations++;
+
+	return frame;
+}
+
+/**
+ * @brief Free a block of the given order
+ *
+ * The block is merged with its buddy as long as the buddy is free and has the
+ * same order.
+ *
+ * @param frame The first frame of the block
+ * @param order The order of the block
+ */
+void buddy_free(uint32_t frame, uint8_t order) {
+	if (frame >= buddy_num_frames || buddy_frames[frame].free) {
+		return;
+	}
+
+	while (order < BUDDY_MAX_ORDER) {
+		uint32_t buddy = frame ^ (1U << order);
+
+		if (buddy >= buddy_num_frames || !buddy_frames[buddy].free ||
+			buddy_frames[buddy].order != order) {
+			break;
+		}
+
+		buddy_list_remove(buddy);
+		buddy_stats.merges++;
+
+		if (buddy < frame) {
+			frame = buddy;
+		}
+
+		order++;
+	}
+
+	buddy_list_add(frame, order);
+}
+
+/**
+ * @brief Free a range of frames
+ *
+ * The range is split into the biggest aligned blocks it contains, which are
+ * freed starting with the end of the range. The blocks at the beginning of the
+ * range are thus at the front of the free lists and low memory is allocated
+ * first.
+ *
+ * @param frame			The first frame
+ * @param num_frames	Number of frames
+ */
+void buddy_free_range(uint32_t frame, uint32_t num_frames) {
+	uint32_t end = frame + num_frames;
+
+	while (end > frame) {
+		uint8_t order = buddy_order(end - frame + 1) - 1;
+
+		// the block has to be aligned to its size
+		if (bit_scan_forward(end) < order) {
+			order = bit_scan_forward(end);
+		}
+
+		if (order > BUDDY_MAX_ORDER) {
+			order = BUDDY_MAX_ORDER;
+		}
+
+		end -= 1U << order;
+		buddy_free(end, order);
+	}
+}
+
+/**
+ * @brief Print the number of free blocks of every order
+ */
+void buddy_print_info(void) {
+	printk("free blocks per order:");
+
+	for (int order = 0; order <= BUDDY_MAX_ORDER; order++) {
+		printk(" %d", buddy_free_counts[order]);
+	}
+
+	printk("\nallocations: %d, splits: %d, merges: %d\n",
+		   buddy_stats.allocations, buddy_stats.splits, buddy_stats.merges);
+}
@@ -0,0 +1,194 @@
+#include <kernel/tty.h>
+#include <mm/frame.h>
+#include <mm/pmm.h>
+
+#include <stddef.h>
+
+struct page_frame *page_frames; // one entry per frame
+uint32_t page_frames_count;
+
+const char *frame_owner_names[FRAME_OWNER_COUNT] = {
+	"free", "reserved", "metadata", "kernel", "page tables", "kernel heap",
+	"user", "slabs"};
+
+/**
+ * @brief Initialize the page frame database
+ *
+ * All the frames are marked as reserved, the physical memory manager marks the
+ * free ones with frame_db_free().
+ *
+ * @param frames	Memory for the database (num_frames entries)
+ * @param num_frames Number of frames
+ */
+void frame_db_init(struct page_frame *frames, uint32_t num_frames) {
+	page_frames = frames;
+	page_frames_count = num_frames;
+
+	for (uint32_t i = 0; i < num_frames; i++) {
+		frames[i].refcount = 1;
+		frames[i].flags = 0;
+		frames[i].owner = FRAME_OWNER_RESERVED;
+	}
+}
+
+/**
+ * @brief Move the page frame database
+ *
+ * Called when the database is mapped at a new virtual address, its content
+ * is not changed.
+ *
+ * @param frames The new address of the database
+ */
+void frame_db_relocate(struct page_frame *frames) {
+	page_frames = frames;
+}
+
+/**
+ * @brief Record the allocation of a range of frames
+ *
+ * Every frame gets one reference, owned by the caller of allocate_blocks().
+ *
+ * @param frame			The first frame
+ * @param num_frames	Number of frames
+ */
+void frame_db_alloc(uint32_t frame, uint32_t num_frames) {
+	for (uint32_t i = frame; i < frame + num_frames && i < page_frames_count;
+		 i++) {
+		page_frames[i].refcount = 1;
+		page_frames[i].flags = 0;
+		page_frames[i].owner = FRAME_OWNER_KERNEL;
+	}
+}
+
+/**
+ * @brief Record that a range of frames is free
+ *
+ * @param frame			The first frame
+ * @param num_frames	Number of frames
+ */
+void frame_db_free(uint32_t frame, uint32_t num_frames) {
+	for (uint32_t i = frame; i < frame + num_frames && i < page_frames_count;
+		 i++) {
+		page_frames[i].refcount = 0;
+		page_frames[i].flags = 0;
+		page_frames[i].owner = FRAME_OWNER_FREE;
+	}
+}
+
+/**
+ * @brief Set the owner of a range of frames
+ *
+ * @param frame			The first frame
+ * @param num_frames	Number of frames
+ * @param owner			The owner type
+ */
+void frame_db_set_owner(uint32_t frame, uint32_t num_frames, uint8_t owner) {
+	for (uint32_t i = frame; i < frame + num_frames && i < page_frames_count;
+		 i++) {
+		page_frames[i].owner = owner;
+	}
+}
+
+/**
+ * @brief Get the database entry of the frame holding the physical address
+ *
+ * @param address The physical address
+ *
+ * @return The entry, NULL if the address is not in the managed memory (the
+ * framebuffer, for example)
+ */
+struct page_frame *frame_info(void *address) {
+	uint32_t frame = (uint32_t) address / BLOCK_SIZE;
+
+	if (page_frames == NULL || frame >= page_frames_count) {
+		return NULL;
+	}
+
+	return &page_frames[frame];
+}
+
+/**
+ * @brief Set the owner of the frame holding the physical address
+ *
+ * @param address	The physical address
+ * @param owner		The owner type
+ */
+void frame_set_owner(void *address, uint8_t owner) {
+	struct page_frame *frame = frame_info(address);
+
+	if (frame != NULL) {
+		frame->owner = owner;
+	}
+}
+
+/**
+ * @brief Take one more reference to an allocated frame
+ *
+ * @param address The physical address
+ *
+ * @return 1 if error occured (frame not allocated or too many references), 0
+ * otherwise
+ */
+uint8_t frame_get(void *address) {
+	struct page_frame *frame = frame_info(address);
+
+	if (frame == NULL || frame->refcount == 0 ||
+		frame->refcount == FRAME_MAX_REFCOUNT) {
+		return 1;
+	}
+
+	frame->refcount++;
+
+	return 0;
+}
+
+/**
+ * @brief Drop a reference to an allocated frame
+ *
+ * The frame itself is not freed, the caller frees it when no references are
+ * left.
+ *
+ * @param address The physical address
+ *
+ * @return Number of references left
+ */
+uint16_t frame_put(void *address) {
+	struct page_frame *frame = frame_info(address);
+
+	if (frame == NULL || frame->refcount == 0) {
+		return 0;
+	}
+
+	return --frame->refcount;
+}
+
+/**
+ * @brief Print the number of frames of every owner type
+ */
+void frame_db_print_info(void) {
+	uint32_t counts[FRAME_OWNER_COUNT] = {0};
+	uint32_t shared = 0;
+
+	if (page_frames == NULL) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < page_frames_count; i++) {
+		if (page_frames[i].owner < FRAME_OWNER_COUNT) {
+			counts[page_frames[i].owner]++;
+		}
+
+		if (page_frames[i].owner != FRAME_OWNER_RESERVED &&
+			page_frames[i].refcount > 1) {
+			shared++;
+		}
+	}
+
+	printk("blocks by owner:\n");
+
+	for (int owner = 0; owner < FRAME_OWNER_COUNT; owner++) {
+		printk("\t%s: %d\n", frame_owner_names[owner], counts[owner]);
+	}
+
+	printk("\tshared: %d\n", shared);
+}
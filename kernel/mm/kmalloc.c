@@ -1,12 +1,28 @@
 #include <kernel/global_addresses.h>
 #include <kernel/string.h>
 #include <kernel/tty.h>
+#include <kernel/utils.h>
+#include <mm/frame.h>
 #include <mm/kmalloc.h>
 #include <mm/pmm.h>
 #include <mm/vmm.h>
 
 extern char kernel_end[]; // symbol from the kernel linker script
 struct kblock_meta *metadata_blk_header;
+struct kblock_meta *last_blk; // last block in memory
+struct kblock_meta *free_lists[KMALLOC_CLASSES];
+uint32_t free_classes; // bit k is set if the free list of class k is not empty
+uint32_t free_bytes;   // total size of the free blocks
+uint32_t released_pages; // pages of free blocks given back to the PMM
+
+#ifdef CONFIG_KHEAP_PROFILE
+struct kmalloc_site kmalloc_sites[KMALLOC_PROFILE_SITES + 1]; // + the others
+uint32_t kmalloc_histogram[KMALLOC_CLASSES]; // allocations per size class
+uint32_t kmalloc_live_histogram[KMALLOC_CLASSES];
+uint32_t kmalloc_live_bytes;
+uint32_t kmalloc_live_blocks;
+uint32_t kmalloc_peak_bytes; // high-water mark of the allocated bytes
+#endif
 
 // starting virtual address will be the starting virtual address of the kernel
 // (which is 0xC0000000) plus the total size of the kernel, rounded up to the
@@ -52,6 +68,7 @@ uint8_t kmalloc_init(size_t size) {
 		// printk("physical address: %x ", starting_phys_addr);
 		// printk("will be mapped to virtual address: %x\n", virt);
 
+		frame_set_owner((void *) starting_phys_addr, FRAME_OWNER_KHEAP);
 		map_page((void *) (starting_phys_addr), (void *) virt);
 
 		pt_entry *page = get_page(virt);
@@ -67,8 +84,12 @@ uint8_t kmalloc_init(size_t size) {
 
 	metadata_blk_header->size = (req_pages * PAGE_SIZE) - METADATA_BLK_SIZE;
 	metadata_blk_header->status = STATUS_FREE;
+	metadata_blk_header->magic = KMALLOC_MAGIC;
 	metadata_blk_header->next = NULL;
 	metadata_blk_header->prev = NULL;
+	last_blk = metadata_blk_header;
+
+	kmalloc_free_list_add(metadata_blk_header);
 
 	// printk("initial metadata block:\n");
 	// printk("\tsize: %d\n", metadata_blk_header->size);
@@ -94,59 +115,248 @@ void kmalloc_print_list(void) {
 }
 
 /**
- * @brief Find best block that fits the requested size
+ * @brief Get the size class of a free block
  *
- * This function goes through the list and searches for the block with the
- * smallest available size that fits the requested size.
+ * @param size The size of the block
+ *
+ * @return The class k with 2^k <= size < 2^(k+1) (the large class for all
+ * the bigger blocks)
+ */
+uint32_t kmalloc_size_class(uint32_t size) {
+	uint32_t class = bit_scan_reverse(size);
+
+	return class > KMALLOC_LARGE_CLASS ? KMALLOC_LARGE_CLASS : class;
+}
+
+/**
+ * @brief Add a free block to the free list of its size class
+ *
+ * @param block The block
+ */
+void kmalloc_free_list_add(struct kblock_meta *block) {
+	uint32_t class = kmalloc_size_class(block->size);
+
+	block->prev_free = NULL;
+	block->next_free = free_lists[class];
+
+	if (block->next_free != NULL) {
+		block->next_free->prev_free = block;
+	}
+
+	free_lists[class] = block;
+	free_classes |= 1U << class;
+	free_bytes += block->size;
+}
+
+/**
+ * @brief Remove a free block from the free list of its size class
+ *
+ * @param block The block
+ */
+void kmalloc_free_list_remove(struct kblock_meta *block) {
+	uint32_t class = kmalloc_size_class(block->size);
+
+	if (block->prev_free != NULL) {
+		block->prev_free->next_free = block->next_free;
+	} else {
+		free_lists[class] = block->next_free;
+	}
+
+	if (block->next_free != NULL) {
+		block->next_free->prev_free = block->prev_free;
+	}
+
+	if (free_lists[class] == NULL) {
+		free_classes &= ~(1U << class);
+	}
+
+	free_bytes -= block->size;
+}
+
+/**
+ * @brief Map the released pages of a heap range again
+ *
+ * @param start First address of the range
+ * @param end	End of the range (not included)
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t kmalloc_map_range(uint32_t start, uint32_t end) {
+	if (released_pages == 0) {
+		return 0;
+	}
+
+	for (uint32_t virt = start & ~(PAGE_SIZE - 1); virt < end;
+		 virt += PAGE_SIZE) {
+		pt_entry *page = get_page(virt);
+
+		if (TEST_ATTRIBUTE(page, PAGE_PTE_PRESENT)) {
+			continue;
+		}
+
+		void *block = allocate_blocks(1);
+
+		if (block == NULL) {
+			printk("out of memory!\n");
+			return 1;
+		}
+
+		frame_set_owner(block, FRAME_OWNER_KHEAP);
+		map_page(block, (void *) virt);
+		SET_ATTRIBUTE(page, PAGE_PTE_WRITABLE);
+		released_pages--;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Give the whole pages of a free block back to the physical memory
+ * manager
+ *
+ * The page with the block header stays mapped. The virtual range is kept by
+ * the block and mapped again by kmalloc_map_range() when it is allocated.
+ *
+ * @param block The free block
+ */
+void kmalloc_release_block(struct kblock_meta *block) {
+	uint32_t start = ALIGN((uint32_t) block + METADATA_BLK_SIZE, PAGE_SIZE);
+	uint32_t end = ((uint32_t) block + METADATA_BLK_SIZE + block->size) &
+				   ~(PAGE_SIZE - 1);
+
+	for (uint32_t virt = start; virt < end; virt += PAGE_SIZE) {
+		pt_entry *page = get_page(virt);
+
+		if (!TEST_ATTRIBUTE(page, PAGE_PTE_PRESENT)) {
+			continue;
+		}
+
+		void *phys = (void *) PAGE_GET_PHY_ADDRESS(page);
+
+		unmap_page((void *) virt);
+		flush_tlb_entry(virt);
+		free_blocks(phys, 1);
+		released_pages++;
+	}
+}
+
+/**
+ * @brief Find a free block that fits the requested size
+ *
+ * Small requests take the first block of the first non-empty class whose
+ * blocks are all big enough (or the first block of the class below, if it
+ * fits). Large requests search the blocks of the large
+ * classes for the best fit. The block is removed from its free list.
  *
  * @param size The requested size
  *
  * @return The block address if one is found, NULL otherwise
  */
-void *kmalloc_find_best_fit(uint32_t size) {
-	struct kblock_meta *current = metadata_blk_header;
-	struct kblock_meta *best_fit = NULL;
+void *kmalloc_find_free(uint32_t size) {
+	// smallest class whose blocks all have at least size bytes
+	uint32_t class = size <= 1 ? 0 : bit_scan_reverse(size - 1) + 1;
+	struct kblock_meta *block = NULL;
 
-	uint32_t min = 0xFFFFFFFF;
+	if (class < KMALLOC_LARGE_CLASS) {
+		uint32_t classes = free_classes & ~((1U << class) - 1);
 
-	while (current != NULL) {
-		if (current->status == STATUS_FREE && current->size >= size) {
-			if (current->size < min) {
-				min = current->size;
-				best_fit = current;
+		// the first block of the class below may be big enough as well
+		block = class > 0 ? free_lists[class - 1] : NULL;
+
+		if (block == NULL || block->size < size) {
+			if (classes == 0) {
+				return NULL;
 			}
+
+			block = free_lists[bit_scan_forward(classes)];
 		}
+	} else {
+		// large object: best fit among the blocks that may be big enough
+		uint32_t min = 0xFFFFFFFF;
+
+		for (class = kmalloc_size_class(size); class < KMALLOC_CLASSES;
+			 class++) {
+			struct kblock_meta *current = free_lists[class];
+
+			while (current != NULL) {
+				if (current->size >= size && current->size < min) {
+					min = current->size;
+					block = current;
+				}
 
-		current = (struct kblock_meta *) current->next;
+				current = current->next_free;
+			}
+
+			// the blocks of the next classes are bigger
+			if (block != NULL && class < KMALLOC_LARGE_CLASS) {
+				break;
+			}
+		}
+
+		if (block == NULL) {
+			return NULL;
+		}
 	}
 
-	return best_fit;
+	kmalloc_free_list_remove(block);
+
+	return block;
 }
 
 /**
  * @brief Split the given block in two according to the given size
  *
- * This function splits the given block in a block that is allocated and has the
- * given size and a free block that has the remaining size from the initial
- * block.
+ * This function splits the given block in a block that has the given size and
+ * a free block that has the remaining size from the initial block (added to
+ * the free lists). The block is not split if the remaining size is too small.
+ * The released pages the allocated block (and the header of the new free block)
+ * use are mapped first.
  *
- * @param block Pointer to the block that is to be split
+ * @param block Pointer to the block that is to be split (not in a free list)
  * @param size  The size that the allocated block has to have
  *
- * @return The address of the block that is allocated (same as the parameter)
+ * @return The address of the block that is allocated (same as the parameter),
+ * NULL if the pages could not be mapped (the block is put back in the free
+ * lists)
  */
 void *kmalloc_split_block(struct kblock_meta *block, uint32_t size) {
+	// split block if there is place for at least 8 bytes + sizeof metadata
+	// block
+	uint8_t split = block->size - ALIGN(size, ALIGNMENT) >=
+					METADATA_BLK_SIZE + ALIGN(1, ALIGNMENT);
+	uint32_t end = split ? (uint32_t) block + 2 * METADATA_BLK_SIZE +
+							   ALIGN(size, ALIGNMENT)
+						 : (uint32_t) block + METADATA_BLK_SIZE + block->size;
+
+	if (kmalloc_map_range((uint32_t) block, end)) {
+		kmalloc_free_list_add(block);
+		return NULL;
+	}
+
+	if (!split) {
+		return block;
+	}
+
 	struct kblock_meta *new_block =
 		(void *) block + METADATA_BLK_SIZE + ALIGN(size, ALIGNMENT);
 
 	new_block->size = block->size - ALIGN(size, ALIGNMENT) - METADATA_BLK_SIZE;
 	new_block->status = STATUS_FREE;
+	new_block->magic = KMALLOC_MAGIC;
 	new_block->next = block->next;
 	new_block->prev = (struct kblock_meta *) block;
 
+	if (new_block->next != NULL) {
+		new_block->next->prev = new_block;
+	} else {
+		last_blk = new_block;
+	}
+
 	block->size = block->size - new_block->size - METADATA_BLK_SIZE;
 	block->next = (struct kblock_meta *) new_block;
 
+	kmalloc_free_list_add(new_block);
+
 	return block;
 }
 
@@ -166,15 +376,19 @@ void *kmalloc_split_block(struct kblock_meta *block, uint32_t size) {
  * @return Pointer to the node in the list that accommodated the requested size
  */
 void *kmalloc_expand_memory(uint32_t size) {
-	struct kblock_meta *current = metadata_blk_header;
-
-	while (current != NULL && current->next != NULL) {
-		current = (struct kblock_meta *) current->next;
-	}
+	struct kblock_meta *current = last_blk;
 
-	uint32_t needed_size = size;
+	uint32_t needed_size = ALIGN(size, ALIGNMENT);
 	if (current->status == STATUS_FREE) {
+		// the block may be in a class that is not searched for this size
+		if (current->size >= needed_size) {
+			kmalloc_free_list_remove(current);
+			return kmalloc_split_block(current, size);
+		}
+
 		needed_size -= current->size;
+	} else {
+		needed_size += METADATA_BLK_SIZE;
 	}
 
 	// get necessary number of pages
@@ -184,6 +398,12 @@ void *kmalloc_expand_memory(uint32_t size) {
 		req_pages++;
 	}
 
+	// the heap only has the page tables created at boot
+	if (req_pages > (KERNEL_HEAP_END - current_virtual_address) / PAGE_SIZE) {
+		printk("kernel heap is full!\n");
+		return NULL;
+	}
+
 	uint32_t local_starting_virtual_address = current_virtual_address;
 
 	// map physical to virtual pages and make page writeable
@@ -200,6 +420,7 @@ void *kmalloc_expand_memory(uint32_t size) {
 		// printk("physical address: %x ", starting_phys_addr);
 		// printk("will be mapped to virtual address: %x\n", virt);
 
+		frame_set_owner((void *) starting_phys_addr, FRAME_OWNER_KHEAP);
 		map_page((void *) (starting_phys_addr), (void *) virt);
 
 		pt_entry *page = get_page(virt);
@@ -211,15 +432,10 @@ void *kmalloc_expand_memory(uint32_t size) {
 
 	// if last block is free
 	if (current->status == STATUS_FREE) {
+		kmalloc_free_list_remove(current);
 		current->size += (req_pages * PAGE_SIZE);
 
-		// split block if possible
-		if (current->size - ALIGN(size, ALIGNMENT) >=
-			METADATA_BLK_SIZE + ALIGN(1, ALIGNMENT)) {
-			return kmalloc_split_block(current, size);
-		}
-
-		return current;
+		return kmalloc_split_block(current, size);
 	}
 
 	// if last block is not free
@@ -228,26 +444,22 @@ void *kmalloc_expand_memory(uint32_t size) {
 		(struct kblock_meta *) (local_starting_virtual_address);
 	new_block->size = (req_pages * PAGE_SIZE) - METADATA_BLK_SIZE;
 	new_block->status = STATUS_FREE;
+	new_block->magic = KMALLOC_MAGIC;
 	new_block->next = NULL;
 	new_block->prev = (struct kblock_meta *) current;
 
 	current->next = (struct kblock_meta *) new_block;
+	last_blk = new_block;
 
-	if (new_block->size - ALIGN(size, ALIGNMENT) >=
-		METADATA_BLK_SIZE + ALIGN(1, ALIGNMENT)) {
-		return kmalloc_split_block(new_block, size);
-	}
-
-	return new_block;
+	return kmalloc_split_block(new_block, size);
 }
 
 /**
  * @brief Allocate dynamic memory (called by the kernel)
  *
  * This function initializes the memory metadata structure if necessary and
- * searches for the best fit for the requested size. If a best fit is found,
- * then the block is split if possible. If one is not found, then the memory is
- * expanded.
+ * takes a free block from the size class lists. The block is split if
+ * possible. If none is found, then the memory is expanded.
  *
  * @param size The requested size in bytes
  *
@@ -258,6 +470,10 @@ void *kmalloc(size_t size) {
 		return NULL;
 	}
 
+#ifdef CONFIG_KHEAP_PROFILE
+	uint32_t caller = (uint32_t) __builtin_return_address(0);
+#endif
+
 	int ret;
 
 	// initialize metadata if necessary
@@ -268,45 +484,37 @@ void *kmalloc(size_t size) {
 		}
 	}
 
-	// find best fit
-	struct kblock_meta *best_fit =
-		(struct kblock_meta *) kmalloc_find_best_fit(size);
-
-	if (best_fit != NULL) {
-		// split block if there is place for at least 8 bytes + sizeof metadata
-		// block
-		if (best_fit->size - ALIGN(size, ALIGNMENT) >=
-			METADATA_BLK_SIZE + ALIGN(1, ALIGNMENT)) {
-			struct kblock_meta *split_block =
-				kmalloc_split_block(best_fit, size);
-
-			split_block->status = STATUS_ALLOC;
-
-			return (void *) split_block + METADATA_BLK_SIZE;
-		}
+	struct kblock_meta *block = kmalloc_find_free(size);
 
-		best_fit->status = STATUS_ALLOC;
-		return (void *) best_fit + METADATA_BLK_SIZE;
+	if (block != NULL) {
+		block = kmalloc_split_block(block, size);
+	} else {
+		// expand memory
+		block = kmalloc_expand_memory(size);
 	}
 
-	// expand memory
-	struct kblock_meta *block = kmalloc_expand_memory(size);
-
 	if (block == NULL) {
 		return NULL;
 	}
 
 	block->status = STATUS_ALLOC;
 
+#ifdef CONFIG_KHEAP_PROFILE
+	kmalloc_profile_alloc(block, size, caller);
+#endif
+
 	return (void *) block + METADATA_BLK_SIZE;
 }
 
 /**
  * @brief Free dynamic memory (called by the kernel)
  *
- * This function goes through the list and searches for the given virtual
- * address. If it is found, the status of the block is changed to STATUS_FREE
- * and the block is coalesced with its predecessor and successor (if possible)
+ * This function gets the block's metadata, which is right before the given
+ * virtual address. The status of the block is changed to STATUS_FREE, the
+ * block is coalesced with its predecessor and successor (if possible) and the
+ * result is added to the free list of its size class. If more than
+ * KMALLOC_RELEASE_WATERMARK free bytes are mapped, the whole pages of the
+ * block are given back to the physical memory manager.
  *
  * @param ptr   Virtual address
  */
@@ -315,68 +523,242 @@ void kfree(void *ptr) {
 		return;
 	}
 
-	struct kblock_meta *current = metadata_blk_header;
+	struct kblock_meta *current = ptr - METADATA_BLK_SIZE;
 
-	while (current != NULL) {
-		if ((void *) current + METADATA_BLK_SIZE == ptr) {
-			current->status = STATUS_FREE;
+	if ((uint32_t) current < starting_virtual_address ||
+		(uint32_t) ptr >= current_virtual_address ||
+		current->magic != KMALLOC_MAGIC || current->status != STATUS_ALLOC) {
+		printk("kfree: invalid pointer %x\n", ptr);
+		return;
+	}
+
+#ifdef CONFIG_KHEAP_PROFILE
+	kmalloc_profile_free(current);
+#endif
+
+	current->status = STATUS_FREE;
 
 #ifdef CONFIG_READ_AFTER_FREE_PROT
-			// fill memory with zeros
-			memset((void *) current + METADATA_BLK_SIZE, 0, current->size);
+	// fill memory with zeros
+	memset((void *) current + METADATA_BLK_SIZE, 0, current->size);
 #endif
 
-			// coalesce if possible
-			if (current->prev != NULL && current->prev->status == STATUS_FREE &&
-				current->next != NULL && current->next->status == STATUS_FREE) {
-				current->prev->size +=
-					current->size + current->next->size + 2 * METADATA_BLK_SIZE;
-				current->prev->next = current->next->next;
+	// coalesce with the next block
+	struct kblock_meta *next = current->next;
 
-				if (current->next->next != NULL) {
-					current->next->next->prev = current->prev;
-				}
+	if (next != NULL && next->status == STATUS_FREE) {
+		kmalloc_free_list_remove(next);
 
-				return;
-			}
+		current->size += next->size + METADATA_BLK_SIZE;
+		current->next = next->next;
 
-			if (current->prev != NULL && current->prev->status == STATUS_FREE) {
-				current->prev->size += current->size + METADATA_BLK_SIZE;
-				current->prev->next = current->next;
+		if (next->next != NULL) {
+			next->next->prev = current;
+		} else {
+			last_blk = current;
+		}
+	}
 
-				if (current->next != NULL) {
-					current->next->prev = current->prev;
-				}
+	// coalesce with the previous block
+	struct kblock_meta *prev = current->prev;
 
-				return;
-			}
+	if (prev != NULL && prev->status == STATUS_FREE) {
+		kmalloc_free_list_remove(prev);
 
-			if (current->next != NULL && current->next->status == STATUS_FREE) {
-				current->size += current->next->size + METADATA_BLK_SIZE;
+		prev->size += current->size + METADATA_BLK_SIZE;
+		prev->next = current->next;
 
-				if (current->next->next != NULL) {
-					current->next->next->prev = current;
-				}
-				current->next = current->next->next;
+		if (current->next != NULL) {
+			current->next->prev = prev;
+		} else {
+			last_blk = prev;
+		}
+
+		current = prev;
+	}
+
+	kmalloc_free_list_add(current);
+
+	// give the idle pages back once too many free bytes are kept mapped
+	if (free_bytes - released_pages * PAGE_SIZE > KMALLOC_RELEASE_WATERMARK) {
+		kmalloc_release_block(current);
+	}
+}
+
+#ifdef CONFIG_KHEAP_PROFILE
+/**
+ * @brief Account an allocation to its site
+ *
+ * @param block		The allocated block
+ * @param size		The requested size
+ * @param address	Return address of the kmalloc() call
+ */
+void kmalloc_profile_alloc(struct kblock_meta *block, uint32_t size,
+						   uint32_t address) {
+	uint32_t index = (address >> 2) & (KMALLOC_PROFILE_SITES - 1);
+	uint32_t i;
+
+	// open addressing with linear probing
+	for (i = 0; i < KMALLOC_PROFILE_SITES; i++) {
+		if (kmalloc_sites[index].address == address ||
+			kmalloc_sites[index].address == 0) {
+			break;
+		}
+
+		index = (index + 1) & (KMALLOC_PROFILE_SITES - 1);
+	}
+
+	// the table is full, count the site with the others
+	if (i == KMALLOC_PROFILE_SITES) {
+		index = KMALLOC_PROFILE_SITES;
+	} else {
+		kmalloc_sites[index].address = address;
+	}
+
+	struct kmalloc_site *site = &kmalloc_sites[index];
+
+	site->live_bytes += block->size;
+	site->live_blocks++;
+	site->allocations++;
+	block->site = index;
+
+	kmalloc_histogram[kmalloc_size_class(size)]++;
+	kmalloc_live_histogram[kmalloc_size_class(block->size)]++;
+	kmalloc_live_bytes += block->size;
+	kmalloc_live_blocks++;
 
-				return;
+	if (kmalloc_live_bytes > kmalloc_peak_bytes) {
+		kmalloc_peak_bytes = kmalloc_live_bytes;
+	}
+}
+
+/**
+ * @brief Remove a block that is freed from the counters of its site
+ *
+ * @param block The block (still allocated)
+ */
+void kmalloc_profile_free(struct kblock_meta *block) {
+	struct kmalloc_site *site = &kmalloc_sites[block->site];
+
+	site->live_bytes -= block->size;
+	site->live_blocks--;
+
+	kmalloc_live_histogram[kmalloc_size_class(block->size)]--;
+	kmalloc_live_bytes -= block->size;
+	kmalloc_live_blocks--;
+}
+
+/**
+ * @brief Print the size histogram and the sites with the most live bytes
+ */
+void kmalloc_print_profile(void) {
+	uint32_t shown[(KMALLOC_PROFILE_SITES + 32) / 32] = {0};
+
+	printk("allocated: %d bytes in %d blocks, high-water mark: %d bytes\n",
+		   kmalloc_live_bytes, kmalloc_live_blocks, kmalloc_peak_bytes);
+	printk("size\tallocations\tlive\n");
+
+	for (uint32_t class = 0; class < KMALLOC_CLASSES; class++) {
+		if (kmalloc_histogram[class] == 0 &&
+			kmalloc_live_histogram[class] == 0) {
+			continue;
+		}
+
+		if (class == KMALLOC_LARGE_CLASS) {
+			printk("%d+", 1 << class);
+		} else {
+			printk("%d-%d", 1 << class, (1 << (class + 1)) - 1);
+		}
+
+		printk("\t%d\t\t%d\n", kmalloc_histogram[class],
+			   kmalloc_live_histogram[class]);
+	}
+
+	printk("site\tlive bytes\tlive blocks\tallocations\n");
+
+	// selection of the sites with the most live bytes
+	for (uint32_t n = 0; n < KMALLOC_PROFILE_TOP; n++) {
+		struct kmalloc_site *top = NULL;
+		uint32_t top_index = 0;
+
+		for (uint32_t i = 0; i <= KMALLOC_PROFILE_SITES; i++) {
+			struct kmalloc_site *site = &kmalloc_sites[i];
+
+			if (site->live_bytes == 0 || shown[i / 32] & (1U << (i % 32))) {
+				continue;
+			}
+
+			if (top == NULL || site->live_bytes > top->live_bytes) {
+				top = site;
+				top_index = i;
 			}
+		}
 
-			return;
+		if (top == NULL) {
+			break;
 		}
 
-		current = (struct kblock_meta *) current->next;
+		shown[top_index / 32] |= 1U << (top_index % 32);
+
+		if (top_index == KMALLOC_PROFILE_SITES) {
+			printk("others");
+		} else {
+			printk("%x", top->address);
+		}
+
+		printk("\t%d\t\t%d\t\t%d\n", top->live_bytes, top->live_blocks,
+			   top->allocations);
+	}
+}
+#endif /* CONFIG_KHEAP_PROFILE */
+
+/**
+ * @brief Print the kernel heap statistics
+ *
+ * The fragmentation index compares the largest free block with the total free
+ * memory: 0 if all the free memory is in one block, close to 100 if it is
+ * scattered in small blocks. With CONFIG_KHEAP_PROFILE, the size histogram,
+ * the high-water mark and the allocation sites are also printed.
+ */
+void kmalloc_print_stats(void) {
+	uint32_t largest = 0;
+	uint32_t fragmentation = 0;
+
+	if (metadata_blk_header == NULL) {
+		printk("kernel heap not initialized\n");
+		return;
+	}
+
+	// the largest free block is in the last non-empty class
+	if (free_classes != 0) {
+		struct kblock_meta *block =
+			free_lists[bit_scan_reverse(free_classes)];
+
+		for (; block != NULL; block = block->next_free) {
+			if (block->size > largest) {
+				largest = block->size;
+			}
+		}
+	}
+
+	if (free_bytes > 0) {
+		// avoid the overflow of largest * 100 for big heaps
+		uint32_t shift = free_bytes > 0x1000000 ? 8 : 0;
+
+		fragmentation = 100 - (largest >> shift) * 100 / (free_bytes >> shift);
 	}
 
-	/*
-	 * TODO: also free physical memory when possible: detect if an entire block
-	 * of memory is free (meaning that there is a node in the list that has
-	 * STATUS_FREE and its size is PAGE_SIZE - METADATA_BLK_SIZE. I think this
-	 * is only possible for the last node (as memory has to be contiguous). Get
-	 * physical address from virtual address: page_table_entry =
-	 * get_page(virtual_address) physical_address = page_table_entry &
-	 * 0x7FFFF000
-	 *
-	 * Make sure also to modify current_virtual_address.
-	 */
+	printk("heap: %x - %x (%d KB)\n", starting_virtual_address,
+		   current_virtual_address,
+		   (current_virtual_address - starting_virtual_address) / 1024);
+	printk("free: %d bytes (%d pages released), largest free block: %d "
+		   "bytes\n",
+		   free_bytes, released_pages, largest);
+	printk("fragmentation index: %d\n", fragmentation);
+
+#ifdef CONFIG_KHEAP_PROFILE
+	kmalloc_print_profile();
+#else
+	printk("enable CONFIG_KHEAP_PROFILE to track the allocation sites\n");
+#endif
 }
@@ -0,0 +1,122 @@
+#ifdef CONFIG_PAGE_ZERO
+
+#include <kernel/string.h>
+#include <kernel/tty.h>
+#include <mm/frame.h>
+#include <mm/pagezero.h>
+#include <mm/pmm.h>
+#include <mm/vmm.h>
+
+#include <stddef.h>
+
+uint32_t pagezero_pool[PAGEZERO_POOL_SIZE];	 // physical addresses
+uint32_t pagezero_pool_count;
+uint32_t pagezero_dirty[PAGEZERO_POOL_SIZE]; // freed, not zeroed yet
+uint32_t pagezero_dirty_count;
+uint8_t pagezero_enabled; // the pools are not used during the PMM self-test
+struct pagezero_stats pagezero_stats;
+
+/**
+ * @brief Start keeping the freed blocks for the pool
+ *
+ * Has to be called after the physical memory manager is initialized.
+ */
+void pagezero_init(void) {
+	pagezero_pool_count = 0;
+	pagezero_dirty_count = 0;
+	pagezero_stats = (struct pagezero_stats) {0};
+	pagezero_enabled = 1;
+}
+
+/**
+ * @brief Keep a freed block, to be zeroed when the CPU is idle
+ *
+ * The block stays allocated (with one reference) while it is kept.
+ *
+ * @param block The physical address of the block
+ *
+ * @return 1 if the block is not kept (the pools are full), 0 otherwise
+ */
+uint8_t pagezero_put(void *block) {
+	if (!pagezero_enabled ||
+		pagezero_pool_count + pagezero_dirty_count >= PAGEZERO_POOL_SIZE) {
+		return 1;
+	}
+
+	frame_db_alloc((uint32_t) block / BLOCK_SIZE, 1);
+	pagezero_dirty[pagezero_dirty_count++] = (uint32_t) block;
+
+	return 0;
+}
+
+/**
+ * @brief Take a zeroed block from the pool
+ *
+ * Called with interrupts disabled (syscalls, boot), so the init task cannot
+ * change the pool at the same time.
+ *
+ * @return The physical address of the block, NULL if the pool is empty
+ */
+void *pagezero_get(void) {
+	if (pagezero_pool_count == 0) {
+		pagezero_stats.misses++;
+		return NULL;
+	}
+
+	pagezero_stats.hits++;
+
+	return (void *) pagezero_pool[--pagezero_pool_count];
+}
+
+/**
+ * @brief Give all the kept blocks back to the buddy allocator
+ *
+ * Called when the buddy allocator is out of memory.
+ *
+ * @return Number of blocks given back
+ */
+uint32_t pagezero_reclaim(void) {
+	uint32_t count = pagezero_pool_count + pagezero_dirty_count;
+
+	while (pagezero_pool_count > 0) {
+		__free_range(pagezero_pool[--pagezero_pool_count] / BLOCK_SIZE, 1);
+	}
+
+	while (pagezero_dirty_count > 0) {
+		__free_range(pagezero_dirty[--pagezero_dirty_count] / BLOCK_SIZE, 1);
+	}
+
+	return count;
+}
+
+/**
+ * @brief Zero a few of the freed blocks and add them to the pool
+ *
+ * Called by the init task when no other task is ready to run, with interrupts
+ * disabled. A block is taken from the freed ones and added to the pool with
+ * interrupts disabled; it is zeroed with interrupts enabled, as nobody else
+ * uses it in between (the temporary mapping slot is only used here).
+ */
+void pagezero_idle(void) {
+	for (int i = 0; i < PAGEZERO_BATCH && pagezero_dirty_count > 0; i++) {
+		uint32_t block = pagezero_dirty[--pagezero_dirty_count];
+		void *page = map_temporary((void *) block, TEMP_MAP_PAGEZERO);
+
+		__asm__ __volatile__("sti");
+		memset(page, 0, BLOCK_SIZE);
+		__asm__ __volatile__("cli");
+
+		pagezero_pool[pagezero_pool_count++] = block;
+		pagezero_stats.zeroed++;
+	}
+}
+
+void pagezero_print_info(void) {
+	printk("zeroed blocks: %d/%d ready, %d waiting\n", pagezero_pool_count,
+		   PAGEZERO_POOL_SIZE, pagezero_dirty_count);
+	printk("\thits: %d\n", pagezero_stats.hits);
+	printk("\tmisses: %d\n", pagezero_stats.misses);
+	printk("\tzeroed: %d\n", pagezero_stats.zeroed);
+}
+
+#endif /* CONFIG_PAGE_ZERO */
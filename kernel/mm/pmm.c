@@ -1,7 +1,12 @@
 /* Physical memory manager */
 #include <kernel/string.h>
 #include <kernel/tty.h>
+#include <kernel/utils.h>
+#include <mm/buddy.h>
+#include <mm/frame.h>
+#include <mm/pagezero.h>
 #include <mm/pmm.h>
+#include <mm/vmm.h>
 
 #include <stddef.h>
 
@@ -9,6 +14,11 @@ static uint32_t *bitmap;
 static uint32_t bitmap_size;
 static uint32_t max_blocks;
 static uint32_t used_blocks;
+static uint32_t bitmap_words;
+static uint32_t first_free_word; // all the words before it are full
+static uint32_t metadata_address; // physical address of the block metadata
+static uint32_t metadata_size;
+static uint32_t frames_size; // page frame database, at the start of the metadata
 
 // atomic_flag pmm_lock = ATOMIC_FLAG_INIT;
 
@@ -99,6 +109,47 @@ uint8_t __get_bit(uint32_t block_index) {
 	return (bitmap[indices_chunk] & (1 << index_offset)) != 0;
 }
 
+/**
+ * @brief Mark a range of blocks as free or reserved
+ *
+ * The bitmap is updated one 32-bit word at a time. Blocks past the end of the
+ * memory are ignored, and only blocks that change their state are counted.
+ *
+ * @param block_index	The index of the first block
+ * @param num_blocks	Number of blocks
+ * @param reserved		1 to mark the blocks as reserved, 0 to mark them as
+ * 						free
+ */
+void __mark_range(uint32_t block_index, uint32_t num_blocks, uint8_t reserved) {
+	uint32_t end = block_index + num_blocks;
+
+	if (end > max_blocks || end < block_index) {
+		end = max_blocks;
+	}
+
+	while (block_index < end) {
+		uint32_t word = block_index / 32;
+		uint32_t offset = block_index % 32;
+		uint32_t count = 32 - offset < end - block_index ? 32 - offset
+														 : end - block_index;
+		uint32_t mask = count == 32 ? 0xFFFFFFFF : ((1U << count) - 1) << offset;
+
+		if (reserved) {
+			used_blocks += count - bit_count(bitmap[word] & mask);
+			bitmap[word] |= mask;
+		} else {
+			used_blocks -= bit_count(bitmap[word] & mask);
+			bitmap[word] &= ~mask;
+
+			if (word < first_free_word) {
+				first_free_word = word;
+			}
+		}
+
+		block_index += count;
+	}
+}
+
 /**
  * @brief Mark region described by base address and size as free
  *
@@ -109,14 +160,7 @@ uint8_t __get_bit(uint32_t block_index) {
  * @param size		The size of the region
  */
 void __mark_region_free(uint32_t base_addr, uint32_t size) {
-	uint32_t block_index = base_addr / BLOCK_SIZE;
-	uint32_t num_blocks = size / BLOCK_SIZE;
-
-	for (; num_blocks > 0; num_blocks--) {
-		__unset_block(block_index);
-		block_index++;
-		used_blocks--;
-	}
+	__mark_range(base_addr / BLOCK_SIZE, size / BLOCK_SIZE, 0);
 }
 
 /**
@@ -129,14 +173,21 @@ void __mark_region_free(uint32_t base_addr, uint32_t size) {
  * @param size		The size of the region
  */
 void __mark_region_reserved(uint32_t base_addr, uint32_t size) {
-	uint32_t block_index = base_addr / BLOCK_SIZE;
-	uint32_t num_blocks = size / BLOCK_SIZE;
+	__mark_range(base_addr / BLOCK_SIZE, size / BLOCK_SIZE, 1);
+}
 
-	for (; num_blocks > 0; num_blocks--) {
-		__set_block(block_index);
-		block_index++;
-		used_blocks++;
+/**
+ * @brief Get the length of the part of the region below PMM_MAX_ADDRESS
+ *
+ * @param mem_map_entry The region (starting below PMM_MAX_ADDRESS)
+ */
+static uint32_t e820_region_length(struct mem_map_entry *mem_map_entry) {
+	if (mem_map_entry->region_length >
+		PMM_MAX_ADDRESS - mem_map_entry->base_addr) {
+		return PMM_MAX_ADDRESS - mem_map_entry->base_addr;
 	}
+
+	return mem_map_entry->region_length;
 }
 
 /**
@@ -144,7 +195,8 @@ void __mark_region_reserved(uint32_t base_addr, uint32_t size) {
  *
  * This function goes through the memory map created by E820 two times, the
  * first time marking the free blocks and the second time the reserved ones.
- * This ensures that overlapping parts in the map will be reserved.
+ * This ensures that overlapping parts in the map will be reserved. The memory
+ * above PMM_MAX_ADDRESS is ignored.
  */
 void mark_e820_regions() {
 	uint32_t *nr_entries = (uint32_t *) MEM_MAP_NR_ENTRIES_ADDRESS;
@@ -154,9 +206,10 @@ void mark_e820_regions() {
 		struct mem_map_entry *mem_map_entry =
 			(struct mem_map_entry *) MEM_MAP_ADDRESS + offset;
 
-		if (mem_map_entry->region_type == 1) {
+		if (mem_map_entry->region_type == 1 &&
+			mem_map_entry->base_addr <= PMM_MAX_ADDRESS) {
 			__mark_region_free(mem_map_entry->base_addr,
-							   mem_map_entry->region_length);
+							   e820_region_length(mem_map_entry));
 		}
 
 		offset++;
@@ -168,9 +221,10 @@ void mark_e820_regions() {
 		struct mem_map_entry *mem_map_entry =
 			(struct mem_map_entry *) MEM_MAP_ADDRESS + offset;
 
-		if (mem_map_entry->region_type != 1) {
+		if (mem_map_entry->region_type != 1 &&
+			mem_map_entry->base_addr <= PMM_MAX_ADDRESS) {
 			__mark_region_reserved(mem_map_entry->base_addr,
-								   mem_map_entry->region_length);
+								   e820_region_length(mem_map_entry));
 		}
 
 		offset++;
@@ -245,11 +299,13 @@ uint8_t pmm_self_test() {
 		printkc(4, "\t\t\t\t\tFAILED\n");
 #endif
 		return 1;
+#ifndef CONFIG_PAGE_ZERO
 	} else if (*a != 0x01010101) {
 #ifdef CONFIG_VERBOSE
 		printkc(4, "\t\t\t\t\tFAILED\n");
 #endif
 		return 1;
+#endif
 	} else {
 #ifdef CONFIG_VERBOSE
 		printkc(2, "\t\t\t\t\tOK\n");
@@ -269,11 +325,13 @@ uint8_t pmm_self_test() {
 		printkc(4, "\tFAILED\n");
 #endif
 		return 1;
+#ifndef CONFIG_PAGE_ZERO
 	} else if (*b != 0x01010101) {
 #ifdef CONFIG_VERBOSE
 		printkc(4, "\tFAILED\n");
 #endif
 		return 1;
+#endif
 	} else {
 #ifdef CONFIG_VERBOSE
 		printkc(2, "\tOK\n");
@@ -282,6 +340,34 @@ uint8_t pmm_self_test() {
 		test_used_blocks -= 2;
 	}
 
+#ifdef CONFIG_VERBOSE
+	printk("Allocating a zeroed block");
+#endif
+	uint32_t *c = (uint32_t *) allocate_blocks_flags(1, PMM_ZERO);
+	uint8_t zeroed = c != NULL;
+
+	for (uint32_t i = 0; zeroed && i < BLOCK_SIZE / sizeof(uint32_t); i++) {
+		zeroed = c[i] == 0;
+	}
+
+	if ((test_free_blocks > 0 && !zeroed) ||
+		(c != NULL && used_blocks - test_used_blocks != 1)) {
+#ifdef CONFIG_VERBOSE
+		printkc(4, "\t\tFAILED\n");
+#endif
+		return 1;
+	} else {
+#ifdef CONFIG_VERBOSE
+		printkc(2, "\t\t\tOK\n");
+#endif
+	}
+
+	if (c != NULL) {
+		free_blocks(c, 1);
+	}
+
+	pmm_benchmark();
+
 	return 0;
 }
 
@@ -312,6 +398,10 @@ uint8_t initialize_memory(void) {
 		(struct mem_map_entry *) MEM_MAP_ADDRESS + (*nr_entries - 1);
 	end_address = mem_map_entry->base_addr + mem_map_entry->region_length - 1;
 
+	if (end_address > PMM_MAX_ADDRESS) {
+		end_address = PMM_MAX_ADDRESS;
+	}
+
 	uint32_t total_ram_size = end_address - base_address;
 #ifdef CONFIG_VERBOSE
 	printk("total RAM size: %x\n", total_ram_size);
@@ -327,10 +417,14 @@ uint8_t initialize_memory(void) {
 
 	bitmap = (uint32_t *) BITMAP_ADDRESS;
 	max_blocks = total_ram_size / BLOCK_SIZE;
+
 	used_blocks = max_blocks;
+	bitmap_words = ceil(max_blocks, 32);
+	first_free_word = bitmap_words;
 
-	// initialize all regions as used_blocks
-	memset(bitmap, 0xFF, bitmap_size);
+	// initialize all regions as used_blocks (the bits of the last word past
+	// the end of the memory stay set)
+	memset(bitmap, 0xFF, bitmap_words * sizeof(uint32_t));
 
 	// mark regions in the memory map
 	mark_e820_regions();
@@ -338,6 +432,10 @@ uint8_t initialize_memory(void) {
 	// reserve lower part of memory until 0x100000 (kernel, BDA, mem map, etc.)
 	__mark_region_reserved(0, 0x100000);
 
+	if (initialize_buddy()) {
+		return 1;
+	}
+
 #ifdef CONFIG_VERBOSE
 	printk("total number of blocks: %d\n", max_blocks);
 	printk("used blocks: %d\n", used_blocks);
@@ -352,7 +450,10 @@ uint8_t initialize_memory(void) {
  * @brief Return first fit block
  *
  * This function goes through the bitmap and returns the first found block
- * that has enough free blocks afterwards to fulfill the requested requirement
+ * that has enough free blocks afterwards to fulfill the requested requirement.
+ * The bitmap is checked one 32-bit word at a time: full words are skipped,
+ * empty words extend the current run and the free runs inside the other words
+ * are found with bsf. The search starts with the first word that is not full.
  *
  * @param req_num_blocks Required number of blocks
  *
@@ -364,18 +465,65 @@ uint32_t __find_first_fit(uint32_t req_num_blocks) {
 	uint32_t current_number_of_free_blocks = 0;
 	uint32_t starting_block = 0;
 
-	// TODO: optimization: check entire 32-bit or one byte at least at a time
-	// instead of going through each bit in the bitmap
-	for (size_t i = 0; i < max_blocks; i++) {
-		if (__get_bit(i) == 0) {
-			current_number_of_free_blocks++;
+	while (first_free_word < bitmap_words &&
+		   bitmap[first_free_word] == 0xFFFFFFFF) {
+		first_free_word++;
+	}
+
+	for (uint32_t i = first_free_word; i < bitmap_words; i++) {
+		uint32_t word = bitmap[i];
+
+		if (word == 0xFFFFFFFF) {
+			current_number_of_free_blocks = 0;
+			continue;
+		}
+
+		if (word == 0) {
+			if (current_number_of_free_blocks == 0) {
+				starting_block = i * 32;
+			}
+
+			current_number_of_free_blocks += 32;
 
 			if (current_number_of_free_blocks >= req_num_blocks) {
 				return starting_block;
 			}
-		} else {
-			current_number_of_free_blocks = 0;
-			starting_block = i + 1;
+
+			continue;
+		}
+
+		// go through the free runs of the word
+		uint32_t bit = 0;
+
+		while (bit < 32) {
+			uint32_t free = ~word >> bit;
+
+			if (free == 0) {
+				current_number_of_free_blocks = 0;
+				break;
+			}
+
+			// used blocks before the run (a run that continues the one from
+			// the previous word starts with bit 0)
+			if ((free & 1) == 0) {
+				current_number_of_free_blocks = 0;
+				bit += bit_scan_forward(free);
+			}
+
+			uint32_t used = word >> bit;
+			uint32_t length = used == 0 ? 32 - bit : bit_scan_forward(used);
+
+			if (current_number_of_free_blocks == 0) {
+				starting_block = i * 32 + bit;
+			}
+
+			current_number_of_free_blocks += length;
+
+			if (current_number_of_free_blocks >= req_num_blocks) {
+				return starting_block;
+			}
+
+			bit += length;
 		}
 	}
 
@@ -383,60 +531,270 @@ uint32_t __find_first_fit(uint32_t req_num_blocks) {
 	return 0;
 }
 
+/**
+ * @brief Allocate memory for the per-block metadata
+ *
+ * The memory is taken from the first free region that is large enough. It is
+ * accessed with its physical address until paging is enabled, then the VMM
+ * maps it at PMM_METADATA_VIRT_ADDR (see pmm_relocate_metadata()).
+ *
+ * @param size Size in bytes
+ *
+ * @return The physical address of the memory, 0 if error occured
+ */
+uint32_t __allocate_metadata(uint32_t size) {
+	uint32_t num_blocks = ceil(size, BLOCK_SIZE);
+	uint32_t block = __find_first_fit(num_blocks);
+
+	if (block == 0) {
+		return 0;
+	}
+
+	__mark_range(block, num_blocks, 1);
+
+#ifdef CONFIG_VERBOSE
+	printk("metadata: %d blocks at %x\n", num_blocks, block * BLOCK_SIZE);
+#endif
+
+	return block * BLOCK_SIZE;
+}
+
+/**
+ * @brief Initialize the page frame database and the buddy allocator with the
+ * free blocks of the bitmap
+ *
+ * The metadata of both is placed in one free region (the page frame database
+ * first), then the free runs of the bitmap are added to the free lists (from
+ * the end of the memory, so the low blocks are allocated first). After this,
+ * the bitmap only records the state of the blocks.
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t initialize_buddy(void) {
+	uint32_t buddy_size = max_blocks * sizeof(struct buddy_frame);
+
+	frames_size = ceil(max_blocks * sizeof(struct page_frame), BLOCK_SIZE) *
+				  BLOCK_SIZE;
+	metadata_size = frames_size + ceil(buddy_size, BLOCK_SIZE) * BLOCK_SIZE;
+	metadata_address = __allocate_metadata(metadata_size);
+
+	if (metadata_address == 0) {
+		printk("no memory for the block metadata\n");
+		return 1;
+	}
+
+	// every block is reserved until its run is found below
+	frame_db_init((struct page_frame *) metadata_address, max_blocks);
+	frame_db_set_owner(metadata_address / BLOCK_SIZE,
+					   metadata_size / BLOCK_SIZE, FRAME_OWNER_METADATA);
+
+	buddy_init((struct buddy_frame *) (metadata_address + frames_size),
+			   max_blocks);
+
+	uint32_t run_end = 0; // end of the current free run, 0 if none
+
+	for (uint32_t block = max_blocks; block-- > 0;) {
+		// skip full words
+		if (run_end == 0 && block % 32 == 31 &&
+			bitmap[block / 32] == 0xFFFFFFFF) {
+			block -= 31;
+			continue;
+		}
+
+		if (!__get_bit(block)) {
+			if (run_end == 0) {
+				run_end = block + 1;
+			}
+		} else if (run_end != 0) {
+			buddy_free_range(block + 1, run_end - block - 1);
+			frame_db_free(block + 1, run_end - block - 1);
+			run_end = 0;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Get the physical location of the block metadata
+ *
+ * @param address	Filled with the physical address of the metadata
+ * @param size		Filled with the size of the metadata (multiple of
+ * 					BLOCK_SIZE)
+ */
+void pmm_get_metadata(uint32_t *address, uint32_t *size) {
+	*address = metadata_address;
+	*size = metadata_size;
+}
+
+/**
+ * @brief Access the block metadata through its new virtual address
+ *
+ * Called by the VMM once paging is enabled and the metadata is mapped.
+ *
+ * @param virtual_address The virtual address of the metadata
+ */
+void pmm_relocate_metadata(void *virtual_address) {
+	frame_db_relocate((struct page_frame *) virtual_address);
+	buddy_relocate((struct buddy_frame *) (virtual_address + frames_size));
+}
+
 /**
  * @brief Allocate num_blocks of physical memory
  *
- * This function allocates the requested number of blocks.
+ * This function allocates the requested number of blocks. The smallest buddy
+ * block that can hold them is taken and the blocks left at its end are freed
+ * again.
  *
- * @param num_blocks Requested number of blocks
+ * @param num_blocks Requested number of blocks (at most 2^BUDDY_MAX_ORDER)
  *
  * @return Starting physical address for the requested region
  */
 void *allocate_blocks(uint32_t num_blocks) {
-	if (num_blocks == 0) {
+	if (num_blocks == 0 || num_blocks > (1U << BUDDY_MAX_ORDER)) {
 		return NULL;
 	}
 
-	if (max_blocks - used_blocks < num_blocks) {
-		return NULL;
+	uint8_t order = buddy_order(num_blocks);
+	uint32_t block = 0;
+
+	if (max_blocks - used_blocks >= num_blocks) {
+		block = buddy_alloc(order);
 	}
 
-	uint32_t first_fit_block = __find_first_fit(num_blocks);
+#ifdef CONFIG_PAGE_ZERO
+	// the last free blocks may be kept by the pagezero pool
+	if (block == 0 && pagezero_reclaim() > 0) {
+		block = buddy_alloc(order);
+	}
+#endif
 
-	if (first_fit_block == 0) {
+	if (block == 0) {
 		return NULL;
 	}
 
-	uint32_t first_fit_block_copy = first_fit_block;
+	buddy_free_range(block + num_blocks, (1U << order) - num_blocks);
+	__mark_range(block, num_blocks, 1);
+	frame_db_alloc(block, num_blocks);
+
+	return (void *) (block * BLOCK_SIZE);
+}
 
-	for (; num_blocks > 0; num_blocks--) {
-		__set_block(first_fit_block);
-		first_fit_block++;
-		used_blocks++;
+/**
+ * @brief Allocate num_blocks of physical memory
+ *
+ * With PMM_ZERO, the blocks are filled with zeros. Single blocks are taken
+ * from the pool of blocks zeroed while the CPU is idle if possible (see
+ * pagezero.h), otherwise the memory is cleared here.
+ *
+ * @param num_blocks	Requested number of blocks
+ * @param flags			Allocation flags (PMM_ZERO)
+ *
+ * @return Starting physical address for the requested region
+ */
+void *allocate_blocks_flags(uint32_t num_blocks, uint8_t flags) {
+	void *block;
+
+#ifdef CONFIG_PAGE_ZERO
+	if ((flags & PMM_ZERO) && num_blocks == 1) {
+		block = pagezero_get();
+
+		if (block != NULL) {
+			return block;
+		}
 	}
+#endif
 
-	return (void *) (first_fit_block_copy * BLOCK_SIZE);
+	block = allocate_blocks(num_blocks);
+
+	if (block != NULL && (flags & PMM_ZERO)) {
+		// the blocks are not mapped, they are cleared one at a time
+		for (uint32_t i = 0; i < num_blocks; i++) {
+			memset(map_temporary(block + i * BLOCK_SIZE, TEMP_MAP_PMM), 0,
+				   BLOCK_SIZE);
+		}
+	}
+
+	return block;
+}
+
+/**
+ * @brief Give blocks back to the buddy allocator, without touching the memory
+ *
+ * @param block_index	The index of the first block
+ * @param num_blocks	Number of blocks
+ */
+void __free_range(uint32_t block_index, uint32_t num_blocks) {
+	__mark_range(block_index, num_blocks, 0);
+	buddy_free_range(block_index, num_blocks);
+	frame_db_free(block_index, num_blocks);
 }
 
 /**
  * @brief Free "size" blocks starting at the given address
  *
- * This function frees "size" blocks starting at the given address.
+ * This function frees "size" blocks starting at the given address. The
+ * blocks are merged with their free buddies. With CONFIG_PAGE_ZERO, the
+ * memory is not overwritten here: single blocks are kept by the pagezero pool
+ * (see pagezero.h) and zeroed when the CPU is idle.
  *
  * @param address 		Starting address
  * @param num_blocks	Number of blocks to free
  */
 void free_blocks(void *address, uint32_t num_blocks) {
-	uint32_t block_index = (uint32_t) address / BLOCK_SIZE;
-
+#ifndef CONFIG_PAGE_ZERO
 	// override entire block with 1
-	memset(address, 1, BLOCK_SIZE * num_blocks);
+	for (uint32_t i = 0; i < num_blocks; i++) {
+		memset(map_temporary(address + i * BLOCK_SIZE, TEMP_MAP_PMM), 1,
+			   BLOCK_SIZE);
+	}
+#else
+	if (num_blocks == 1 && pagezero_put(address) == 0) {
+		return;
+	}
+#endif
+
+	__free_range((uint32_t) address / BLOCK_SIZE, num_blocks);
+}
+
+/**
+ * @brief Measure the time needed to allocate and free blocks
+ *
+ * The blocks are allocated and freed repeatedly, and the average number of
+ * CPU cycles per operation is printed (with CONFIG_VERBOSE). The state of the
+ * allocator is the same at the end.
+ */
+void pmm_benchmark(void) {
+#ifdef CONFIG_VERBOSE
+	uint32_t sizes[] = {1, 8, 64};
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		uint32_t alloc_cycles = 0, free_cycles = 0; // no 64-bit division
+		uint32_t count = 0;
 
-	for (; num_blocks > 0; num_blocks--) {
-		__unset_block(block_index);
-		block_index++;
-		used_blocks--;
+		for (; count < PMM_BENCHMARK_ITERATIONS; count++) {
+			uint64_t start = read_tsc();
+			void *address = allocate_blocks(sizes[i]);
+
+			if (address == NULL) {
+				break;
+			}
+
+			uint64_t middle = read_tsc();
+
+			// free without overwriting the memory, only the allocator is timed
+			__free_range((uint32_t) address / BLOCK_SIZE, sizes[i]);
+
+			alloc_cycles += (uint32_t) (middle - start);
+			free_cycles += (uint32_t) (read_tsc() - middle);
+		}
+
+		if (count > 0) {
+			printk("%d block(s): allocate %d cycles, free %d cycles\n",
+				   sizes[i], alloc_cycles / count, free_cycles / count);
+		}
 	}
+#endif
 }
 
 /**
@@ -449,4 +807,9 @@ void print_phymem_info() {
 	printk("used blocks: %d\n", used_blocks);
 	printk("free blocks: %d\n", max_blocks - used_blocks);
 	printk("block size: %dB\n", BLOCK_SIZE);
+	buddy_print_info();
+	frame_db_print_info();
+#ifdef CONFIG_PAGE_ZERO
+	pagezero_print_info();
+#endif
 }
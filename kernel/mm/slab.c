@@ -0,0 +1,352 @@
+#include <kernel/global_addresses.h>
+#include <kernel/list.h>
+#include <kernel/string.h>
+#include <kernel/tty.h>
+#include <kernel/utils.h>
+#include <mm/frame.h>
+#include <mm/kmalloc.h>
+#include <mm/pmm.h>
+#include <mm/slab.h>
+#include <mm/vmm.h>
+
+#include <stddef.h>
+
+struct embedded_link slab_caches;
+uint8_t slab_caches_initialized;
+uint32_t slab_virt_used[SLAB_VIRT_SLOTS / 32]; // bit set: the range is used
+
+/**
+ * @brief Compute the layout of the slabs of a cache
+ *
+ * The smallest slab that wastes at most 1/SLAB_MAX_WASTE of its memory is
+ * chosen (or the biggest one, for big objects).
+ *
+ * @param cache The cache (with the object size set)
+ *
+ * @return 1 if error occured (the object doesn't fit in a slab), 0 otherwise
+ */
+uint8_t slab_cache_layout(struct slab_cache *cache) {
+	for (uint32_t order = 0; order <= SLAB_MAX_ORDER; order++) {
+		uint32_t slab_size = BLOCK_SIZE << order;
+		uint32_t objects = 0;
+		uint32_t offset = 0;
+
+		// the free stack grows with the number of objects
+		while (1) {
+			uint32_t next_offset =
+				ALIGN(sizeof(struct slab) + (objects + 1) * sizeof(uint16_t),
+					  ALIGNMENT);
+
+			if (objects + 1 > SLAB_MAX_OBJECTS ||
+				next_offset + (objects + 1) * cache->object_size > slab_size) {
+				break;
+			}
+
+			objects++;
+			offset = next_offset;
+		}
+
+		if (objects == 0) {
+			continue;
+		}
+
+		cache->slab_blocks = 1U << order;
+		cache->objects_per_slab = objects;
+		cache->objects_offset = offset;
+
+		uint32_t waste = slab_size - offset - objects * cache->object_size;
+
+		if (waste * SLAB_MAX_WASTE <= slab_size) {
+			break;
+		}
+	}
+
+	return cache->objects_per_slab == 0;
+}
+
+/**
+ * @brief Create a cache for objects of the given size
+ *
+ * @param name	Name of the cache (shown by slabinfo)
+ * @param size	Size of an object
+ * @param ctor	Constructor called for every new object, can be NULL
+ *
+ * @return The cache, NULL if error occured
+ */
+struct slab_cache *slab_cache_create(const char *name, uint32_t size,
+									 void (*ctor)(void *)) {
+	if (!slab_caches_initialized) {
+		list_init(&slab_caches);
+		slab_caches_initialized = 1;
+	}
+
+	struct slab_cache *cache = kmalloc(sizeof(struct slab_cache));
+
+	if (cache == NULL) {
+		printk("out of memory\n");
+		return NULL;
+	}
+
+	memset(cache, 0, sizeof(struct slab_cache));
+
+	strncpy(cache->name, name, SLAB_CACHE_NAME_SIZE - 1);
+	cache->object_size = ALIGN(size == 0 ? 1 : size, ALIGNMENT);
+	cache->ctor = ctor;
+
+	if (slab_cache_layout(cache)) {
+		printk("object too big for a slab: %d\n", size);
+		kfree(cache);
+		return NULL;
+	}
+
+	list_init(&cache->full);
+	list_init(&cache->partial);
+	list_init(&cache->empty);
+	list_add_end(&slab_caches, &cache->list);
+
+	return cache;
+}
+
+/**
+ * @brief Reserve the virtual range of a new slab
+ *
+ * @return The first address of the range, NULL if all of them are used
+ */
+void *slab_virt_alloc(void) {
+	for (uint32_t word = 0; word < SLAB_VIRT_SLOTS / 32; word++) {
+		if (slab_virt_used[word] == 0xFFFFFFFF) {
+			continue;
+		}
+
+		uint32_t bit = bit_scan_forward(~slab_virt_used[word]);
+
+		slab_virt_used[word] |= 1U << bit;
+
+		return (void *) (SLAB_VIRT_ADDR + (word * 32 + bit) * SLAB_VIRT_SIZE);
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Give back the virtual range of a slab
+ *
+ * @param address The first address of the range
+ */
+void slab_virt_free(void *address) {
+	uint32_t slot = ((uint32_t) address - SLAB_VIRT_ADDR) / SLAB_VIRT_SIZE;
+
+	slab_virt_used[slot / 32] &= ~(1U << (slot % 32));
+}
+
+/**
+ * @brief Unmap the first blocks of a slab, free them and give back its virtual
+ * range
+ *
+ * @param slab		The slab
+ * @param blocks	Number of mapped blocks
+ */
+void slab_unmap(struct slab *slab, uint32_t blocks) {
+	for (uint32_t i = 0; i < blocks; i++) {
+		address virt = (address) slab + i * BLOCK_SIZE;
+		void *phys = (void *) PAGE_GET_PHY_ADDRESS(get_page(virt));
+
+		unmap_page((void *) virt);
+		flush_tlb_entry(virt);
+		free_blocks(phys, 1);
+	}
+
+	slab_virt_free(slab);
+}
+
+/**
+ * @brief Create a new slab for the cache
+ *
+ * All the objects of the slab are constructed.
+ *
+ * @param cache The cache
+ *
+ * @return The slab, NULL if error occured
+ */
+struct slab *slab_create(struct slab_cache *cache) {
+	struct slab *slab = slab_virt_alloc();
+
+	if (slab == NULL) {
+		return NULL;
+	}
+
+	// map the blocks of the slab
+	for (uint32_t i = 0; i < cache->slab_blocks; i++) {
+		address virt = (address) slab + i * BLOCK_SIZE;
+		void *block = allocate_blocks(1);
+
+		if (block == NULL || map_page(block, (void *) virt)) {
+			if (block != NULL) {
+				free_blocks(block, 1);
+			}
+
+			slab_unmap(slab, i);
+			return NULL;
+		}
+
+		frame_set_owner(block, FRAME_OWNER_SLAB);
+		SET_ATTRIBUTE(get_page(virt), PAGE_PTE_WRITABLE);
+	}
+
+	slab->cache = cache;
+	slab->in_use = 0;
+	slab->free_count = cache->objects_per_slab;
+
+	// the first object is on top of the stack
+	for (uint32_t i = 0; i < cache->objects_per_slab; i++) {
+		slab->free_stack[i] = cache->objects_per_slab - 1 - i;
+
+		if (cache->ctor != NULL) {
+			cache->ctor((void *) slab + cache->objects_offset +
+						i * cache->object_size);
+		}
+	}
+
+	cache->num_slabs++;
+	cache->stats.slabs_created++;
+
+	return slab;
+}
+
+/**
+ * @brief Give the memory of an empty slab back to the physical memory manager
+ * (and its virtual range back to the slab allocator)
+ *
+ * @param slab The slab
+ */
+void slab_destroy(struct slab *slab) {
+	struct slab_cache *cache = slab->cache;
+
+	cache->num_slabs--;
+	cache->stats.slabs_destroyed++;
+
+	slab_unmap(slab, cache->slab_blocks);
+}
+
+/**
+ * @brief Allocate an object from the cache
+ *
+ * The object is taken from a partially used slab if possible, then from an
+ * empty one; a new slab is created only if the cache has no free object.
+ *
+ * @param cache The cache
+ *
+ * @return The object, NULL if error occured
+ */
+void *slab_alloc(struct slab_cache *cache) {
+	struct slab *slab;
+
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	if (!list_is_empty(&cache->partial)) {
+		slab = list_get_entry(cache->partial.next, struct slab, list);
+		list_delete(&cache->partial, &slab->list);
+	} else if (!list_is_empty(&cache->empty)) {
+		slab = list_get_entry(cache->empty.next, struct slab, list);
+		list_delete(&cache->empty, &slab->list);
+		cache->num_empty--;
+	} else {
+		slab = slab_create(cache);
+
+		if (slab == NULL) {
+			printk("out of memory\n");
+			return NULL;
+		}
+	}
+
+	uint16_t index = slab->free_stack[--slab->free_count];
+
+	slab->in_use++;
+
+	if (slab->free_count == 0) {
+		list_add_front(&cache->full, &slab->list);
+	} else {
+		list_add_front(&cache->partial, &slab->list);
+	}
+
+	cache->active_objects++;
+	cache->stats.allocations++;
+
+	return (void *) slab + cache->objects_offset + index * cache->object_size;
+}
+
+/**
+ * @brief Give an object back to its cache
+ *
+ * Empty slabs are kept for the next allocations, up to SLAB_MAX_EMPTY of them;
+ * the others are destroyed.
+ *
+ * @param cache		The cache
+ * @param object	The object (can be NULL)
+ */
+void slab_free(struct slab_cache *cache, void *object) {
+	if (cache == NULL || object == NULL) {
+		return;
+	}
+
+	struct slab *slab = (struct slab *) ((uint32_t) object &
+										 ~(cache->slab_blocks * BLOCK_SIZE - 1));
+
+	if (slab->cache != cache) {
+		printk("slab_free: object %x is not in cache %s\n", object,
+			   cache->name);
+		return;
+	}
+
+	uint32_t index =
+		((uint32_t) object - (uint32_t) slab - cache->objects_offset) /
+		cache->object_size;
+
+	list_delete(slab->free_count == 0 ? &cache->full : &cache->partial,
+				&slab->list);
+
+	slab->free_stack[slab->free_count++] = index;
+	slab->in_use--;
+
+	cache->active_objects--;
+	cache->stats.frees++;
+
+	if (slab->in_use > 0) {
+		list_add_front(&cache->partial, &slab->list);
+	} else if (cache->num_empty < SLAB_MAX_EMPTY) {
+		list_add_front(&cache->empty, &slab->list);
+		cache->num_empty++;
+	} else {
+		slab_destroy(slab);
+	}
+}
+
+/**
+ * @brief Print the statistics of every cache (slabinfo command)
+ */
+void slab_print_info(void) {
+	struct embedded_link *cursor;
+
+	if (!slab_caches_initialized) {
+		printk("no slab caches\n");
+		return;
+	}
+
+	printk("name: active/total objects, object size, slabs (blocks each)\n");
+
+	list_iterate(cursor, &slab_caches) {
+		struct slab_cache *cache =
+			list_get_entry(cursor, struct slab_cache, list);
+
+		printk("%s: %d/%d, %dB, %d (%d)\n", cache->name,
+			   cache->active_objects,
+			   cache->num_slabs * cache->objects_per_slab, cache->object_size,
+			   cache->num_slabs, cache->slab_blocks);
+		printk("\tallocations: %d, frees: %d, slabs created: %d, destroyed: "
+			   "%d\n",
+			   cache->stats.allocations, cache->stats.frees,
+			   cache->stats.slabs_created, cache->stats.slabs_destroyed);
+	}
+}
@@ -1,13 +1,42 @@
 #include <kernel/global_addresses.h>
 #include <kernel/string.h>
 #include <kernel/tty.h>
+#include <mm/frame.h>
 #include <mm/pmm.h>
 #include <mm/vmm.h>
 
 #include <stddef.h>
 
 struct page_directory *current_page_directory = 0;
+uint8_t address_spaces_created; // set by the first create_address_space()
 struct page_directory *kernel_page_directory = 0;
+uint8_t large_pages_enabled; // CR4.PSE set, 4MB pages can be used
+uint8_t global_pages_enabled; // CR4.PGE set, kernel mappings are global
+
+/**
+ * @brief Get the processor features that are reported in EDX by CPUID
+ *
+ * @return The features (CPUID_EDX_*)
+ */
+static uint32_t cpu_features(void) {
+	uint32_t eax = 1, ebx, ecx, edx;
+
+	__asm__ __volatile__("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+
+	return edx;
+}
+
+/**
+ * @brief Get the flags that mark a kernel mapping as global
+ *
+ * Global mappings are kept in the TLB when CR3 is reloaded; the kernel
+ * mappings are the same in every address space.
+ *
+ * @return PAGE_PTE_GLOBAL if global pages are enabled, 0 otherwise
+ */
+static inline uint32_t kernel_global_flag(void) {
+	return global_pages_enabled ? PAGE_PTE_GLOBAL : 0;
+}
 
 /**
  * @brief Get entry from page table for the given virtual address
@@ -56,7 +85,8 @@ pd_entry *get_pd_entry(struct page_directory *pd, address virtual_address) {
  *
  * This function first requests one block of memory from the physical
  * memory manager and then sets the frame of the given page table entry
- * to that physical memory and also sets the page entry as present.
+ * to that physical memory and also sets the page entry as present. The
+ * reference to the frame is owned by the page table entry.
  *
  * @param pte Pointer to the page table entry
  *
@@ -68,6 +98,7 @@ void *allocate_page(pt_entry *pte) {
 	if (block != NULL) {
 		SET_FRAME(pte, (address) block);
 		SET_ATTRIBUTE(pte, PAGE_PTE_PRESENT);
+		frame_set_owner(block, FRAME_OWNER_USER);
 	}
 
 	return block;
@@ -76,15 +107,17 @@ void *allocate_page(pt_entry *pte) {
 /**
  * @brief Free physical memory "pointed" to by the given page table entry
  *
- * This function gets the physical address from the page table entry, frees
- * it and sets the present bit to 0.
+ * This function gets the physical address from the page table entry, drops
+ * the entry's reference to it and sets the present bit to 0. The memory is
+ * freed when no other address space maps it.
  *
  * @param pte Pointer to the page table entry
  */
 void free_page(pt_entry *pte) {
 	void *address = (void *) PAGE_GET_PHY_ADDRESS(pte);
 
-	if (address != NULL) {
+	if (address != NULL && frame_info(address) != NULL &&
+		frame_put(address) == 0) {
 		free_blocks(address, 1);
 	}
 
@@ -118,12 +151,68 @@ uint8_t set_page_directory(struct page_directory *pd) {
  * @brief Flush TLB entry for the given virtual address (only in supervisor
  * mode)
  *
- * This function invalidates the TLB entry for the given virtual address.
+ * This function invalidates the TLB entry for the given virtual address. The
+ * interrupt flag is not changed, so it can be called from the syscalls.
  *
  * @param virtual_address The virtual address
  */
 void flush_tlb_entry(address virtual_address) {
-	__asm__ __volatile__("cli; invlpg (%0); sti" : : "r"(virtual_address));
+	__asm__ __volatile__("invlpg (%0)" : : "r"(virtual_address) : "memory");
+}
+
+/**
+ * @brief Give the region of the virtual address a page table in the current
+ * address space, if it has none
+ *
+ * The new page table is reachable (and cleared) through the recursive mapping
+ * right away.
+ *
+ * @param virtual_address	The virtual address
+ * @param flags				Extra flags for the page directory entry
+ * 							(PAGE_PDE_USER)
+ *
+ * @return 0 if successful, 1 otherwise (including the recursive window,
+ * regions mapped by 4MB pages and kernel regions after the first address space
+ * was created)
+ */
+static uint8_t add_page_table(address virtual_address, uint32_t flags) {
+	pd_entry *pde =
+		&CURRENT_PAGE_DIRECTORY->entries[PAGE_DIRECTORY_INDEX(virtual_address)];
+
+	if (PAGE_DIRECTORY_INDEX(virtual_address) == RECURSIVE_PDE_INDEX) {
+		return 1;
+	}
+
+	if (TEST_ATTRIBUTE(pde, PAGE_PDE_PRESENT)) {
+		return TEST_ATTRIBUTE(pde, PAGE_PDE_4MB) ? 1 : 0;
+	}
+
+	// the address spaces only share the kernel page tables that exist when
+	// they are created, a new one would be seen by the current one only
+	if (virtual_address >= KERNEL_VIRT_ADDR && address_spaces_created) {
+		printk("no kernel page table for %x\n", virtual_address);
+		return 1;
+	}
+
+	// allocate a block for the new page table
+	void *block = allocate_blocks(1);
+
+	if (block == NULL) {
+		return 1;
+	}
+
+	frame_set_owner(block, FRAME_OWNER_PAGE_TABLE);
+
+	// set frame and present and read-write bits
+	*pde = (address) block | PAGE_PDE_PRESENT | PAGE_PDE_WRITABLE | flags;
+
+	// the window page of the page table was not present
+	flush_tlb_entry((address) CURRENT_PAGE_TABLE(virtual_address));
+
+	// clear the page table through the window
+	memset(CURRENT_PAGE_TABLE(virtual_address), 0, sizeof(struct page_table));
+
+	return 0;
 }
 
 /**
@@ -131,7 +220,9 @@ void flush_tlb_entry(address virtual_address) {
  *
  * This function maps the given virtual address to the given physical address
  * by setting the frame in the corresponding page table. See comments below
- * for more info. It sets the USER bit to 1!
+ * for more info. It sets the USER bit to 1! The caller's reference to the
+ * physical frame is taken over by the page table entry (see frame_get() to map
+ * a frame in several address spaces).
  *
  * @param physical_address 	The physical address
  * @param virtual_address 	The virtual address
@@ -139,43 +230,77 @@ void flush_tlb_entry(address virtual_address) {
  * @return 0 if successful, 1 otherwise
  */
 uint8_t map_user_page(void *physical_address, void *virtual_address) {
-	// get current page directory
-	struct page_directory *pd = current_page_directory;
+	if (add_page_table((address) virtual_address, PAGE_PDE_USER)) {
+		return 1;
+	}
+
+	// get corresponding PTE for the given virtual address
+	pt_entry *pte = get_page((address) virtual_address);
+
+	// set frame and present bit
+	SET_FRAME(pte, (uint32_t) physical_address);
+	SET_ATTRIBUTE(pte, PAGE_PTE_PRESENT);
+
+	struct page_frame *frame = frame_info(physical_address);
 
-	// get corresponding PDE for the given virtual address
+	if (frame != NULL) {
+		frame->owner = FRAME_OWNER_USER;
+		frame->flags |= FRAME_MAPPED;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Check if the given virtual address is mapped in the current address
+ * space
+ *
+ * @param virtual_address The virtual address
+ *
+ * @return 1 if the page is present, 0 otherwise
+ */
+uint8_t user_page_present(address virtual_address) {
 	pd_entry *pde =
-		&pd->entries[PAGE_DIRECTORY_INDEX((uint32_t) virtual_address)];
+		&CURRENT_PAGE_DIRECTORY->entries[PAGE_DIRECTORY_INDEX(virtual_address)];
 
-	// if the page directory entry is not present, create it
-	if (!(*pde & PAGE_PDE_PRESENT)) {
-		// allocate block for the new page table
-		void *block = allocate_blocks(1);
+	if (!TEST_ATTRIBUTE(pde, PAGE_PDE_PRESENT)) {
+		return 0;
+	}
 
-		if (block == NULL) {
-			return 1;
-		}
+	return TEST_ATTRIBUTE(&CURRENT_PAGE_TABLE(virtual_address)
+							   ->entries[PAGE_TABLE_INDEX(virtual_address)],
+						  PAGE_PTE_PRESENT)
+			   ? 1
+			   : 0;
+}
 
-		// clear page table
-		memset(block, 0, sizeof(struct page_table));
+/**
+ * @brief Map a zeroed, writable user page at the given virtual address
+ *
+ * Used to populate the pages that are mapped on first touch (demand paging).
+ *
+ * @param virtual_address The virtual address (page aligned)
+ *
+ * @return 0 if successful, 1 otherwise
+ */
+uint8_t map_user_zero_page(address virtual_address) {
+	void *block = allocate_blocks_flags(1, PMM_ZERO);
 
-		// set frame and present and read-write bits
-		SET_FRAME(pde, (uint32_t) block);
-		SET_ATTRIBUTE(pde, PAGE_PDE_PRESENT);
-		SET_ATTRIBUTE(pde, PAGE_PDE_WRITABLE);
-		SET_ATTRIBUTE(pde, PAGE_PDE_USER);
-	} else {
-		// printk("page already present in pd!\n");
+	if (block == NULL) {
+		printk("out of memory\n");
+		return 1;
 	}
 
-	// get address of the page table
-	struct page_table *pt = (struct page_table *) PAGE_GET_PHY_ADDRESS(pde);
+	if (map_user_page(block, (void *) virtual_address)) {
+		free_blocks(block, 1);
+		printk("out of memory\n");
+		return 1;
+	}
 
-	// get corresponding PTE for the given virtual address
-	pt_entry *pte = &pt->entries[PAGE_TABLE_INDEX((uint32_t) virtual_address)];
+	pt_entry *page = get_page(virtual_address);
 
-	// set frame and present bit
-	SET_FRAME(pte, (uint32_t) physical_address);
-	SET_ATTRIBUTE(pte, PAGE_PTE_PRESENT);
+	SET_ATTRIBUTE(page, PAGE_PTE_WRITABLE);
+	SET_ATTRIBUTE(page, PAGE_PTE_USER | PAGE_PTE_PRESENT);
 
 	return 0;
 }
@@ -193,40 +318,45 @@ uint8_t map_user_page(void *physical_address, void *virtual_address) {
  * @return 0 if successful, 1 otherwise
  */
 uint8_t map_page(void *physical_address, void *virtual_address) {
-	// get current page directory
-	struct page_directory *pd = current_page_directory;
-
-	// get corresponding PDE for the given virtual address
-	pd_entry *pde =
-		&pd->entries[PAGE_DIRECTORY_INDEX((uint32_t) virtual_address)];
+	// fails if the region is already mapped by a 4MB page
+	if (add_page_table((address) virtual_address, 0)) {
+		return 1;
+	}
 
-	// if the page directory entry is not present, create it
-	if (!(*pde & PAGE_PDE_PRESENT)) {
-		// allocate block for the new page table
-		void *block = allocate_blocks(1);
+	// get corresponding PTE for the given virtual address
+	pt_entry *pte = get_page((address) virtual_address);
 
-		if (block == NULL) {
-			return 1;
-		}
+	// set frame and present bit (kernel mapping, global)
+	SET_FRAME(pte, (uint32_t) physical_address);
+	SET_ATTRIBUTE(pte, PAGE_PTE_PRESENT | kernel_global_flag());
 
-		// clear page table
-		memset(block, 0, sizeof(struct page_table));
+	return 0;
+}
 
-		// set frame and present and read-write bits
-		SET_FRAME(pde, (uint32_t) block);
-		SET_ATTRIBUTE(pde, PAGE_PDE_PRESENT);
-		SET_ATTRIBUTE(pde, PAGE_PDE_WRITABLE);
+/**
+ * @brief Map a 4MB page in the current address space (kernel only)
+ *
+ * @param physical_address 	The physical address (4MB aligned)
+ * @param virtual_address 	The virtual address (4MB aligned)
+ *
+ * @return 0 if successful, 1 if 4MB pages are not supported, the addresses
+ * are not aligned or the page directory entry is already used
+ */
+uint8_t map_large_page(void *physical_address, void *virtual_address) {
+	pd_entry *pde = &CURRENT_PAGE_DIRECTORY
+						 ->entries[PAGE_DIRECTORY_INDEX((uint32_t) virtual_address)];
+
+	if (!large_pages_enabled ||
+		PAGE_DIRECTORY_INDEX((uint32_t) virtual_address) ==
+			RECURSIVE_PDE_INDEX ||
+		((uint32_t) physical_address & (LARGE_PAGE_SIZE - 1)) ||
+		((uint32_t) virtual_address & (LARGE_PAGE_SIZE - 1)) ||
+		TEST_ATTRIBUTE(pde, PAGE_PDE_PRESENT)) {
+		return 1;
 	}
 
-	// get address of the page table
-	struct page_table *pt = (struct page_table *) PAGE_GET_PHY_ADDRESS(pde);
-
-	// get corresponding PTE for the given virtual address
-	pt_entry *pte = &pt->entries[PAGE_TABLE_INDEX((uint32_t) virtual_address)];
-
-	// set frame and present bit
-	SET_FRAME(pte, (uint32_t) physical_address);
-	SET_ATTRIBUTE(pte, PAGE_PTE_PRESENT);
+	*pde = (uint32_t) physical_address | PAGE_PDE_4MB | PAGE_PDE_WRITABLE |
+		   PAGE_PDE_PRESENT | kernel_global_flag();
 
 	return 0;
 }
@@ -235,24 +365,53 @@ uint8_t map_page(void *physical_address, void *virtual_address) {
  * @brief Return the PTE for the given virtual address
  *
  * This function returns the page table entry for the given virtual
- * address. More details in the code below.
+ * address in the current address space (the page directory entry has to be
+ * present). If the address is mapped by a 4MB page, the page directory entry
+ * is returned (its frame is the 4MB page).
  *
  * @param virtual_address The virtual address
  *
  * @return The corresponding page table entry
  */
 pt_entry *get_page(address virtual_address) {
-	// get current page directory
-	struct page_directory *pd = current_page_directory;
-
 	// get corresponding PDE for the given virtutal address
-	pd_entry *pde = &pd->entries[PAGE_DIRECTORY_INDEX(virtual_address)];
+	pd_entry *pde =
+		&CURRENT_PAGE_DIRECTORY->entries[PAGE_DIRECTORY_INDEX(virtual_address)];
 
-	// get the page table
-	struct page_table *pt = (struct page_table *) PAGE_GET_PHY_ADDRESS(pde);
+	if (TEST_ATTRIBUTE(pde, PAGE_PDE_4MB)) {
+		return (pt_entry *) pde;
+	}
 
-	// return the corresponding PTE for the given virtual address
-	return &pt->entries[PAGE_TABLE_INDEX(virtual_address)];
+	// the page table is at a fixed address in the recursive window
+	return &CURRENT_PAGE_TABLE(virtual_address)
+				->entries[PAGE_TABLE_INDEX(virtual_address)];
+}
+
+/**
+ * @brief Map a physical block at a temporary mapping slot
+ *
+ * The mapping stays until the slot is used again. Before paging is enabled,
+ * the physical address is returned.
+ *
+ * @param physical_address	The physical address of the block
+ * @param slot				The slot (see TEMP_MAP_SLOT)
+ *
+ * @return The virtual address of the block
+ */
+void *map_temporary(void *physical_address, TEMP_MAP_SLOT slot) {
+	if (current_page_directory == NULL) {
+		return physical_address;
+	}
+
+	address virt = TEMP_MAP_VIRT_ADDR + slot * PAGE_SIZE;
+	pt_entry *pte = get_page(virt);
+
+	// the page table was created at boot
+	*pte = ((address) physical_address & ~(PAGE_SIZE - 1)) | PAGE_PTE_PRESENT |
+		   PAGE_PTE_WRITABLE;
+	flush_tlb_entry(virt);
+
+	return (void *) virt;
 }
 
 /**
@@ -260,11 +419,19 @@ pt_entry *get_page(address virtual_address) {
  *
  * This function gets the page table entry for the given virtual address
  * and sets the frame (so the addressof the 4KB page frame) to 0 and unsets
- * the present bit.
+ * the present bit. A 4MB page is unmapped as a whole.
  *
  * @param virtual_address The virtual address
  */
 void unmap_page(void *virtual_address) {
+	pd_entry *pde = &CURRENT_PAGE_DIRECTORY
+						 ->entries[PAGE_DIRECTORY_INDEX((uint32_t) virtual_address)];
+
+	if (TEST_ATTRIBUTE(pde, PAGE_PDE_4MB)) {
+		*pde = 0;
+		return;
+	}
+
 	// get page table entry
 	pt_entry *pte = get_page((uint32_t) virtual_address);
 
@@ -273,15 +440,136 @@ void unmap_page(void *virtual_address) {
 	CLEAR_ATTRIBUTE(pte, PAGE_PTE_PRESENT);
 }
 
+/**
+ * @brief Identity map the first 4MB of memory in the given page directory
+ *
+ * A single 4MB page is used if the processor supports it, otherwise a page
+ * table.
+ *
+ * @param pd The page directory
+ *
+ * @return 0 if successful, 1 otherwise
+ */
+static uint8_t identity_map_low_memory(struct page_directory *pd) {
+	pd_entry *pde = &pd->entries[PAGE_DIRECTORY_INDEX(0x0)];
+
+	if (large_pages_enabled) {
+		SET_ATTRIBUTE(pde, PAGE_PDE_PRESENT | PAGE_PDE_WRITABLE | PAGE_PDE_4MB |
+							   kernel_global_flag());
+		return 0;
+	}
+
+	// allocate physical block for the page table that will be used
+	// for the identity mapping of the first 4MB
+	struct page_table *pt = (struct page_table *) allocate_blocks(1);
+
+	if (pt == NULL) {
+		return 1;
+	}
+
+	frame_set_owner(pt, FRAME_OWNER_PAGE_TABLE);
+
+	// clear all entries in the page table
+	memset(pt, 0, sizeof(struct page_table));
+
+	// map 4MB of memory starting at 0x00000000 to the 4MB of physical memory
+	// starting at 0x00000000 (identity mapping)
+	for (uint32_t i = 0, block = 0x0, virt = 0x0; i < 1024;
+		 i++, block += PAGE_SIZE, virt += PAGE_SIZE) {
+		// initialize page table entry to 0
+		pt_entry pte = 0;
+
+		// set writable, present and global bits and put the physical address
+		// in the frame
+		SET_ATTRIBUTE(&pte, PAGE_PTE_PRESENT | PAGE_PTE_WRITABLE |
+								kernel_global_flag());
+		SET_FRAME(&pte, block);
+
+		// put the PTE in the page table at the corresponding entry
+		pt->entries[PAGE_TABLE_INDEX(virt)] = pte;
+	}
+
+	// put the pt page table in the page directory at the corresponding index
+	// and set the present and writable bits
+	SET_ATTRIBUTE(pde, PAGE_PDE_PRESENT | PAGE_PDE_WRITABLE);
+	SET_FRAME(pde, (address) pt);
+
+	return 0;
+}
+
+/**
+ * @brief Create the empty page tables of the kernel range after the one of
+ * the kernel image, up to KERNEL_TABLES_END
+ *
+ * Called before paging is enabled.
+ *
+ * @param pd The page directory
+ *
+ * @return 0 if successful, 1 otherwise
+ */
+static uint8_t create_kernel_page_tables(struct page_directory *pd) {
+	for (uint32_t i = PAGE_DIRECTORY_INDEX(KERNEL_VIRT_ADDR) + 1;
+		 i < PAGE_DIRECTORY_INDEX(KERNEL_TABLES_END); i++) {
+		struct page_table *pt = (struct page_table *) allocate_blocks(1);
+
+		if (pt == NULL) {
+			return 1;
+		}
+
+		frame_set_owner(pt, FRAME_OWNER_PAGE_TABLE);
+		memset(pt, 0, sizeof(struct page_table));
+
+		pd->entries[i] = (address) pt | PAGE_PDE_PRESENT | PAGE_PDE_WRITABLE;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Map the block metadata of the PMM at PMM_METADATA_VIRT_ADDR
+ *
+ * Called before paging is enabled, after the kernel page tables are created.
+ * The metadata can be anywhere in the physical memory, so it cannot be reached
+ * through the identity mapping.
+ *
+ * @param pd The page directory
+ *
+ * @return 0 if successful, 1 otherwise
+ */
+static uint8_t map_pmm_metadata(struct page_directory *pd) {
+	uint32_t phys, size;
+
+	pmm_get_metadata(&phys, &size);
+
+	if (size > TEMP_MAP_VIRT_ADDR - PMM_METADATA_VIRT_ADDR) {
+		printk("block metadata too large: %d bytes\n", size);
+		return 1;
+	}
+
+	for (uint32_t offset = 0; offset < size; offset += PAGE_SIZE) {
+		address virt = PMM_METADATA_VIRT_ADDR + offset;
+		struct page_table *pt = (struct page_table *) PAGE_GET_PHY_ADDRESS(
+			&pd->entries[PAGE_DIRECTORY_INDEX(virt)]);
+
+		pt->entries[PAGE_TABLE_INDEX(virt)] =
+			(phys + offset) | PAGE_PTE_PRESENT | PAGE_PTE_WRITABLE |
+			kernel_global_flag();
+	}
+
+	return 0;
+}
+
 /**
  * @brief Initialize virtual memory manager
  *
  * This function creates a page directory with only two present entries: one
- * that identity maps the first 1MB of memory, and another one that maps 1MB
- * of memory starting at 0xC0000000 to the 1MB of physical memory that starts
- * at 0x00008000 (kernel location). It sets the created page directory as the
- * current page directory and enables paging. See comments below for more
- * information.
+ * that identity maps the first 4MB of memory (with a 4MB page if the processor
+ * supports it), and another one that maps 4MB of memory starting at 0xC0000000
+ * to the 4MB of physical memory that starts at 0x0000F000 (kernel location). The
+ * empty page tables of the rest of the kernel range (up to KERNEL_TABLES_END)
+ * are created as well, and the block metadata of the PMM is mapped in them. It
+ * sets the created page directory as the current page directory and enables
+ * paging. See comments below for more information.
  *
  * @return 0 if successful, 1 otherwise
  */
@@ -293,24 +581,27 @@ uint8_t initialize_virtual_memory(void) {
 		return 1;
 	}
 
+	frame_set_owner(pd, FRAME_OWNER_PAGE_TABLE);
+
 	// clear all entries in the page directory
 	memset(pd, 0, sizeof(struct page_directory));
 
-	// mark each entry in the PD as read-write
-	// for (uint32_t i = 0; i < 1024; i++) {
-	// 	SET_ATTRIBUTE(&pd->entries[i], PAGE_PDE_WRITABLE);
-	// }
+	uint32_t features = cpu_features();
 
-	// allocate physical block for the page table that will be used
-	// for the identity mapping of the first 4MB
-	struct page_table *pt = (struct page_table *) allocate_blocks(1);
+	// 4MB pages are translated only with CR4.PSE set
+	large_pages_enabled = (features & CPUID_EDX_PSE) ? 1 : 0;
+	global_pages_enabled = (features & CPUID_EDX_PGE) ? 1 : 0;
 
-	if (pt == NULL) {
-		return 1;
+	if (large_pages_enabled) {
+		__asm__ __volatile__(
+			"movl %%cr4, %%eax; orl $0x10, %%eax; movl %%eax, %%cr4" ::
+				: "eax");
 	}
 
-	// clear all entries in the page table
-	memset(pt, 0, sizeof(struct page_table));
+	// mark each entry in the PD as read-write
+	// for (uint32_t i = 0; i < 1024; i++) {
+	// 	SET_ATTRIBUTE(&pd->entries[i], PAGE_PDE_WRITABLE);
+	// }
 
 	// allocate physical block for the page table that will be used
 	// for the higher half kernel
@@ -320,25 +611,11 @@ uint8_t initialize_virtual_memory(void) {
 		return 1;
 	}
 
+	frame_set_owner(pt3gb, FRAME_OWNER_PAGE_TABLE);
+
 	// clear all entries in the page table
 	memset(pt3gb, 0, sizeof(struct page_table));
 
-	// map 4MB of memory starting at 0x00000000 to the 4MB of physical memory
-	// starting at 0x00000000 (identity mapping)
-	for (uint32_t i = 0, block = 0x0, virt = 0x0; i < 1024;
-		 i++, block += PAGE_SIZE, virt += PAGE_SIZE) {
-		// initialize page table entry to 0
-		pt_entry pte = 0;
-
-		// set writable and present bits and put the physical address in the
-		// frame
-		SET_ATTRIBUTE(&pte, PAGE_PTE_PRESENT | PAGE_PTE_WRITABLE);
-		SET_FRAME(&pte, block);
-
-		// put the PTE in the page table at the corresponding entry
-		pt->entries[PAGE_TABLE_INDEX(virt)] = pte;
-	}
-
 	// map 4MB of memory starting at 0xC0000000 to the 4MB of physical memory
 	// starting at 0x00008000 (where the kernel resides) (higher half kernel)
 	for (uint32_t i = 0, block = KERNEL_ADDRESS, virt = KERNEL_VIRT_ADDR;
@@ -346,9 +623,10 @@ uint8_t initialize_virtual_memory(void) {
 		//  initialize page table entry to 0
 		pt_entry pte = 0;
 
-		// set writable and present bits and put the physical address in the
-		// frame
-		SET_ATTRIBUTE(&pte, PAGE_PTE_PRESENT | PAGE_PTE_WRITABLE);
+		// set writable, present and global bits and put the physical address
+		// in the frame
+		SET_ATTRIBUTE(&pte, PAGE_PTE_PRESENT | PAGE_PTE_WRITABLE |
+								kernel_global_flag());
 		SET_FRAME(&pte, block);
 
 		// put the PTE in the page table at the corresponding index
@@ -361,19 +639,40 @@ uint8_t initialize_virtual_memory(void) {
 	SET_ATTRIBUTE(pde, PAGE_PDE_PRESENT | PAGE_PDE_WRITABLE);
 	SET_FRAME(pde, (address) pt3gb);
 
-	// put the pt page table in the page directory at the corresponding index
-	// and set the present and writable bits
-	pd_entry *pde2 = &pd->entries[PAGE_DIRECTORY_INDEX(0x0)];
-	SET_ATTRIBUTE(pde2, PAGE_PDE_PRESENT | PAGE_PDE_WRITABLE);
-	SET_FRAME(pde2, (address) pt);
+	// create the other kernel page tables (heap) now: they are copied into
+	// every address space, so the kernel runs in any of them
+	if (create_kernel_page_tables(pd) || map_pmm_metadata(pd)) {
+		return 1;
+	}
+
+	// identity map the first 4MB
+	if (identity_map_low_memory(pd)) {
+		return 1;
+	}
+
+	// map the page directory into itself, so the page tables can be reached
+	// through the recursive window once paging is enabled
+	pd->entries[RECURSIVE_PDE_INDEX] =
+		(address) pd | PAGE_PDE_PRESENT | PAGE_PDE_WRITABLE;
 
 	// set the page directory
 	set_page_directory(pd);
 	kernel_page_directory = current_page_directory;
 
-	// enable paging
+	// enable paging; with write protect, the writes of the kernel to read-only
+	// user pages fault as well (needed to copy the pages shared by a fork)
 	__asm__ __volatile__(
-		"movl %cr0, %eax; orl $0x80000001, %eax; movl %eax, %cr0");
+		"movl %cr0, %eax; orl $0x80010001, %eax; movl %eax, %cr0");
+
+	// the block metadata is reached through its mapping from now on
+	pmm_relocate_metadata((void *) PMM_METADATA_VIRT_ADDR);
+
+	// keep the kernel mappings in the TLB across address space switches
+	if (global_pages_enabled) {
+		__asm__ __volatile__(
+			"movl %%cr4, %%eax; orl $0x80, %%eax; movl %%eax, %%cr4" ::
+				: "eax");
+	}
 
 	return 0;
 }
@@ -384,9 +683,10 @@ uint8_t initialize_virtual_memory(void) {
  *
  * This function returns a page directory containing the kernel mappings for the
  * first 4MB of memory and the 4MB above 0xC0000000 (kernel). All other page
- * directory entries are set to 0.
+ * directory entries are set to 0. The new directory is filled through a
+ * temporary mapping.
  *
- * @return New page directory
+ * @return New page directory (physical address)
  */
 struct page_directory *create_address_space(void) {
 	struct page_directory *dir = allocate_blocks(1);
@@ -394,26 +694,190 @@ struct page_directory *create_address_space(void) {
 	if (dir == NULL) {
 		return NULL;
 	}
+
+	frame_set_owner(dir, FRAME_OWNER_PAGE_TABLE);
+	address_spaces_created = 1;
 #ifdef CONFIG_VERBOSE
 	printk("new addr space created %x\n", dir);
 #endif
 
-	// clear all entries in the page directory
-	memset(dir, 0, sizeof(struct page_directory));
+	struct page_directory *new_pd = map_temporary(dir, TEMP_MAP_DIRECTORY);
 
 	// map kernel into the virtual address space:
 	// copy entries in the current page directory - what we need are only the
-	// kernel pages (first 1MB and pages from 0xC0000000)
-	memcpy(dir, kernel_page_directory, sizeof(pd_entry) * PAGES_PER_TABLE);
+	// kernel pages (first 1MB and pages from 0xC0000000), they are the same in
+	// every address space
+	memcpy(new_pd, CURRENT_PAGE_DIRECTORY, sizeof(pd_entry) * PAGES_PER_TABLE);
 
 	// clear entries between the first 1MB and the higher half kernel
 	// memset(dir + 1, 0, sizeof(pd_entry) *
 	// PAGE_DIRECTORY_INDEX(KERNEL_VIRT_ADDR) - 1);
 	for (uint32_t i = 1; i < PAGE_DIRECTORY_INDEX(KERNEL_VIRT_ADDR); i++) {
-		dir->entries[i] = 0;
+		new_pd->entries[i] = 0;
+	}
+
+	// the recursive entry refers to the new directory
+	new_pd->entries[RECURSIVE_PDE_INDEX] =
+		(address) dir | PAGE_PDE_PRESENT | PAGE_PDE_WRITABLE;
+
+	return dir;
+}
+
+/**
+ * @brief Create a copy-on-write copy of the current address space
+ *
+ * Only the page tables of the user space are copied; the pages are shared by
+ * the two address spaces (each mapping holds a reference to the frame). The
+ * writable pages are made read-only in both address spaces and marked
+ * PAGE_PTE_COW, so they are copied by the first write to them (see
+ * copy_on_write_page()). The cost is given by the number of page tables, not
+ * by the memory used by the task.
+ *
+ * The current page tables are read through the recursive window; the new ones
+ * are not part of the current address space and are filled through temporary
+ * mappings.
+ *
+ * @return New page directory, NULL if error occured
+ */
+struct page_directory *clone_address_space(void) {
+	struct page_directory *dir = create_address_space();
+
+	if (dir == NULL) {
+		return NULL;
+	}
+
+	struct page_directory *new_pd = map_temporary(dir, TEMP_MAP_DIRECTORY);
+
+	for (uint32_t i = 1; i < PAGE_DIRECTORY_INDEX(KERNEL_VIRT_ADDR); i++) {
+		pd_entry *pde = &CURRENT_PAGE_DIRECTORY->entries[i];
+
+		if (!TEST_ATTRIBUTE(pde, PAGE_PDE_PRESENT)) {
+			continue;
+		}
+
+		struct page_table *pt = CURRENT_PAGE_TABLE(i << 22);
+		void *block = allocate_blocks_flags(1, PMM_ZERO);
+
+		if (block == NULL) {
+			goto err;
+		}
+
+		frame_set_owner(block, FRAME_OWNER_PAGE_TABLE);
+		new_pd->entries[i] = (*pde & 0xFFF) | (address) block;
+
+		struct page_table *copy = map_temporary(block, TEMP_MAP_TABLE);
+
+		for (uint32_t j = 0; j < PAGES_PER_TABLE; j++) {
+			pt_entry *pte = &pt->entries[j];
+
+			if (!TEST_ATTRIBUTE(pte, PAGE_PTE_PRESENT)) {
+				continue;
+			}
+
+			// the rest of the copy stays empty
+			if (frame_get((void *) PAGE_GET_PHY_ADDRESS(pte))) {
+				goto err;
+			}
+
+			if (TEST_ATTRIBUTE(pte, PAGE_PTE_WRITABLE)) {
+				CLEAR_ATTRIBUTE(pte, PAGE_PTE_WRITABLE);
+				SET_ATTRIBUTE(pte, PAGE_PTE_COW);
+			}
+
+			copy->entries[j] = *pte;
+		}
 	}
 
+	// the pages of the current address space may have been made read-only
+	set_page_directory(current_page_directory);
+
 	return dir;
+
+err:
+	set_page_directory(current_page_directory);
+
+	for (uint32_t i = 1; i < PAGE_DIRECTORY_INDEX(KERNEL_VIRT_ADDR); i++) {
+		pd_entry *pde = &new_pd->entries[i];
+
+		if (*pde == 0) {
+			continue;
+		}
+
+		void *block = (void *) PAGE_GET_PHY_ADDRESS(pde);
+		struct page_table *pt = map_temporary(block, TEMP_MAP_TABLE);
+
+		for (uint32_t j = 0; j < PAGES_PER_TABLE; j++) {
+			if (pt->entries[j] != 0) {
+				free_page(&pt->entries[j]);
+			}
+		}
+
+		free_blocks(block, 1);
+	}
+
+	free_blocks(dir, 1);
+	printk("out of memory\n");
+
+	return NULL;
+}
+
+/**
+ * @brief Give the running task its own copy of a page shared by a fork
+ *
+ * If no other address space maps the page any more, the page is only made
+ * writable again.
+ *
+ * @param virtual_address The address that caused the write fault
+ *
+ * @return 0 if the page is writable now, 1 if the page is not copy-on-write
+ * (or there is no memory left)
+ */
+uint8_t copy_on_write_page(address virtual_address) {
+	pd_entry *pde =
+		&CURRENT_PAGE_DIRECTORY->entries[PAGE_DIRECTORY_INDEX(virtual_address)];
+
+	if (!TEST_ATTRIBUTE(pde, PAGE_PDE_PRESENT)) {
+		return 1;
+	}
+
+	pt_entry *pte = get_page(virtual_address);
+
+	if (!TEST_ATTRIBUTE(pte, PAGE_PTE_PRESENT) ||
+		!TEST_ATTRIBUTE(pte, PAGE_PTE_COW)) {
+		return 1;
+	}
+
+	void *frame = (void *) PAGE_GET_PHY_ADDRESS(pte);
+	struct page_frame *info = frame_info(frame);
+
+	if (info == NULL || info->refcount > 1) {
+		void *copy = allocate_blocks(1);
+
+		if (copy == NULL) {
+			printk("out of memory\n");
+			return 1;
+		}
+
+		// the shared page is still mapped (read-only) at the faulting address
+		memcpy(map_temporary(copy, TEMP_MAP_TABLE),
+			   (void *) (virtual_address & ~(PAGE_SIZE - 1)), PAGE_SIZE);
+		frame_put(frame);
+
+		SET_FRAME(pte, (address) copy);
+
+		info = frame_info(copy);
+
+		if (info != NULL) {
+			info->owner = FRAME_OWNER_USER;
+			info->flags |= FRAME_MAPPED;
+		}
+	}
+
+	CLEAR_ATTRIBUTE(pte, PAGE_PTE_COW);
+	SET_ATTRIBUTE(pte, PAGE_PTE_WRITABLE);
+	flush_tlb_entry(virtual_address & ~(PAGE_SIZE - 1));
+
+	return 0;
 }
 
 /**
@@ -431,9 +895,9 @@ void restore_kernel_address_space(void) {
 	// tables except the ones for kernel: exclude the first 4MB (that is
 	// why the index starts at 1) and the memory above 0xC0000000
 	for (uint32_t i = 1; i < PAGE_DIRECTORY_INDEX(KERNEL_VIRT_ADDR); i++) {
-		if ((uint32_t) current_page_directory->entries[i] != 0) {
+		if ((uint32_t) CURRENT_PAGE_DIRECTORY->entries[i] != 0) {
 			pd_entry phys_address_of_page_table =
-				current_page_directory->entries[i];
+				CURRENT_PAGE_DIRECTORY->entries[i];
 
 			free_blocks(
 				(void *) PAGE_GET_PHY_ADDRESS(&phys_address_of_page_table), 1);
@@ -464,13 +928,9 @@ void restore_kernel_address_space(void) {
  */
 void free_proc_phys_mem(void) {
 	for (uint32_t i = 1; i < PAGE_DIRECTORY_INDEX(KERNEL_VIRT_ADDR); i++) {
-		if ((uint32_t) current_page_directory->entries[i] != 0) {
-			pd_entry pde = current_page_directory->entries[i];
-
+		if ((uint32_t) CURRENT_PAGE_DIRECTORY->entries[i] != 0) {
 			// get page table corresponding to the pde
-			struct page_table *pt =
-				(struct page_table *) PAGE_GET_PHY_ADDRESS(&pde);
-			// printk("freeing %x %d\n", pt, i);
+			struct page_table *pt = CURRENT_PAGE_TABLE(i << 22);
 
 			for (uint32_t j = 0; j < 1024; j++) {
 				if (pt->entries[j] != 0) {
@@ -487,33 +947,34 @@ void free_proc_phys_mem(void) {
  * @brief Return the physical address corresponding to the given virtual address
  *
  * This funcion returns the physical address for the given virtual address based
- * on the current page directory.
+ * on the current page directory (the page table is read through the recursive
+ * window).
  *
  * @param virt_addr The virtual address
  *
- * @return The physical address
+ * @return The physical address, 0 if the address is not mapped
  */
 address get_physical_addr(address virt_addr) {
-	// get current page directory
-	struct page_directory *pd = current_page_directory;
-
-	printk("%d - %x\n", PAGE_DIRECTORY_INDEX(virt_addr),
-		   pd->entries[PAGE_DIRECTORY_INDEX(virt_addr)]);
-	// get corresponding PDE for the given virtutal address
-	pd_entry *pde = &pd->entries[PAGE_DIRECTORY_INDEX(virt_addr)];
+	pd_entry *pde =
+		&CURRENT_PAGE_DIRECTORY->entries[PAGE_DIRECTORY_INDEX(virt_addr)];
 
-	// get the page table
-	struct page_table *pt = (struct page_table *) PAGE_GET_PHY_ADDRESS(pde);
+	if (!TEST_ATTRIBUTE(pde, PAGE_PDE_PRESENT)) {
+		return 0;
+	}
 
-	printk("%x - %x\n", PAGE_TABLE_INDEX(virt_addr),
-		   pt->entries[PAGE_TABLE_INDEX(virt_addr)]);
+	if (TEST_ATTRIBUTE(pde, PAGE_PDE_4MB)) {
+		return (*pde & ~(LARGE_PAGE_SIZE - 1)) +
+			   (virt_addr & (LARGE_PAGE_SIZE - 1));
+	}
 
-	pt_entry test = pt->entries[PAGE_TABLE_INDEX(virt_addr)];
+	pt_entry *pte = &CURRENT_PAGE_TABLE(virt_addr)
+						 ->entries[PAGE_TABLE_INDEX(virt_addr)];
 
-	test &= 0xFFFFF000;
-	test += (virt_addr & 0x00000FFF);
+	if (!TEST_ATTRIBUTE(pte, PAGE_PTE_PRESENT)) {
+		return 0;
+	}
 
-	return test;
+	return PAGE_GET_PHY_ADDRESS(pte) + (virt_addr & (PAGE_SIZE - 1));
 }
 
 /**
@@ -0,0 +1,308 @@
+#include <kernel/string.h>
+#include <kernel/tty.h>
+#include <kernel/utils.h>
+#include <kernel/vfs.h>
+#include <mm/kmalloc.h>
+#include <mm/slab.h>
+#include <process/fdtable.h>
+#include <process/process.h>
+
+#include <stddef.h>
+
+struct slab_cache *open_file_cache; // created by the first open
+
+/**
+ * @brief Create a file descriptor table
+ *
+ * The descriptors of the standard streams are marked as used, so they are
+ * never returned by fd_alloc().
+ *
+ * @param size Number of descriptors (multiple of 32)
+ *
+ * @return The table, NULL if error occured
+ */
+struct fd_table *fd_table_create(uint32_t size) {
+	struct fd_table *table = kmalloc(sizeof(struct fd_table));
+
+	if (table == NULL) {
+		printk("out of memory\n");
+		return NULL;
+	}
+
+	table->files = kmalloc(size * sizeof(struct open_files_table *));
+	table->bitmap = kmalloc(size / 32 * sizeof(uint32_t));
+
+	if (table->files == NULL || table->bitmap == NULL) {
+		printk("out of memory\n");
+		goto err;
+	}
+
+	memset(table->files, 0, size * sizeof(struct open_files_table *));
+	memset(table->bitmap, 0, size / 32 * sizeof(uint32_t));
+
+	table->bitmap[0] = (1 << FD_RESERVED) - 1;
+	table->summary = 0;
+	table->size = size;
+	table->used = 0;
+
+	return table;
+
+err:
+	kfree(table->bitmap);
+	kfree(table->files);
+	kfree(table);
+	return NULL;
+}
+
+/**
+ * @brief Double the number of descriptors of the table
+ *
+ * @param table The table
+ *
+ * @return 1 if error occured (including the table being at its maximum size),
+ * 0 otherwise
+ */
+uint8_t fd_table_grow(struct fd_table *table) {
+	uint32_t size = table->size * 2;
+
+	if (size > FD_TABLE_MAX_SIZE) {
+		return 1;
+	}
+
+	struct open_files_table **files =
+		kmalloc(size * sizeof(struct open_files_table *));
+	uint32_t *bitmap = kmalloc(size / 32 * sizeof(uint32_t));
+
+	if (files == NULL || bitmap == NULL) {
+		printk("out of memory\n");
+		kfree(bitmap);
+		kfree(files);
+		return 1;
+	}
+
+	memset(files, 0, size * sizeof(struct open_files_table *));
+	memset(bitmap, 0, size / 32 * sizeof(uint32_t));
+	memcpy(files, table->files,
+		   table->size * sizeof(struct open_files_table *));
+	memcpy(bitmap, table->bitmap, table->size / 32 * sizeof(uint32_t));
+
+	kfree(table->bitmap);
+	kfree(table->files);
+
+	// the new bitmap words are empty, the summary doesn't change
+	table->files = files;
+	table->bitmap = bitmap;
+	table->size = size;
+
+	return 0;
+}
+
+/**
+ * @brief Copy the file descriptor table (for a forked task)
+ *
+ * The descriptors of the copy refer to the same open files (and share their
+ * offsets).
+ *
+ * @param table The table
+ *
+ * @return The copy, NULL if error occured
+ */
+struct fd_table *fd_table_copy(struct fd_table *table) {
+	struct fd_table *copy = fd_table_create(table->size);
+
+	if (copy == NULL) {
+		return NULL;
+	}
+
+	memcpy(copy->files, table->files,
+		   table->size * sizeof(struct open_files_table *));
+	memcpy(copy->bitmap, table->bitmap, table->size / 32 * sizeof(uint32_t));
+	copy->summary = table->summary;
+	copy->used = table->used;
+
+	for (uint32_t fd = 0; fd < table->size; fd++) {
+		if (table->files[fd] != NULL) {
+			table->files[fd]->reference_number++;
+		}
+	}
+
+	return copy;
+}
+
+/**
+ * @brief Allocate the lowest free descriptor of the task
+ *
+ * The table is created by the first allocation and grows when it is full.
+ *
+ * @param task The task
+ * @param file The open file the descriptor refers to
+ *
+ * @return The descriptor, -1 if error occured
+ */
+int fd_alloc(struct task_struct *task, struct open_files_table *file) {
+	if (task->files == NULL) {
+		task->files = fd_table_create(FD_TABLE_INITIAL_SIZE);
+
+		if (task->files == NULL) {
+			return -1;
+		}
+	}
+
+	struct fd_table *table = task->files;
+	uint32_t words = table->size / 32;
+	uint32_t mask = words == 32 ? 0xFFFFFFFF : (1U << words) - 1;
+	uint32_t free_words = ~table->summary & mask;
+
+	if (free_words == 0) {
+		if (fd_table_grow(table)) {
+			printk("limit of open files reached: %d! close some to open "
+				   "more!\n",
+				   FD_TABLE_MAX_SIZE);
+			return -1;
+		}
+
+		// the first new word is free
+		free_words = 1U << words;
+	}
+
+	uint32_t word = bit_scan_forward(free_words);
+	uint32_t bit = bit_scan_forward(~table->bitmap[word]);
+	int fd = word * 32 + bit;
+
+	table->bitmap[word] |= 1U << bit;
+
+	if (table->bitmap[word] == 0xFFFFFFFF) {
+		table->summary |= 1U << word;
+	}
+
+	table->files[fd] = file;
+	table->used++;
+
+	return fd;
+}
+
+/**
+ * @brief Get the open file the descriptor refers to
+ *
+ * @param task	The task
+ * @param fd	The descriptor
+ *
+ * @return The open file, NULL if the descriptor is not used
+ */
+struct open_files_table *fd_get(struct task_struct *task, int fd) {
+	if (task == NULL || task->files == NULL || fd < 0 ||
+		(uint32_t) fd >= task->files->size) {
+		return NULL;
+	}
+
+	return task->files->files[fd];
+}
+
+/**
+ * @brief Release the descriptor
+ *
+ * @param task	The task
+ * @param fd	The descriptor
+ *
+ * @return The open file the descriptor referred to (its reference is now
+ * owned by the caller), NULL if the descriptor was not used
+ */
+struct open_files_table *fd_free(struct task_struct *task, int fd) {
+	struct open_files_table *file = fd_get(task, fd);
+
+	if (file == NULL) {
+		return NULL;
+	}
+
+	struct fd_table *table = task->files;
+
+	table->files[fd] = NULL;
+	table->bitmap[fd / 32] &= ~(1U << (fd % 32));
+	table->summary &= ~(1U << (fd / 32));
+	table->used--;
+
+	return file;
+}
+
+/**
+ * @brief Create an open file object
+ *
+ * @param inode The in-memory inode (the reference is taken over)
+ * @param flags The flags the file was opened with
+ *
+ * @return The open file with one reference, NULL if error occured
+ */
+struct open_files_table *open_file_create(struct vfs_inode *inode,
+										  uint16_t flags) {
+	if (open_file_cache == NULL) {
+		open_file_cache = slab_cache_create(
+			"open_file", sizeof(struct open_files_table), NULL);
+	}
+
+	struct open_files_table *file = slab_alloc(open_file_cache);
+
+	if (file == NULL) {
+		printk("out of memory\n");
+		return NULL;
+	}
+
+	file->inode = inode;
+	file->offset = 0;
+	file->flags = flags;
+	file->reference_number = 1;
+
+	return file;
+}
+
+/**
+ * @brief Drop a reference to the open file
+ *
+ * The file is closed when the last reference is dropped.
+ *
+ * @param file The open file
+ */
+void open_file_put(struct open_files_table *file) {
+	if (--file->reference_number > 0) {
+		return;
+	}
+
+	// the inode and the file's data are freed when the last reference to the
+	// in-memory inode is dropped
+	vfs_iput(file->inode);
+	slab_free(open_file_cache, file);
+}
+
+/**
+ * @brief Close all the descriptors of the task and free its table
+ *
+ * Called when the task exits or is killed.
+ *
+ * @param task The task
+ */
+void fd_table_destroy(struct task_struct *task) {
+	struct fd_table *table = task->files;
+
+	if (table == NULL) {
+		return;
+	}
+
+	for (uint32_t word = 0; word < table->size / 32; word++) {
+		uint32_t used = table->bitmap[word];
+
+		while (used != 0) {
+			uint32_t bit = bit_scan_forward(used);
+			struct open_files_table *file = table->files[word * 32 + bit];
+
+			if (file != NULL) {
+				open_file_put(file);
+			}
+
+			used &= ~(1U << bit);
+		}
+	}
+
+	kfree(table->bitmap);
+	kfree(table->files);
+	kfree(table);
+	task->files = NULL;
+}
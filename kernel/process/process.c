@@ -1,8 +1,11 @@
 #include <arch/i386/gdt.h>
+#include <kernel/elf.h>
 #include <kernel/shell.h>
 #include <kernel/string.h>
 #include <kernel/tty.h>
+#include <kernel/vfs.h>
 #include <mm/kmalloc.h>
+#include <mm/slab.h>
 #include <mm/vmm.h>
 #include <process/process.h>
 #include <process/scheduler.h>
@@ -10,6 +13,43 @@
 static uint32_t next_available_task_id = 1;
 extern struct task_struct *current_running_task;
 
+struct slab_cache *task_cache;
+struct slab_cache *context_cache;
+struct slab_cache *kstack_cache;
+struct slab_cache *mapping_cache;
+
+/**
+ * @brief Create the object caches for the tasks
+ *
+ * Has to be called before the first task is created.
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t process_caches_init(void) {
+	task_cache =
+		slab_cache_create("task_struct", sizeof(struct task_struct), NULL);
+	context_cache =
+		slab_cache_create("proc_context", sizeof(struct proc_context), NULL);
+	kstack_cache = slab_cache_create("kstack", KSTACK_SIZE, NULL);
+	mapping_cache = slab_cache_create("mapping", sizeof(struct mapping), NULL);
+
+	if (task_cache == NULL || context_cache == NULL || kstack_cache == NULL ||
+		mapping_cache == NULL) {
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Free the kernel stack of a kernel task
+ *
+ * @param kstack The top of the stack (task->kstack)
+ */
+void free_kstack(void *kstack) {
+	slab_free(kstack_cache, kstack - KSTACK_SIZE);
+}
+
 /**
  * @brief Create a task
  *
@@ -25,8 +65,7 @@ extern struct task_struct *current_running_task;
  */
 struct task_struct *create_task(void *exec_address, int argc, char **argv,
 								int userspace) {
-	struct task_struct *task =
-		(struct task_struct *) kmalloc(sizeof(struct task_struct));
+	struct task_struct *task = slab_alloc(task_cache);
 	void *k_stack = NULL;
 #ifdef CONFIG_VERBOSE
 	printk("create task: %s\n", argv[0]);
@@ -43,8 +82,18 @@ struct task_struct *create_task(void *exec_address, int argc, char **argv,
 	task->run_time = 0;
 	task->sleep_time = 0;
 	task->maps = NULL;
+	task->stack_limit = NULL;
+	task->files = NULL;
+	task->exec_inode = NULL;
+	task->parent = NULL;
+	task->children = NULL;
+	task->sibling = NULL;
+	task->exited = NULL;
+	task->wait_pid = 0;
+	task->exit_code = 0;
+	task->shell_task = 0;
 
-	task->context = kmalloc(sizeof(struct proc_context));
+	task->context = slab_alloc(context_cache);
 
 	if (!task->context) {
 		goto task_context_err;
@@ -58,6 +107,7 @@ struct task_struct *create_task(void *exec_address, int argc, char **argv,
 		}
 
 		task->ring = 3;
+		task->kstack = NULL;
 		task->context->cs = USER_CS;
 		task->context->ds = USER_DS;
 		task->context->es = USER_DS;
@@ -75,7 +125,7 @@ struct task_struct *create_task(void *exec_address, int argc, char **argv,
 		task->context->gs = KERNEL_DS;
 		task->context->ss = KERNEL_DS;
 
-		k_stack = kmalloc(sizeof(char) * KSTACK_SIZE);
+		k_stack = slab_alloc(kstack_cache);
 
 		if (!k_stack) {
 			goto task_kstack_err;
@@ -114,42 +164,264 @@ task_argvs_err:
 	kfree(task->argv);
 task_argv_err:
 	if (k_stack != NULL) {
-		kfree(k_stack);
+		slab_free(kstack_cache, k_stack);
 	}
 task_vas_err:
 task_kstack_err:
-	kfree(task->context);
+	slab_free(context_cache, task->context);
 task_context_err:
-	kfree(task);
+	slab_free(task_cache, task);
 task_err:
 	return NULL;
 }
 
+/**
+ * @brief Create a copy of the given user space task (fork)
+ *
+ * The copy gets a copy-on-write copy of the current address space (the one of
+ * the given task), the same mappings and executable, and its own descriptors
+ * referring to the same open files. Its context is the one saved for the
+ * given task. The copy is a child of the given task.
+ *
+ * @param parent The task to copy (the running task)
+ *
+ * @return The new task (in the TASK_READY state), NULL if error occured
+ */
+struct task_struct *fork_task(struct task_struct *parent) {
+	struct task_struct *task = slab_alloc(task_cache);
+
+	if (task == NULL) {
+		printk("out of memory\n");
+		return NULL;
+	}
+
+	*task = *parent;
+	task->kstack = NULL;
+	task->task_id = next_available_task_id++;
+	task->state = TASK_READY;
+	task->argc = 0;
+	task->argv = NULL;
+	task->vas = NULL;
+	task->maps = NULL;
+	task->run_time = 0;
+	task->sleep_time = 0;
+	task->files = NULL;
+	task->exec_inode = NULL;
+	task->parent = NULL;
+	task->children = NULL;
+	task->sibling = NULL;
+	task->exited = NULL;
+	task->wait_pid = 0;
+	task->exit_code = 0;
+	task->shell_task = 0;
+
+	task->context = slab_alloc(context_cache);
+
+	if (task->context == NULL) {
+		goto err;
+	}
+
+	*task->context = *parent->context;
+
+	if (parent->argv != NULL) {
+		task->argv = kmalloc(sizeof(char *) * parent->argc);
+
+		if (task->argv == NULL) {
+			goto err;
+		}
+	}
+
+	for (int i = 0; i < parent->argc; i++) {
+		task->argv[i] = kmalloc(sizeof(char) * MAX_PARAM_SIZE);
+
+		if (task->argv[i] == NULL) {
+			goto err;
+		}
+
+		strcpy(task->argv[i], parent->argv[i]);
+		task->argc++;
+	}
+
+	struct mapping **link = &task->maps;
+
+	for (struct mapping *map = parent->maps; map != NULL; map = map->next) {
+		*link = slab_alloc(mapping_cache);
+
+		if (*link == NULL) {
+			goto err;
+		}
+
+		**link = *map;
+		(*link)->next = NULL;
+		link = &(*link)->next;
+	}
+
+	if (parent->files != NULL) {
+		task->files = fd_table_copy(parent->files);
+
+		if (task->files == NULL) {
+			goto err;
+		}
+	}
+
+	// the segments not touched yet are filled from the same executable
+	if (parent->exec_inode != NULL) {
+		if (elf_text_get(parent->exec_inode)) {
+			goto err;
+		}
+
+		task->exec_inode = parent->exec_inode;
+		task->exec_inode->reference_number++;
+	}
+
+	task->vas = clone_address_space();
+
+	if (task->vas == NULL) {
+		goto err;
+	}
+
+	task->parent = parent;
+	task->sibling = parent->children;
+	parent->children = task;
+
+	return task;
+
+err:
+	printk("out of memory\n");
+
+	if (task->exec_inode != NULL) {
+		elf_text_put(task->exec_inode);
+		vfs_iput(task->exec_inode);
+	}
+
+	destroy_task(task);
+	return NULL;
+}
+
+/**
+ * @brief Report the exit of the task to its parent and orphan its children
+ *
+ * The exit is recorded for the parent, which is woken up if it waits for the
+ * task.
+ *
+ * @param task The task that exits
+ */
+static void task_exit_notify(struct task_struct *task) {
+	struct task_exit *record = task->exited, *next;
+
+	// nobody waits for the children any more
+	for (struct task_struct *child = task->children; child != NULL;
+		 child = child->sibling) {
+		child->parent = NULL;
+	}
+
+	while (record != NULL) {
+		next = record->next;
+		kfree(record);
+		record = next;
+	}
+
+	struct task_struct *parent = task->parent;
+
+	if (parent == NULL) {
+		return;
+	}
+
+	struct task_struct **link = &parent->children;
+
+	while (*link != task) {
+		link = &(*link)->sibling;
+	}
+
+	*link = task->sibling;
+
+	record = kmalloc(sizeof(struct task_exit));
+
+	if (record != NULL) {
+		record->task_id = task->task_id;
+		record->exit_code = task->exit_code;
+		record->next = parent->exited;
+		parent->exited = record;
+	} else {
+		printk("out of memory\n");
+	}
+
+	// the parent restarts waitpid() and finds the exit
+	if (parent->state == TASK_BLOCKED &&
+		(parent->wait_pid == -1 ||
+		 (uint32_t) parent->wait_pid == task->task_id)) {
+		parent->wait_pid = 0;
+		parent->state = TASK_READY;
+		enqueue_task(parent);
+	}
+}
+
+/**
+ * @brief Collect the exit of a child of the task
+ *
+ * @param task		The task
+ * @param pid		The child (-1 for any child)
+ * @param exit_code	Set to the exit code of the child
+ *
+ * @return The pid of the child that exited, 0 if the child did not exit yet,
+ * -1 if the task has no such child
+ */
+int task_reap_child(struct task_struct *task, int pid, int *exit_code) {
+	struct task_exit **link = &task->exited;
+
+	for (; *link != NULL; link = &(*link)->next) {
+		if (pid == -1 || (uint32_t) pid == (*link)->task_id) {
+			struct task_exit *record = *link;
+
+			pid = record->task_id;
+			*exit_code = record->exit_code;
+			*link = record->next;
+			kfree(record);
+
+			return pid;
+		}
+	}
+
+	for (struct task_struct *child = task->children; child != NULL;
+		 child = child->sibling) {
+		if (pid == -1 || (uint32_t) pid == child->task_id) {
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
 /**
  * @brief Free memory for the given task from the kernel heap
  *
  * This function frees all memory allocated on the kernel heap used
- * for the given task.
+ * for the given task. The record of a forked task is reported to its parent.
  *
  * @param task The task
  */
 void destroy_task(struct task_struct *task) {
+	task_exit_notify(task);
+
 	// free memory used for maps
 	struct mapping *tmp = task->maps, *tmp2;
 
 	while (tmp != NULL) {
 		tmp2 = tmp;
 		tmp = (struct mapping *) tmp->next;
-		kfree(tmp2);
+		slab_free(mapping_cache, tmp2);
 	}
 
+	// close the files left open
+	fd_table_destroy(task);
+
 	for (int i = 0; i < task->argc; i++) {
 		kfree(task->argv[i]);
 	}
 
 	kfree(task->argv);
-	kfree(task->context);
-	kfree(task);
+	slab_free(context_cache, task->context);
+	slab_free(task_cache, task);
 }
 
 // function called at the end of a kernel task
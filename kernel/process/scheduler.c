@@ -6,6 +6,7 @@
 #include <kernel/string.h>
 #include <kernel/tty.h>
 #include <mm/kmalloc.h>
+#include <mm/pagezero.h>
 #include <mm/vmm.h>
 #include <process/process.h>
 #include <process/scheduler.h>
@@ -17,6 +18,7 @@ struct embedded_link task_queue;
 // sleeping task queue
 struct embedded_link sleep_task_dqueue;
 struct task_struct *current_running_task;
+extern struct page_directory *current_page_directory;
 uint8_t scheduler_initialized = 0;
 
 #ifdef CONFIG_RR_TIME_QUANTUM
@@ -26,20 +28,17 @@ const uint32_t running_time_quantum_ms = CONFIG_RR_TIME_QUANTUM;
 /**
  * @brief Put task in task queue
  *
- * This function puts the given task in the task queue:
+ * This function puts the given task in the task queue (the node is part of
+ * the task, so this cannot fail):
  *
  * @param task			The task to be put in the queue
  */
 void enqueue_task(struct task_struct *task) {
-	struct task_node *new_node;
+	struct task_node *new_node = &task->run_node;
 
-	new_node = kmalloc(sizeof(struct task_node));
+	new_node->task = task;
 
-	if (new_node != NULL) {
-		new_node->task = task;
-
-		list_add_end(&task_queue, &new_node->list);
-	}
+	list_add_end(&task_queue, &new_node->list);
 }
 
 /**
@@ -62,7 +61,6 @@ struct task_struct *dequeue_task(void) {
 	task = first_node->task;
 
 	list_delete(&task_queue, task_queue.next);
-	kfree(first_node);
 
 	return task;
 }
@@ -166,7 +164,6 @@ struct task_struct *dq_dequeue(struct embedded_link *delta_queue_h) {
 		get_container(delta_queue_h->next, struct delta_queue_node, list);
 	struct task_struct *ts = dqn->task;
 	list_delete(delta_queue_h, delta_queue_h->next);
-	kfree(dqn);
 
 	return ts;
 }
@@ -178,15 +175,11 @@ struct task_struct *dq_dequeue(struct embedded_link *delta_queue_h) {
  * @param ts				task struct to add
  */
 void dq_enqueue(struct embedded_link *delta_queue_h, struct task_struct *ts) {
-	struct delta_queue_node *new_dqn = kmalloc(sizeof(struct delta_queue_node));
+	struct delta_queue_node *new_dqn = &ts->sleep_node;
 	struct delta_queue_node *dqn;
 	struct embedded_link *cursor;
 	int wakeup_time = ts->sleep_time;
 
-	if (!new_dqn) {
-		return;
-	}
-
 	new_dqn->task = ts;
 	new_dqn->delta_time_ms = ts->sleep_time;
 
@@ -258,6 +251,12 @@ void init_task_func(int argc, char *argv[]) {
 	printk("init process started!\n");
 #endif
 	while (1) {
+#ifdef CONFIG_PAGE_ZERO
+		// no other task is ready to run: zero the freed blocks
+		if (list_is_empty(&task_queue)) {
+			pagezero_idle();
+		}
+#endif
 		__asm__ __volatile__("sti; hlt; cli");
 	}
 }
@@ -504,7 +503,8 @@ void resume_context(struct interrupt_regs *r, TASK_SWITCH_STACK_PROBLEM prob) {
  * This function puts the current running task in the specified queue
  * (if the task is not terminated), takes a task from the running queue
  * and updates the current running task with the new task. The function
- * also changes the virtual address space if the new task runs in user space.
+ * also changes the virtual address space if the new task runs in user space
+ * (and its address space is not the current one already).
  *
  * @param queue_type	Queue where to put the current_running_task
  */
@@ -523,11 +523,12 @@ void schedule(QUEUE_TYPE queue_type) {
 	struct task_struct *task = dequeue_task();
 	current_running_task = task;
 
-	// change virtual address space for user tasks
-	if (task->vas != NULL) {
+	// change virtual address space for user tasks; kernel tasks only use the
+	// kernel mappings, which are the same in every address space (the kernel
+	// page tables are created at boot and shared), so they run in the current
+	// one (no CR3 reload, no TLB flush)
+	if (task->vas != NULL && task->vas != current_page_directory) {
 		set_page_directory(task->vas);
-	} else {
-		set_kernel_page_directory();
 	}
 }
 
@@ -1,13 +1,17 @@
 #include <arch/i386/pit.h>
 #include <arch/i386/rtc.h>
+#include <arch/i386/serial.h>
+#include <disk/bcache.h>
 #include <kernel/elf.h>
 #include <kernel/fs.h>
 #include <kernel/keyboard.h>
 #include <kernel/shell.h>
 #include <kernel/string.h>
 #include <kernel/tty.h>
+#include <kernel/vfs.h>
 #include <mm/kmalloc.h>
 #include <mm/pmm.h>
+#include <mm/slab.h>
 #include <process/process.h>
 #include <process/scheduler.h>
 
@@ -71,12 +75,16 @@ void show_available_commands(void) {
 		   "function\n");
 	printk("\tuptime\t - display the uptime in milliseconds\n");
 	printk("\tpmeminfo - display information about the physical memory\n");
+	printk("\tslabinfo - display statistics of the kernel object caches\n");
 #ifdef CONFIG_RTC
 	printk("\tdatetime - display current date and time\n");
 #endif
 	printk("\tdl\t\t - display information about the disk layout (from the "
 		   "superblock)\n");
-	printk("\tls\t\t - list the contents of the current directory\n");
+	printk("\tls [dir] - list the contents of the (current) directory\n");
+	printk("\tbcache\t - display block cache statistics\n");
+	printk("\tkheap stats [serial] - display kernel heap statistics (and "
+		   "send them to COM1)\n");
 #ifndef CONFIG_FCFS_SCH
 	printk("\tps\t\t - print processes in the scheduler's task queue\n");
 #endif
@@ -128,6 +136,8 @@ void shell_exec_command(char *command) {
 		printk("%d\n", get_uptime());
 	} else if (strcmp(command, "pmeminfo") == 0) {
 		print_phymem_info();
+	} else if (strcmp(command, "slabinfo") == 0) {
+		slab_print_info();
 	}
 #ifdef CONFIG_RTC
 	else if (strcmp(command, "datetime") == 0) {
@@ -136,8 +146,12 @@ void shell_exec_command(char *command) {
 #endif
 	else if (strcmp(command, "dl") == 0) {
 		print_superblock_info();
+	} else if (strcmp(command, "bcache") == 0) {
+		bcache_print_stats();
 	} else if (strcmp(command, "ls") == 0) {
-		fs_print_dir();
+		vfs_print_dir(vfs_get_cwd());
+	} else if (strncmp(command, "ls ", 3) == 0) {
+		vfs_print_dir(command + 3);
 	} else if (strncmp(command, "./", 2) == 0) {
 		// TODO: parse command into argvs
 		int number_params = nr_params(command);
@@ -181,6 +195,7 @@ void shell_exec_command(char *command) {
 		if (new_task == NULL) {
 			printk("task is NULL\n");
 		} else {
+			new_task->shell_task = 1;
 			enqueue_task(new_task);
 		}
 
@@ -204,6 +219,16 @@ void shell_exec_command(char *command) {
 		show_available_commands();
 	} else if (strcmp(command, "kheap") == 0) {
 		kmalloc_print_list();
+	} else if (strcmp(command, "kheap stats") == 0) {
+		kmalloc_print_stats();
+	} else if (strcmp(command, "kheap stats serial") == 0) {
+		if (!serial_present) {
+			printk("no serial port\n");
+		} else {
+			serial_mirror = 1;
+			kmalloc_print_stats();
+			serial_mirror = 0;
+		}
 	} else if (strcmp(command, "kheap1") == 0) {
 		kmalloc_allocate();
 	} else if (strcmp(command, "kheap2") == 0) {
@@ -251,7 +276,7 @@ void shell_scancode(uint8_t scancode) {
 
 /* for now, the initialization only prints the prompt */
 void shell_init() {
-	printk("%s > ", get_current_path());
+	printk("%s > ", vfs_get_cwd());
 }
 
 void shell_cleanup(void) {
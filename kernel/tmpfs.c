@@ -0,0 +1,309 @@
+#include <kernel/string.h>
+#include <kernel/tmpfs.h>
+#include <kernel/tty.h>
+#include <kernel/vfs.h>
+#include <mm/kmalloc.h>
+
+#include <stddef.h>
+
+struct vfs_super_operations tmpfs_super_ops = {
+	.read_inode = tmpfs_read_inode,
+	.put_inode = tmpfs_put_inode,
+};
+
+struct vfs_inode_operations tmpfs_inode_ops = {
+	.lookup = tmpfs_lookup,
+	.create = tmpfs_create_file,
+	.unlink = tmpfs_unlink,
+	.readdir = tmpfs_readdir,
+};
+
+struct vfs_file_operations tmpfs_file_ops = {
+	.open = NULL,
+	.read = tmpfs_read,
+	.write = tmpfs_write,
+	.read_block = NULL,
+};
+
+/**
+ * @brief Get the node of the given in-memory inode
+ */
+struct tmpfs_node *tmpfs_get_node(struct vfs_inode *inode) {
+	return (struct tmpfs_node *) inode->sb->private + inode->id;
+}
+
+/**
+ * @brief Search a directory for the given name
+ *
+ * @param nodes		The nodes of the tmpfs
+ * @param dir_id	Id of the directory
+ * @param name		Name of the file (not null terminated)
+ * @param len		Length of the name
+ *
+ * @return Id of the file, 0 if not found
+ */
+uint32_t tmpfs_find(struct tmpfs_node *nodes, uint32_t dir_id, const char *name,
+					size_t len) {
+	if (len >= VFS_NAME_LENGTH) {
+		return 0;
+	}
+
+	for (uint32_t i = TMPFS_ROOT_ID + 1; i < TMPFS_MAX_NODES; i++) {
+		struct tmpfs_node *node = nodes + i;
+
+		if (node->flags != TMPFS_NODE_USED || node->parent != dir_id) {
+			continue;
+		}
+
+		if (strncmp(node->name, name, len) == 0 && node->name[len] == '\0') {
+			return i;
+		}
+	}
+
+	return 0;
+}
+
+uint8_t tmpfs_read_inode(struct vfs_inode *inode) {
+	if (inode->id == 0 || inode->id >= TMPFS_MAX_NODES) {
+		return 1;
+	}
+
+	struct tmpfs_node *node = tmpfs_get_node(inode);
+
+	if (!(node->flags & TMPFS_NODE_USED)) {
+		return 1;
+	}
+
+	inode->type = node->type;
+	inode->size = node->size;
+	inode->datetime = node->datetime;
+	inode->address = node->data;
+	inode->i_op = &tmpfs_inode_ops;
+	inode->f_op = &tmpfs_file_ops;
+
+	return 0;
+}
+
+/**
+ * @brief Release a node that was removed while it was in use
+ */
+void tmpfs_put_inode(struct vfs_inode *inode) {
+	struct tmpfs_node *node = tmpfs_get_node(inode);
+
+	if (node->flags & TMPFS_NODE_UNLINKED) {
+		kfree(node->data);
+		*node = (struct tmpfs_node) {0};
+	}
+}
+
+uint32_t tmpfs_lookup(struct vfs_inode *dir, const char *name, size_t len) {
+	return tmpfs_find(dir->sb->private, dir->id, name, len);
+}
+
+uint32_t tmpfs_create_file(struct vfs_inode *dir, const char *name, size_t len,
+						   uint8_t type) {
+	struct tmpfs_node *nodes = dir->sb->private;
+
+	if (len == 0 || len >= VFS_NAME_LENGTH ||
+		tmpfs_find(nodes, dir->id, name, len) != 0) {
+		return 0;
+	}
+
+	for (uint32_t i = TMPFS_ROOT_ID + 1; i < TMPFS_MAX_NODES; i++) {
+		struct tmpfs_node *node = nodes + i;
+
+		if (node->flags != 0) {
+			continue;
+		}
+
+		*node = (struct tmpfs_node) {0};
+		node->flags = TMPFS_NODE_USED;
+		node->type = type;
+		node->parent = dir->id;
+		memcpy(node->name, name, len);
+		node->name[len] = '\0';
+
+		return i;
+	}
+
+	printk("limit of tmpfs files reached: %d!\n", TMPFS_MAX_NODES);
+	return 0;
+}
+
+/**
+ * @brief Remove a file from the directory
+ *
+ * The node is only marked as removed, its data is released when the last
+ * reference to its in-memory inode is dropped (the VFS holds one during the
+ * call).
+ */
+uint8_t tmpfs_unlink(struct vfs_inode *dir, const char *name, size_t len) {
+	struct tmpfs_node *nodes = dir->sb->private;
+	uint32_t id = tmpfs_find(nodes, dir->id, name, len);
+
+	if (id == 0) {
+		return 1;
+	}
+
+	// only empty directories can be removed
+	if (nodes[id].type == FILETYPE_DIR) {
+		for (uint32_t i = TMPFS_ROOT_ID + 1; i < TMPFS_MAX_NODES; i++) {
+			if (nodes[i].flags == TMPFS_NODE_USED && nodes[i].parent == id) {
+				return 1;
+			}
+		}
+	}
+
+	nodes[id].flags |= TMPFS_NODE_UNLINKED;
+
+	return 0;
+}
+
+int32_t tmpfs_readdir(struct vfs_inode *dir, uint32_t index,
+					  struct vfs_dirent *dirent) {
+	struct tmpfs_node *nodes = dir->sb->private;
+
+	for (uint32_t i = index; i < TMPFS_MAX_NODES; i++) {
+		struct tmpfs_node *node = nodes + i;
+
+		if (i == TMPFS_ROOT_ID || node->flags != TMPFS_NODE_USED ||
+			node->parent != dir->id) {
+			continue;
+		}
+
+		dirent->id = i;
+		dirent->type = node->type;
+		dirent->size = node->size;
+		dirent->datetime = node->datetime;
+		strcpy(dirent->name, node->name);
+
+		return i + 1;
+	}
+
+	return -1;
+}
+
+size_t tmpfs_read(struct vfs_inode *inode, void *buf, size_t count,
+				  uint32_t offset) {
+	if (offset >= inode->size || count == 0) {
+		return 0;
+	}
+
+	// do not read past the end of the file
+	if (count > inode->size - offset) {
+		count = inode->size - offset;
+	}
+
+	memcpy(buf, (void *) inode->address + offset, count);
+
+	return count;
+}
+
+/**
+ * @brief Write to a tmpfs file
+ *
+ * The data buffer grows (at least doubling) when the write goes past its end,
+ * bytes between the old end of the file and the offset are zeroed. Files are
+ * limited to TMPFS_MAX_FILE_SIZE bytes.
+ */
+size_t tmpfs_write(struct vfs_inode *inode, const void *buf, size_t count,
+				   uint32_t offset) {
+	struct tmpfs_node *node = tmpfs_get_node(inode);
+	uint32_t end = offset + count;
+
+	if (count == 0) {
+		return 0;
+	}
+
+	// the check on end also catches the overflow of offset + count
+	if (end < offset || end > TMPFS_MAX_FILE_SIZE) {
+		return -1;
+	}
+
+	if (end > node->capacity) {
+		uint32_t capacity =
+			node->capacity < TMPFS_MIN_CAPACITY ? TMPFS_MIN_CAPACITY
+												: node->capacity;
+
+		while (capacity < end) {
+			// don't let the doubling overflow
+			if (capacity > end / 2) {
+				capacity = end;
+				break;
+			}
+
+			capacity *= 2;
+		}
+
+		void *data = kmalloc(capacity);
+
+		if (data == NULL) {
+			printk("out of memory\n");
+			return -1;
+		}
+
+		if (node->data != NULL) {
+			memcpy(data, node->data, node->size);
+			kfree(node->data);
+		}
+
+		node->data = data;
+		node->capacity = capacity;
+		inode->address = data;
+	}
+
+	if (offset > node->size) {
+		memset(node->data + node->size, 0, offset - node->size);
+	}
+
+	memcpy(node->data + offset, buf, count);
+
+	if (end > node->size) {
+		node->size = end;
+		inode->size = end;
+	}
+
+	return count;
+}
+
+/**
+ * @brief Create an empty tmpfs
+ *
+ * The file system contains only the root directory. Files are kept entirely
+ * in kernel memory.
+ *
+ * @return The superblock of the new file system, NULL if error occured
+ */
+struct vfs_superblock *tmpfs_create(void) {
+	struct vfs_superblock *sb = kmalloc(sizeof(struct vfs_superblock));
+
+	if (sb == NULL) {
+		printk("out of memory\n");
+		return NULL;
+	}
+
+	struct tmpfs_node *nodes =
+		kmalloc(sizeof(struct tmpfs_node) * TMPFS_MAX_NODES);
+
+	if (nodes == NULL) {
+		printk("out of memory\n");
+		kfree(sb);
+		return NULL;
+	}
+
+	memset(nodes, 0, sizeof(struct tmpfs_node) * TMPFS_MAX_NODES);
+
+	nodes[TMPFS_ROOT_ID].flags = TMPFS_NODE_USED;
+	nodes[TMPFS_ROOT_ID].type = FILETYPE_DIR;
+	nodes[TMPFS_ROOT_ID].parent = TMPFS_ROOT_ID;
+
+	sb->name = "tmpfs";
+	sb->flags = 0;
+	sb->root_id = TMPFS_ROOT_ID;
+	sb->s_op = &tmpfs_super_ops;
+	sb->private = nodes;
+
+	return sb;
+}
+
+
@@ -0,0 +1,644 @@
+#include <kernel/fs.h>
+#include <kernel/string.h>
+#include <kernel/tmpfs.h>
+#include <kernel/tty.h>
+#include <kernel/utils.h>
+#include <kernel/vfs.h>
+#include <mm/kmalloc.h>
+#include <mm/slab.h>
+
+#include <stddef.h>
+
+struct vfs_mount mount_table[VFS_MAX_MOUNTS];
+struct slab_cache *vfs_inode_cache;
+struct vfs_inode *vfs_inodes[VFS_INODE_BUCKETS]; // in-memory inodes in use
+char current_path[MAX_PATH_LENGTH];
+
+/**
+ * @brief Initialize the virtual file system
+ *
+ * This function creates the cache of in-memory inodes, mounts the on-disk
+ * file system at "/" and a tmpfs at "/tmp". The current directory is set to
+ * the root directory. The on-disk file system has to be initialized before.
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t vfs_init(void) {
+	vfs_inode_cache =
+		slab_cache_create("vfs_inode", sizeof(struct vfs_inode), NULL);
+
+	if (vfs_inode_cache == NULL) {
+		printk("out of memory\n");
+		return 1;
+	}
+
+	memset(vfs_inodes, 0, sizeof(vfs_inodes));
+	memset(mount_table, 0, sizeof(mount_table));
+
+	strcpy(current_path, "/"); // initial path is the root direcotry
+
+	if (vfs_mount("/", diskfs_get_superblock())) {
+		return 1;
+	}
+
+	struct vfs_superblock *tmpfs = tmpfs_create();
+
+	if (tmpfs == NULL || vfs_mount("/tmp", tmpfs)) {
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Mount a file system
+ *
+ * @param path	Path of the mount point
+ * @param sb	Superblock of the file system
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t vfs_mount(const char *path, struct vfs_superblock *sb) {
+	char normalized[MAX_PATH_LENGTH];
+	struct vfs_mount *free_entry = NULL;
+
+	if (sb == NULL || vfs_normalize_path(path, normalized)) {
+		return 1;
+	}
+
+	if (strlen(normalized) >= VFS_MOUNT_PATH_LEN) {
+		printk("mount path too long: %s\n", normalized);
+		return 1;
+	}
+
+	for (int i = 0; i < VFS_MAX_MOUNTS; i++) {
+		if (mount_table[i].sb == NULL) {
+			if (free_entry == NULL) {
+				free_entry = mount_table + i;
+			}
+		} else if (strcmp(mount_table[i].path, normalized) == 0) {
+			printk("%s is already a mount point\n", normalized);
+			return 1;
+		}
+	}
+
+	if (free_entry == NULL) {
+		printk("limit of mount points reached: %d!\n", VFS_MAX_MOUNTS);
+		return 1;
+	}
+
+	strcpy(free_entry->path, normalized);
+	free_entry->path_len = strlen(normalized);
+	free_entry->sb = sb;
+
+	return 0;
+}
+
+/**
+ * @brief Get the bucket of the in-memory inode of a file
+ */
+static inline uint32_t vfs_inode_bucket(struct vfs_superblock *sb,
+										uint32_t id) {
+	return (((uint32_t) sb >> 4) ^ id) & (VFS_INODE_BUCKETS - 1);
+}
+
+/**
+ * @brief Get the in-memory inode of a file
+ *
+ * If the file (same superblock and id) already has an in-memory inode, its
+ * reference number is incremented and it is returned, so it is shared with
+ * the other users. Otherwise, a new one is allocated from the inode cache and
+ * filled by the file system.
+ *
+ * @param sb	Superblock of the file system
+ * @param id	Inode id inside the file system
+ *
+ * @return The in-memory inode, NULL if error occured
+ */
+struct vfs_inode *vfs_iget(struct vfs_superblock *sb, uint32_t id) {
+	uint32_t bucket = vfs_inode_bucket(sb, id);
+	struct vfs_inode *inode;
+
+	for (inode = vfs_inodes[bucket]; inode != NULL; inode = inode->next) {
+		if (inode->sb == sb && inode->id == id) {
+			inode->reference_number++;
+			return inode;
+		}
+	}
+
+	inode = slab_alloc(vfs_inode_cache);
+
+	if (inode == NULL) {
+		printk("out of memory\n");
+		return NULL;
+	}
+
+	*inode = (struct vfs_inode) {0};
+	inode->id = id;
+	inode->sb = sb;
+
+	if (sb->s_op->read_inode(inode)) {
+		slab_free(vfs_inode_cache, inode);
+		return NULL;
+	}
+
+	inode->reference_number = 1;
+	inode->next = vfs_inodes[bucket];
+	vfs_inodes[bucket] = inode;
+
+	return inode;
+}
+
+/**
+ * @brief Release an in-memory inode
+ *
+ * When the last reference is dropped, the file system is notified and the
+ * inode is freed.
+ *
+ * @param inode The in-memory inode
+ */
+void vfs_iput(struct vfs_inode *inode) {
+	if (inode == NULL || inode->reference_number == 0) {
+		return;
+	}
+
+	inode->reference_number--;
+
+	if (inode->reference_number == 0) {
+		struct vfs_inode **link =
+			&vfs_inodes[vfs_inode_bucket(inode->sb, inode->id)];
+
+		while (*link != inode) {
+			link = &(*link)->next;
+		}
+
+		*link = inode->next;
+
+		if (inode->sb->s_op->put_inode != NULL) {
+			inode->sb->s_op->put_inode(inode);
+		}
+
+		slab_free(vfs_inode_cache, inode);
+	}
+}
+
+/**
+ * @brief Build the absolute path without "." and ".." components
+ *
+ * Relative paths start from the current directory.
+ *
+ * @param path	The path
+ * @param out	Buffer of MAX_PATH_LENGTH bytes for the result
+ *
+ * @return 1 if the result is too long, 0 otherwise
+ */
+uint8_t vfs_normalize_path(const char *path, char *out) {
+	size_t len = 0;
+
+	out[len++] = '/';
+	out[len] = '\0';
+
+	// relative paths are resolved after the current path
+	for (int step = (path[0] == '/') ? 1 : 0; step < 2; step++) {
+		const char *character = (step == 0) ? current_path : path;
+
+		while (*character != '\0') {
+			if (*character == '/') {
+				character++;
+				continue;
+			}
+
+			const char *name = character;
+
+			while (*character != '/' && *character != '\0') {
+				character++;
+			}
+
+			size_t name_len = character - name;
+
+			if (name_len == 1 && name[0] == '.') {
+				continue;
+			}
+
+			if (name_len == 2 && name[0] == '.' && name[1] == '.') {
+				// remove the last component (the parent of root is root)
+				while (len > 1 && out[len - 1] != '/') {
+					len--;
+				}
+
+				if (len > 1) {
+					len--;
+				}
+
+				out[len] = '\0';
+				continue;
+			}
+
+			if (len + name_len + 2 > MAX_PATH_LENGTH) {
+				return 1;
+			}
+
+			if (len > 1) {
+				out[len++] = '/';
+			}
+
+			memcpy(out + len, name, name_len);
+			len += name_len;
+			out[len] = '\0';
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Find the file system of a normalized path
+ *
+ * The mount point with the longest path that is a prefix of the given path is
+ * chosen.
+ *
+ * @param path	Normalized path
+ * @param rest	Set to the part of the path inside the file system
+ *
+ * @return The mount point, NULL if there is none
+ */
+struct vfs_mount *vfs_find_mount(const char *path, const char **rest) {
+	struct vfs_mount *result = NULL;
+
+	for (int i = 0; i < VFS_MAX_MOUNTS; i++) {
+		struct vfs_mount *mount = mount_table + i;
+
+		if (mount->sb == NULL ||
+			strncmp(path, mount->path, mount->path_len) != 0) {
+			continue;
+		}
+
+		// match whole components only ("/tmp" is not a prefix of "/tmpx")
+		if (mount->path_len > 1 && path[mount->path_len] != '/' &&
+			path[mount->path_len] != '\0') {
+			continue;
+		}
+
+		if (result == NULL || mount->path_len > result->path_len) {
+			result = mount;
+		}
+	}
+
+	if (result != NULL) {
+		*rest = path + result->path_len;
+	}
+
+	return result;
+}
+
+/**
+ * @brief Get the in-memory inode of the last file in a normalized path
+ *
+ * @param path Normalized path
+ *
+ * @return The referenced in-memory inode, NULL if not found
+ */
+struct vfs_inode *vfs_walk(const char *path) {
+	const char *character;
+	struct vfs_mount *mount = vfs_find_mount(path, &character);
+
+	if (mount == NULL) {
+		return NULL;
+	}
+
+	struct vfs_inode *inode = vfs_iget(mount->sb, mount->sb->root_id);
+
+	while (inode != NULL && *character != '\0') {
+		if (*character == '/') {
+			character++;
+			continue;
+		}
+
+		const char *name = character;
+
+		while (*character != '/' && *character != '\0') {
+			character++;
+		}
+
+		if (inode->type != FILETYPE_DIR || inode->i_op->lookup == NULL) {
+			vfs_iput(inode);
+			return NULL;
+		}
+
+		uint32_t id = inode->i_op->lookup(inode, name, character - name);
+		struct vfs_superblock *sb = inode->sb;
+
+		vfs_iput(inode);
+
+		if (id == 0) {
+			return NULL;
+		}
+
+		inode = vfs_iget(sb, id);
+	}
+
+	return inode;
+}
+
+/**
+ * @brief Get the in-memory inode of the last file in the given path
+ *
+ * @param path	Path, absolute or relative to the current directory
+ * @param type	Type of the requested file (FILETYPE_FILE or FILETYPE_DIR)
+ *
+ * @return The referenced in-memory inode, NULL if not found or of another type
+ */
+struct vfs_inode *vfs_lookup(const char *path, uint8_t type) {
+	char normalized[MAX_PATH_LENGTH];
+
+	if (vfs_normalize_path(path, normalized)) {
+		return NULL;
+	}
+
+	struct vfs_inode *inode = vfs_walk(normalized);
+
+	if (inode != NULL && inode->type != type) {
+		vfs_iput(inode);
+		return NULL;
+	}
+
+	return inode;
+}
+
+/**
+ * @brief Get the parent directory of the last file in a normalized path
+ *
+ * @param path	Normalized path
+ * @param name	Set to the name of the last file (inside path)
+ *
+ * @return The referenced in-memory inode of the directory, NULL if error
+ */
+struct vfs_inode *vfs_walk_parent(char *path, char **name) {
+	char *last = strrchr(path, '/');
+
+	// the root directory has no parent
+	if (last[1] == '\0') {
+		return NULL;
+	}
+
+	*name = last + 1;
+
+	// temporarily cut the path at the parent directory
+	*last = '\0';
+
+	struct vfs_inode *parent = vfs_walk(last == path ? "/" : path);
+
+	*last = '/';
+
+	if (parent != NULL && parent->type != FILETYPE_DIR) {
+		vfs_iput(parent);
+		return NULL;
+	}
+
+	return parent;
+}
+
+/**
+ * @brief Open the file at the given path
+ *
+ * With O_DIRECTORY, the path has to be a directory. With O_CREAT, a regular
+ * file that doesn't exist is created, if its file system supports it.
+ *
+ * @param path	Path, absolute or relative to the current directory
+ * @param flags	OPEN_FLAGS
+ *
+ * @return The referenced in-memory inode, NULL if error occured
+ */
+struct vfs_inode *vfs_open(const char *path, uint32_t flags) {
+	uint8_t type = (flags & O_DIRECTORY) ? FILETYPE_DIR : FILETYPE_FILE;
+	char normalized[MAX_PATH_LENGTH];
+
+	if (vfs_normalize_path(path, normalized)) {
+		return NULL;
+	}
+
+	struct vfs_inode *inode = vfs_walk(normalized);
+
+	if (inode != NULL && inode->type != type) {
+		vfs_iput(inode);
+		return NULL;
+	}
+
+	if (inode == NULL && (flags & O_CREAT) && type == FILETYPE_FILE) {
+		char *name;
+		struct vfs_inode *parent = vfs_walk_parent(normalized, &name);
+
+		if (parent == NULL) {
+			return NULL;
+		}
+
+		if ((parent->sb->flags & VFS_MOUNT_RDONLY) ||
+			parent->i_op->create == NULL) {
+			printk("%s: files cannot be created on %s\n", normalized,
+				   parent->sb->name);
+		} else {
+			uint32_t id =
+				parent->i_op->create(parent, name, strlen(name), FILETYPE_FILE);
+
+			if (id != 0) {
+				inode = vfs_iget(parent->sb, id);
+			}
+		}
+
+		vfs_iput(parent);
+	}
+
+	if (inode == NULL) {
+		return NULL;
+	}
+
+	if (inode->f_op->open != NULL && inode->f_op->open(inode)) {
+		vfs_iput(inode);
+		return NULL;
+	}
+
+	return inode;
+}
+
+/**
+ * @brief Remove the file at the given path
+ *
+ * The file's data is released by the file system when the last user of the
+ * in-memory inode drops its reference.
+ *
+ * @param path Path, absolute or relative to the current directory
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t vfs_unlink(const char *path) {
+	char normalized[MAX_PATH_LENGTH];
+	const char *rest;
+	char *name;
+	uint8_t ret = 1;
+
+	if (vfs_normalize_path(path, normalized)) {
+		return 1;
+	}
+
+	// mount points cannot be removed
+	struct vfs_mount *mount = vfs_find_mount(normalized, &rest);
+
+	if (mount == NULL || *rest == '\0') {
+		return 1;
+	}
+
+	struct vfs_inode *parent = vfs_walk_parent(normalized, &name);
+
+	if (parent == NULL) {
+		return 1;
+	}
+
+	if ((parent->sb->flags & VFS_MOUNT_RDONLY) ||
+		parent->i_op->unlink == NULL) {
+		goto out;
+	}
+
+	size_t name_len = strlen(name);
+	uint32_t id = parent->i_op->lookup(parent, name, name_len);
+
+	if (id == 0) {
+		goto out;
+	}
+
+	// hold the inode so the file system releases it when it is not used
+	struct vfs_inode *inode = vfs_iget(parent->sb, id);
+
+	if (inode == NULL) {
+		goto out;
+	}
+
+	ret = parent->i_op->unlink(parent, name, name_len);
+	vfs_iput(inode);
+
+out:
+	vfs_iput(parent);
+	return ret;
+}
+
+/**
+ * @brief Read from a file
+ *
+ * @param inode		The in-memory inode
+ * @param buf		Destination buffer
+ * @param count		Number of bytes to read
+ * @param offset	Offset in the file
+ *
+ * @return Number of bytes read (0 at end of file), or -1 if error
+ */
+size_t vfs_read(struct vfs_inode *inode, void *buf, size_t count,
+				uint32_t offset) {
+	if (inode->type != FILETYPE_FILE || inode->f_op->read == NULL) {
+		return -1;
+	}
+
+	return inode->f_op->read(inode, buf, count, offset);
+}
+
+/**
+ * @brief Read one block of a file
+ *
+ * Unlike vfs_read(), the file doesn't have to be opened: if its data is not in
+ * memory, the block is read through the file system's block cache. Used to
+ * fill the pages of the executables on demand.
+ *
+ * @param inode		The in-memory inode
+ * @param buf		Destination buffer (FS_BLOCK_SIZE bytes)
+ * @param offset	Offset in the file (multiple of FS_BLOCK_SIZE)
+ *
+ * @return Number of bytes read (0 at end of file), or -1 if error
+ */
+size_t vfs_read_block(struct vfs_inode *inode, void *buf, uint32_t offset) {
+	if (inode->type != FILETYPE_FILE) {
+		return -1;
+	}
+
+	if (inode->address == NULL && inode->f_op->read_block != NULL) {
+		return inode->f_op->read_block(inode, buf, offset);
+	}
+
+	return vfs_read(inode, buf, FS_BLOCK_SIZE, offset);
+}
+
+/**
+ * @brief Write to a file
+ *
+ * @param inode		The in-memory inode
+ * @param buf		Source buffer
+ * @param count		Number of bytes to write
+ * @param offset	Offset in the file
+ *
+ * @return Number of bytes written, or -1 if error
+ */
+size_t vfs_write(struct vfs_inode *inode, const void *buf, size_t count,
+				 uint32_t offset) {
+	if (inode->type != FILETYPE_FILE || inode->f_op->write == NULL ||
+		(inode->sb->flags & VFS_MOUNT_RDONLY)) {
+		return -1;
+	}
+
+	return inode->f_op->write(inode, buf, count, offset);
+}
+
+/**
+ * @brief Read a directory entry
+ *
+ * @param inode		The in-memory inode of the directory
+ * @param index		Index from where to search for the entry
+ * @param dirent	Filled with the found entry
+ *
+ * @return Index of the next entry, -1 if there are no more entries
+ */
+int32_t vfs_readdir(struct vfs_inode *inode, uint32_t index,
+					struct vfs_dirent *dirent) {
+	if (inode->type != FILETYPE_DIR || inode->i_op->readdir == NULL) {
+		return -1;
+	}
+
+	return inode->i_op->readdir(inode, index, dirent);
+}
+
+/**
+ * @brief Print the files in the given directory
+ *
+ * @param path Path, absolute or relative to the current directory
+ *
+ * @return 1 if error occured, 0 otherwise
+ */
+uint8_t vfs_print_dir(const char *path) {
+	struct vfs_inode *dir = vfs_lookup(path, FILETYPE_DIR);
+	struct vfs_dirent dirent;
+	int32_t index = 0;
+
+	if (dir == NULL) {
+		printk("%s: no such directory\n", path);
+		return 1;
+	}
+
+	while ((index = vfs_readdir(dir, index, &dirent)) >= 0) {
+		printk("%s ", dirent.type == FILETYPE_DIR ? "d" : "f");
+		printk(" %d/%d/%d ", dirent.datetime.day, dirent.datetime.month,
+			   dirent.datetime.year);
+		printk(" %d", dirent.size);
+		printk("\t%s\n", dirent.name);
+	}
+
+	vfs_iput(dir);
+
+	return 0;
+}
+
+/**
+ * @brief Return current path in the filesystem
+ *
+ * This function returns the current path starting from the root directory.
+ *
+ * @return Current path starting with "/"
+ */
+char *vfs_get_cwd(void) {
+	return current_path;
+}
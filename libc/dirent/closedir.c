@@ -0,0 +1,21 @@
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * @brief Close the directory stream
+ *
+ * @param   dir     The directory stream
+ *
+ * @return 0 if successful, -1 if error
+ */
+int closedir(DIR *dir) {
+	if (dir == NULL) {
+		return -1;
+	}
+
+	int ret = close(dir->fd);
+	free(dir);
+
+	return ret;
+}
@@ -0,0 +1,25 @@
+#include <dirent.h>
+
+/**
+ * @brief Fill buf with as many entries of the directory as fit
+ *
+ * The directory has to be opened with O_DIRECTORY. Consecutive calls return
+ * the next entries. The arguments are put into EAX, EBX, ECX and ESI in this
+ * order.
+ *
+ * @param   fd      The file descriptor of the directory
+ * @param   buf     The location where to store the entries
+ * @param   count   Size of the buffer in bytes
+ *
+ * @return Number of bytes filled, 0 at the end of the directory, or -1 if error
+ */
+size_t getdents(int fd, void *buf, size_t count) {
+	size_t ret = -1;
+
+	__asm__ __volatile__("int $0x80"
+						 : "=a"(ret)
+						 : "a"(14), "b"(fd), "c"(buf), "S"(count)
+						 : "memory");
+
+	return ret;
+}
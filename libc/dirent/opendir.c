@@ -0,0 +1,31 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * @brief Open a directory stream for the given path
+ *
+ * @param   name    Path of the directory
+ *
+ * @return The directory stream, or NULL if error
+ */
+DIR *opendir(const char *name) {
+	DIR *dir = malloc(sizeof(DIR));
+
+	if (dir == NULL) {
+		return NULL;
+	}
+
+	dir->fd = open(name, O_RDONLY | O_DIRECTORY);
+
+	if (dir->fd < 0) {
+		free(dir);
+		return NULL;
+	}
+
+	dir->pos = 0;
+	dir->len = 0;
+
+	return dir;
+}
@@ -0,0 +1,49 @@
+#include <dirent.h>
+#include <unistd.h>
+
+/**
+ * @brief Return the next entry of the directory stream
+ *
+ * Entries are served from the stream's buffer, a new getdents syscall is
+ * issued only when all the buffered entries were returned.
+ *
+ * @param   dir     The directory stream
+ *
+ * @return The next entry, or NULL at the end of the directory or if error
+ */
+struct dirent *readdir(DIR *dir) {
+	if (dir == NULL) {
+		return NULL;
+	}
+
+	if (dir->pos >= dir->len) {
+		size_t ret = getdents(dir->fd, dir->buf, DIRENT_BUF_SIZE);
+
+		if (ret == 0 || ret == (size_t) -1) {
+			return NULL;
+		}
+
+		dir->pos = 0;
+		dir->len = ret;
+	}
+
+	struct dirent *entry = (struct dirent *) (dir->buf + dir->pos);
+	dir->pos += entry->d_reclen;
+
+	return entry;
+}
+
+/**
+ * @brief Reset the directory stream to the beginning of the directory
+ *
+ * @param   dir     The directory stream
+ */
+void rewinddir(DIR *dir) {
+	if (dir == NULL) {
+		return;
+	}
+
+	lseek(dir->fd, 0, SEEK_SET);
+	dir->pos = 0;
+	dir->len = 0;
+}
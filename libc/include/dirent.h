@@ -0,0 +1,43 @@
+#ifndef _DIRENT_H
+#define _DIRENT_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DT_REG			0 // regular file
+#define DT_DIR			1 // directory
+
+#define DIRENT_BUF_SIZE 4096
+
+// directory entry as filled by the getdents syscall
+struct dirent {
+	uint32_t d_ino;	   // inode id
+	uint32_t d_off;	   // cookie of the next entry
+	uint16_t d_reclen; // length of this record
+	uint8_t d_type;	   // DT_REG or DT_DIR
+	uint32_t d_size;   // size of the file in bytes
+	char d_name[];	   // null terminated file name
+} __attribute__((packed));
+
+// directory stream: entries are fetched one buffer at a time
+typedef struct {
+	int fd;						// file descriptor of the directory
+	size_t pos;					// position of the next entry in buf
+	size_t len;					// number of valid bytes in buf
+	char buf[DIRENT_BUF_SIZE];	// entries returned by getdents
+} DIR;
+
+size_t getdents(int, void *, size_t);
+DIR *opendir(const char *);
+struct dirent *readdir(DIR *);
+void rewinddir(DIR *);
+int closedir(DIR *);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -9,7 +9,8 @@ typedef enum {
 	O_RDONLY = 0x1, // open file only with read permissions
 	O_WRONLY = 0x2, // open file only with write permissions
 	O_RDWR = 0x4,	// open file with read-write permissions
-	O_CREAT = 0x8	// create file if it doesn't exits
+	O_CREAT = 0x8,	// create file if it doesn't exits
+	O_DIRECTORY = 0x10 // open a directory (for getdents)
 } OPEN_FLAGS;
 
 int open(const char *pathname, int flags);
@@ -0,0 +1,21 @@
+#ifndef _SYS_UIO_H
+#define _SYS_UIO_H 1
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct iovec {
+	void *iov_base; // start of the buffer
+	size_t iov_len; // size of the buffer
+};
+
+size_t readv(int, const struct iovec *, int);
+size_t writev(int, const struct iovec *, int);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
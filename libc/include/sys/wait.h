@@ -0,0 +1,13 @@
+#ifndef _SYS_WAIT_H
+#define _SYS_WAIT_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int waitpid(int, int *, int);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -4,5 +4,6 @@
 #include <stdint.h>
 
 void sleep(uint16_t millis);
+uint32_t uptime(void);
 
 #endif
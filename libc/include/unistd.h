@@ -8,9 +8,20 @@
 extern "C" {
 #endif
 
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+typedef int32_t off_t;
+
 int close(int);
 size_t read(int, void *, size_t);
 size_t write(int, const void *, size_t);
+off_t lseek(int, off_t, int);
+size_t pread(int, void *, size_t, off_t);
+size_t pwrite(int, const void *, size_t, off_t);
+int unlink(const char *);
+int fork(void);
 void *sbrk(intptr_t);
 
 #ifdef __cplusplus
@@ -0,0 +1,16 @@
+#include <time.h>
+
+/**
+ * @brief Get the time since boot
+ *
+ * This function performs a syscall, passing in EAX the syscall number.
+ *
+ * @return Number of milliseconds since boot
+ */
+uint32_t uptime(void) {
+	uint32_t ret;
+
+	__asm__ __volatile__("int $0x80" : "=a"(ret) : "a"(16));
+
+	return ret;
+}
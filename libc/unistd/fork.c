@@ -0,0 +1,17 @@
+#include <unistd.h>
+
+/**
+ * @brief Create a copy of the calling process
+ *
+ * The memory of the process is shared with the copy until one of them writes
+ * to it. The syscall number is put into EAX.
+ *
+ * @return The pid of the child in the parent, 0 in the child, or -1 if error
+ */
+int fork(void) {
+	int ret = -1;
+
+	__asm__ __volatile__("int $0x80" : "=a"(ret) : "a"(17) : "memory");
+
+	return ret;
+}
@@ -0,0 +1,23 @@
+#include <unistd.h>
+
+/**
+ * @brief Reposition the offset of the file given through the file descriptor
+ *
+ * The arguments are put into EAX, EBX, ECX and ESI in this order.
+ *
+ * @param   fd      The file descriptor
+ * @param   offset  The new offset, relative to whence
+ * @param   whence  SEEK_SET, SEEK_CUR or SEEK_END
+ *
+ * @return The resulting offset from the beginning of the file, or -1 if error
+ */
+off_t lseek(int fd, off_t offset, int whence) {
+	off_t ret = -1;
+
+	__asm__ __volatile__("int $0x80"
+						 : "=a"(ret)
+						 : "a"(9), "b"(fd), "c"(offset), "S"(whence)
+						 : "memory");
+
+	return ret;
+}
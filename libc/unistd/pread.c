@@ -0,0 +1,26 @@
+#include <unistd.h>
+
+/**
+ * @brief Read count bytes at the given offset of the file given through the
+ * file descriptor
+ *
+ * The offset of the file descriptor is not changed. The arguments are put into
+ * EAX, EBX, ECX, ESI and EDX in this order.
+ *
+ * @param   fd      The file descriptor
+ * @param   buf     The location where to store the bytes read
+ * @param   count   Number of bytes to read
+ * @param   offset  Offset in the file
+ *
+ * @return Number of bytes read, 0 if end of file, or -1 if error
+ */
+size_t pread(int fd, void *buf, size_t count, off_t offset) {
+	size_t bytes_read = -1;
+
+	__asm__ __volatile__("int $0x80"
+						 : "=a"(bytes_read)
+						 : "a"(10), "b"(fd), "c"(buf), "S"(count), "d"(offset)
+						 : "memory");
+
+	return bytes_read;
+}
@@ -0,0 +1,26 @@
+#include <unistd.h>
+
+/**
+ * @brief Write count bytes at the given offset of the file given through the
+ * file descriptor
+ *
+ * The offset of the file descriptor is not changed. The arguments are put into
+ * EAX, EBX, ECX, ESI and EDX in this order.
+ *
+ * @param   fd      The file descriptor
+ * @param   buf     The bytes to write
+ * @param   count   Number of bytes to write
+ * @param   offset  Offset in the file
+ *
+ * @return Number of bytes written, or -1 if error
+ */
+size_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
+	size_t bytes_written = -1;
+
+	__asm__ __volatile__("int $0x80"
+						 : "=a"(bytes_written)
+						 : "a"(11), "b"(fd), "c"(buf), "S"(count), "d"(offset)
+						 : "memory");
+
+	return bytes_written;
+}
@@ -0,0 +1,25 @@
+#include <sys/uio.h>
+
+/**
+ * @brief Fill the given buffers in order with bytes read from the file given
+ * through the file descriptor
+ *
+ * Only one syscall is issued for all the buffers. The arguments are put into
+ * EAX, EBX, ECX and ESI in this order.
+ *
+ * @param   fd      The file descriptor
+ * @param   iov     Array of buffers
+ * @param   iovcnt  Number of buffers in the array
+ *
+ * @return Total number of bytes read, or -1 if error
+ */
+size_t readv(int fd, const struct iovec *iov, int iovcnt) {
+	size_t ret = -1;
+
+	__asm__ __volatile__("int $0x80"
+						 : "=a"(ret)
+						 : "a"(12), "b"(fd), "c"(iov), "S"(iovcnt)
+						 : "memory");
+
+	return ret;
+}
@@ -0,0 +1,22 @@
+#include <unistd.h>
+
+/**
+ * @brief Remove the file at the given path
+ *
+ * Files that are still open keep their data until they are closed. The
+ * arguments are put into EAX and EBX in this order.
+ *
+ * @param   path    Path of the file
+ *
+ * @return 0 if successful, -1 if error
+ */
+int unlink(const char *path) {
+	int ret = -1;
+
+	__asm__ __volatile__("int $0x80"
+						 : "=a"(ret)
+						 : "a"(15), "b"(path)
+						 : "memory");
+
+	return ret;
+}
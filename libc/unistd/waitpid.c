@@ -0,0 +1,27 @@
+#include <sys/wait.h>
+
+/**
+ * @brief Wait for a child process to exit
+ *
+ * The arguments are put into EAX, EBX and ECX in this order.
+ *
+ * @param   pid     The child, -1 for any child
+ * @param   status  Set to the exit code of the child (can be NULL)
+ * @param   options Not supported, has to be 0
+ *
+ * @return The pid of the child that exited, or -1 if error
+ */
+int waitpid(int pid, int *status, int options) {
+	int ret = -1;
+
+	if (options != 0) {
+		return -1;
+	}
+
+	__asm__ __volatile__("int $0x80"
+						 : "=a"(ret)
+						 : "a"(18), "b"(pid), "c"(status)
+						 : "memory");
+
+	return ret;
+}
@@ -104,7 +104,15 @@ struct Config general_setup_configs[] = {
         is crucial for various time-dependent process and functionalities. Additionally, it\n\
         introduces the 'datetime' command, offering convenient way for users to access the\n\
         current date and time from the command line.",
-	 1, BOOL, NULL}
+	 1, BOOL, NULL},
+
+	{"CONFIG_BOOT_PREFETCH", "Boot prefetch", "Boot Prefetch\n\n\
+        This configuration records the disk blocks loaded during the first seconds after\n\
+        boot into the prefetch.lst file of the disk image. At the next boot, a kernel task\n\
+        reads the recorded blocks into the block cache in disk order while the shell starts,\n\
+        so the programs that are usually launched after boot don't wait for the disk.\n\n\
+        This configuration is only available with the Round-Robin scheduler!",
+	 1, BOOL, "CONFIG_ROUND_ROBIN"}
 #ifdef STEP_BY_STEP
 	,
 	{"CONFIG_DONE", "Done",
@@ -172,7 +180,33 @@ struct Config memory_manager_configs[] = {
         Enabling this protection introduces a slight performance overhead due to the additional\n\
         step of zeroing out memory blocks. However, the trade-off is generally favorable given the\n\
         increased security and stability.",
-	 1, BOOL, NULL}
+	 1, BOOL, NULL},
+
+	{"CONFIG_PAGE_ZERO", "Background page zeroing", "Background Page Zeroing\n\n\
+        This configuration keeps a pool of freed physical blocks that the idle task fills\n\
+        with zeros when no other task is ready to run. Page directories and the pages of new\n\
+        processes are taken from the pool, so starting and ending a process doesn't wait for\n\
+        the memory to be cleared.\n\n\
+        This configuration is only available with the Round-Robin scheduler!",
+	 1, BOOL, "CONFIG_ROUND_ROBIN"},
+
+	{"CONFIG_KHEAP_PROFILE", "Kernel heap profiler", "Kernel Heap Profiler\n\n\
+        This configuration records, for every kmalloc() call site, the bytes and blocks that are\n\
+        still allocated, and keeps a histogram of the allocation sizes and the high-water mark\n\
+        of the kernel heap. The report is shown by the 'kheap stats' command ('kheap stats\n\
+        serial' also writes it to the first serial port).\n\n\
+        Performance Considerations:\n\n\
+        Every block of the kernel heap gets a bigger header and every allocation updates the\n\
+        counters, so this is meant for debugging.",
+	 0, BOOL, NULL},
+
+	{"CONFIG_USER_STACK_SIZE", "User stack size", "User Stack Size\n\n\
+        This configuration sets the largest size, in KB, the stack of a user process can grow\n\
+        to. Only the top page of the stack is mapped when the process starts; the stack grows\n\
+        when the process touches the pages below it. The pages under the stack region are never\n\
+        mapped and the heap cannot grow into them, so a process that overflows its stack ends\n\
+        with a segmentation fault.",
+	 64, INT, NULL}
 #ifdef STEP_BY_STEP
 	,
 	{"CONFIG_DONE", "Done",
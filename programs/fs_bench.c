@@ -0,0 +1,214 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * File system benchmark, meant to be run on images with a generated tree
+ * (see create_disk_image -g). Usage: fs_bench [directory] [files]
+ *
+ * The tree is listed recursively, then the first files found are opened,
+ * looked up (a missing name in their directory, so the whole directory is
+ * searched) and read. Bytes of the generated files are checked: byte i of a
+ * file is (seed + i) & 0xFF, the seed being a hash of the file's name (so the
+ * check still holds after the image is defragmented and the inodes are
+ * renumbered).
+ */
+
+#define BENCH_PATH_LENGTH	128
+#define BENCH_DEFAULT_FILES 256
+#define BENCH_BUFFER_SIZE	4096
+
+struct bench_file {
+	char path[BENCH_PATH_LENGTH];
+	uint32_t seed;
+	uint32_t size;
+};
+
+struct bench_file *bench_files;
+int bench_max_files;
+int bench_num_files;
+uint32_t bench_entries, bench_dirs;
+
+// same hash as generate_seed() in create_disk_image.c
+uint32_t file_seed(const char *name) {
+	uint32_t hash = 5381;
+
+	while (*name) {
+		hash = hash * 33 + (uint8_t) *name++;
+	}
+
+	return hash;
+}
+
+void list_dir(const char *path) {
+	DIR *dir = opendir(path);
+	struct dirent *entry;
+
+	if (dir == NULL) {
+		printf("cannot open %s\n", path);
+		return;
+	}
+
+	while ((entry = readdir(dir)) != NULL) {
+		char child[BENCH_PATH_LENGTH];
+
+		if (strcmp(entry->d_name, ".") == 0 ||
+			strcmp(entry->d_name, "..") == 0) {
+			continue;
+		}
+
+		bench_entries++;
+
+		if (strlen(path) + strlen(entry->d_name) + 2 > sizeof(child)) {
+			continue;
+		}
+
+		strcpy(child, path);
+		strcat(child, "/");
+		strcat(child, entry->d_name);
+
+		if (entry->d_type == DT_DIR) {
+			bench_dirs++;
+			list_dir(child);
+		} else if (bench_num_files < bench_max_files) {
+			struct bench_file *file = &bench_files[bench_num_files++];
+
+			strcpy(file->path, child);
+			file->seed = file_seed(entry->d_name);
+			file->size = entry->d_size;
+		}
+	}
+
+	closedir(dir);
+}
+
+void print_result(const char *name, uint32_t count, uint32_t millis) {
+	printf("%s: %d in %d ms", name, count, millis);
+
+	if (count > 0) {
+		printf(" (%d us each)", millis * 1000 / count);
+	}
+
+	printf("\n");
+}
+
+void _start(int argc, char *argv[]) {
+	char *root = argc >= 2 ? argv[1] : "/gen";
+	uint32_t start, millis, count, bytes, errors;
+	uint8_t *buffer;
+	int error = 0;
+
+	bench_max_files = argc >= 3 ? atoi(argv[2], &error) : BENCH_DEFAULT_FILES;
+
+	if (error || bench_max_files <= 0) {
+		printf("usage: fs_bench [directory] [files]\n");
+		exit(1);
+	}
+
+	bench_files = malloc(bench_max_files * sizeof(struct bench_file));
+	buffer = malloc(BENCH_BUFFER_SIZE);
+
+	if (bench_files == NULL || buffer == NULL) {
+		printf("out of memory\n");
+		exit(1);
+	}
+
+	// listing: every directory of the tree
+	start = uptime();
+	list_dir(root);
+	millis = uptime() - start;
+
+	printf("%s: %d entries, %d directories\n", root, bench_entries,
+		   bench_dirs);
+	print_result("list", bench_entries, millis);
+
+	// open: path walk and data load of existing files
+	count = 0;
+	start = uptime();
+
+	for (int i = 0; i < bench_num_files; i++) {
+		int fd = open(bench_files[i].path, O_RDONLY);
+
+		if (fd >= 0) {
+			close(fd);
+			count++;
+		}
+	}
+
+	millis = uptime() - start;
+	print_result("open", count, millis);
+
+	// lookup: missing names, the whole parent directory is searched
+	count = 0;
+	start = uptime();
+
+	for (int i = 0; i < bench_num_files; i++) {
+		char path[BENCH_PATH_LENGTH + 2];
+
+		strcpy(path, bench_files[i].path);
+		strcat(path, "~");
+
+		if (open(path, O_RDONLY) < 0) {
+			count++;
+		}
+	}
+
+	millis = uptime() - start;
+	print_result("lookup", count, millis);
+
+	// read: whole files, in BENCH_BUFFER_SIZE chunks
+	count = 0;
+	bytes = 0;
+	errors = 0;
+	start = uptime();
+
+	for (int i = 0; i < bench_num_files; i++) {
+		struct bench_file *file = &bench_files[i];
+		int fd = open(file->path, O_RDONLY);
+		uint32_t offset = 0;
+		size_t read_bytes;
+
+		if (fd < 0) {
+			continue;
+		}
+
+		while ((read_bytes = read(fd, buffer, BENCH_BUFFER_SIZE)) > 0 &&
+			   read_bytes != (size_t) -1) {
+			for (size_t j = 0; j < read_bytes; j++) {
+				if (buffer[j] != (uint8_t) (file->seed + offset + j)) {
+					errors++;
+					break;
+				}
+			}
+
+			offset += read_bytes;
+		}
+
+		if (offset != file->size) {
+			errors++;
+		}
+
+		close(fd);
+		bytes += offset;
+		count++;
+	}
+
+	millis = uptime() - start;
+	print_result("read", count, millis);
+	printf("read: %d bytes", bytes);
+
+	if (millis > 0) {
+		printf(" (%d KB/s)", bytes / 1024 * 1000 / millis);
+	}
+
+	printf(", %d errors\n", errors);
+
+	free(buffer);
+	free(bench_files);
+	exit(0);
+}